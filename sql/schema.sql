@@ -88,10 +88,17 @@ CREATE  TABLE IF NOT EXISTS `Alder`.`Image` (
   `Acquisition` INT NOT NULL ,
   `ParentImageId` INT UNSIGNED NULL ,
   `Note` TEXT NULL ,
+  `Hash` CHAR(64) NULL DEFAULT NULL ,
+  `Size` BIGINT UNSIGNED NULL DEFAULT NULL ,
+  `Format` VARCHAR(45) NULL DEFAULT NULL ,
+  `FileName` VARCHAR(255) NULL DEFAULT NULL ,
+  `Variable` VARCHAR(45) NULL DEFAULT NULL ,
   PRIMARY KEY (`Id`) ,
   INDEX `fkImageExamId` (`ExamId` ASC) ,
   UNIQUE INDEX `uqExamIdAcquisition` (`ExamId` ASC, `Acquisition` ASC) ,
+  UNIQUE INDEX `uqExamIdVariable` (`ExamId` ASC, `Variable` ASC) ,
   INDEX `fkImageParentImageId` (`ParentImageId` ASC) ,
+  INDEX `dkHash` (`Hash` ASC) ,
   CONSTRAINT `fkImageExamId`
     FOREIGN KEY (`ExamId` )
     REFERENCES `Alder`.`Exam` (`Id` )
@@ -105,6 +112,36 @@ CREATE  TABLE IF NOT EXISTS `Alder`.`Image` (
 ENGINE = InnoDB;
 
 
+-- -----------------------------------------------------
+-- Table `Alder`.`DicomAttribute`
+-- -----------------------------------------------------
+DROP TABLE IF EXISTS `Alder`.`DicomAttribute` ;
+
+CREATE  TABLE IF NOT EXISTS `Alder`.`DicomAttribute` (
+  `Id` INT UNSIGNED NOT NULL AUTO_INCREMENT ,
+  `UpdateTimestamp` TIMESTAMP NOT NULL ,
+  `CreateTimestamp` TIMESTAMP NOT NULL ,
+  `ImageId` INT UNSIGNED NOT NULL ,
+  `AcquisitionDateTime` VARCHAR(45) NULL DEFAULT NULL ,
+  `SeriesNumber` INT NULL DEFAULT NULL ,
+  `CineRate` INT NULL DEFAULT NULL ,
+  `RecommendedDisplayFrameRate` INT NULL DEFAULT NULL ,
+  `Width` INT UNSIGNED NOT NULL DEFAULT 0 ,
+  `Height` INT UNSIGNED NOT NULL DEFAULT 0 ,
+  `Frames` INT UNSIGNED NOT NULL DEFAULT 0 ,
+  `PhotometricInterpretation` VARCHAR(45) NULL DEFAULT NULL ,
+  `TransferSyntax` VARCHAR(64) NULL DEFAULT NULL ,
+  PRIMARY KEY (`Id`) ,
+  UNIQUE INDEX `uqImageId` (`ImageId` ASC) ,
+  INDEX `dkAcquisitionDateTime` (`AcquisitionDateTime` ASC) ,
+  CONSTRAINT `fkDicomAttributeImageId`
+    FOREIGN KEY (`ImageId` )
+    REFERENCES `Alder`.`Image` (`Id` )
+    ON DELETE CASCADE
+    ON UPDATE CASCADE)
+ENGINE = InnoDB;
+
+
 -- -----------------------------------------------------
 -- Table `Alder`.`User`
 -- -----------------------------------------------------
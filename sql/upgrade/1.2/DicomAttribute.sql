@@ -0,0 +1,23 @@
+CREATE TABLE IF NOT EXISTS DicomAttribute (
+  Id INT UNSIGNED NOT NULL AUTO_INCREMENT,
+  UpdateTimestamp TIMESTAMP NOT NULL,
+  CreateTimestamp TIMESTAMP NOT NULL,
+  ImageId INT UNSIGNED NOT NULL,
+  AcquisitionDateTime VARCHAR(45) NULL DEFAULT NULL,
+  SeriesNumber INT NULL DEFAULT NULL,
+  CineRate INT NULL DEFAULT NULL,
+  RecommendedDisplayFrameRate INT NULL DEFAULT NULL,
+  Width INT UNSIGNED NOT NULL DEFAULT 0,
+  Height INT UNSIGNED NOT NULL DEFAULT 0,
+  Frames INT UNSIGNED NOT NULL DEFAULT 0,
+  PhotometricInterpretation VARCHAR(45) NULL DEFAULT NULL,
+  TransferSyntax VARCHAR(64) NULL DEFAULT NULL,
+  PRIMARY KEY ( Id ),
+  UNIQUE INDEX uqImageId ( ImageId ),
+  INDEX dkAcquisitionDateTime ( AcquisitionDateTime ),
+  CONSTRAINT fkDicomAttributeImageId
+  FOREIGN KEY ( ImageId )
+  REFERENCES Image ( Id )
+  ON DELETE CASCADE
+  ON UPDATE CASCADE )
+ENGINE = InnoDB;
@@ -0,0 +1,8 @@
+ALTER TABLE Image
+ADD COLUMN Hash CHAR(64) NULL DEFAULT NULL,
+ADD COLUMN Size BIGINT UNSIGNED NULL DEFAULT NULL,
+ADD COLUMN Format VARCHAR(45) NULL DEFAULT NULL,
+ADD COLUMN FileName VARCHAR(255) NULL DEFAULT NULL,
+ADD COLUMN Variable VARCHAR(45) NULL DEFAULT NULL,
+ADD UNIQUE INDEX uqExamIdVariable ( ExamId, Variable ),
+ADD INDEX dkHash ( Hash );
@@ -14,6 +14,7 @@
 //
 
 #include "Application.h"
+#include "Configuration.h"
 #include "User.h"
 #include "Utilities.h"
 
@@ -23,7 +24,11 @@
 #include <QObject>
 #include <QString>
 
+#include "vtkDecodedImageCache.h"
+#include "vtkImageDataCache.h"
+#include "vtkImageThumbnailCache.h"
 #include "vtkSmartPointer.h"
+#include "vtkVariant.h"
 
 #include <stdexcept>
 
@@ -38,19 +43,30 @@ int main( int argc, char** argv )
   {
     // start by reading the configuration, connecting to the database and setting up the Opal service
     Application *app = Application::GetInstance();
-    if( !app->ReadConfiguration( ALDER_CONFIG_FILE ) )
+    try
     {
-      cerr << "ERROR: error while reading configuration file \"" << ALDER_CONFIG_FILE << "\"" << endl;
-      Application::DeleteInstance();
-      return status;
+      app->Setup( ALDER_CONFIG_FILE );
     }
-    if( !app->ConnectToDatabase() )
+    catch( std::exception &e )
     {
-      cerr << "ERROR: error while connecting to the database" << endl;
+      cerr << "ERROR: " << e.what() << endl;
       Application::DeleteInstance();
       return status;
     }
-    app->SetupOpalService();
+
+    // set the memory budget of the decoded image cache
+    std::string imageCacheSize = app->GetConfig()->GetValue( "Viewer", "ImageCacheSize" );
+    if( 0 < imageCacheSize.length() )
+      vtkImageDataCache::SetMemoryBudget( vtkVariant( imageCacheSize ).ToUnsignedLong() );
+
+    // cineloops are decoded to this directory in the background (an empty path disables it)
+    vtkDecodedImageCache::SetDirectory( app->GetConfig()->GetValue( "Path", "DecodedImageCache" ) );
+    std::string decodedImageCacheSize = app->GetConfig()->GetValue( "Viewer", "DecodedImageCacheSize" );
+    if( 0 < decodedImageCacheSize.length() )
+      vtkDecodedImageCache::SetDiskBudget( vtkVariant( decodedImageCacheSize ).ToUnsignedLong() );
+
+    // thumbnails are made as images are downloaded (an empty path disables them)
+    vtkImageThumbnailCache::SetDirectory( app->GetConfig()->GetValue( "Path", "ThumbnailCache" ) );
 
     // now create the user interface
     QAlderApplication qapp( argc, argv );
@@ -78,11 +94,17 @@ int main( int argc, char** argv )
 
     // execute the application, then delete the application
     int status = qapp.exec();
+    vtkImageDataCache::Stop();
+    vtkDecodedImageCache::Stop();
+    vtkImageThumbnailCache::Stop();
     Application::DeleteInstance();
   }
   catch( std::exception &e )
   {
     cerr << "Uncaught exception: " << e.what() << endl;
+    vtkImageDataCache::Stop();
+    vtkDecodedImageCache::Stop();
+    vtkImageThumbnailCache::Stop();
     return EXIT_FAILURE;
   }
 
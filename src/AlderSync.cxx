@@ -0,0 +1,348 @@
+/*=========================================================================
+
+  Program:  Alder (CLSA Medical Image Quality Assessment Tool)
+  Module:   AlderSync.cxx
+  Language: C++
+
+  Author: Patrick Emond <emondpd AT mcmaster DOT ca>
+  Author: Dean Inglis <inglisd AT mcmaster DOT ca>
+
+=========================================================================*/
+//
+// .SECTION Description
+// A command line tool (without a user interface) which downloads the image data of every
+// interview which hasn't been downloaded yet using a pool of worker threads.  Each worker has
+// its own database connection and Opal service.  Since an exam is only marked as downloaded
+// once all of its images have been received the tool can simply be run again after it has
+// been interrupted.  The tool can also audit the image store, checking every image file
+// against its recorded size and hash without decoding any images (other than the single frame
+// of each thumbnail which is missing).
+//
+
+#include "Application.h"
+#include "Configuration.h"
+#include "Database.h"
+#include "Exam.h"
+#include "Image.h"
+#include "Interview.h"
+#include "OpalService.h"
+#include "Utilities.h"
+
+#include "vtkAlderMySQLQuery.h"
+#include "vtkImageThumbnailCache.h"
+#include "vtkNew.h"
+#include "vtkSmartPointer.h"
+#include "vtkVariant.h"
+
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <curl/curl.h>
+#include <iomanip>
+#include <mutex>
+#include <queue>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+using namespace Alder;
+
+namespace
+{
+  // the interviews which have yet to be synchronized
+  std::mutex queueMutex;
+  std::queue< std::string > interviewQueue;
+
+  // totals of all workers
+  std::mutex statsMutex;
+  int interviewsDone = 0;
+  int interviewsFailed = 0;
+  int filesReceived = 0;
+  double bytesReceived = 0.0;
+
+  std::atomic< int > runningWorkers( 0 );
+  std::atomic< bool > stopRequested( false );
+
+  // stop taking new interviews when interrupted, interrupting a second time exits right away
+  void stopHandler( int signal )
+  {
+    stopRequested = true;
+    std::signal( signal, SIG_DFL );
+  }
+
+  // sets up the calling thread's application instance
+  bool setupApplication()
+  {
+    Application *app = Application::GetInstance();
+    try
+    {
+      app->Setup( ALDER_CONFIG_FILE );
+    }
+    catch( std::exception &e )
+    {
+      cerr << "ERROR: " << e.what() << endl;
+      return false;
+    }
+
+    // thumbnails are made as images are downloaded (an empty path disables them)
+    vtkImageThumbnailCache::SetDirectory( app->GetConfig()->GetValue( "Path", "ThumbnailCache" ) );
+    return true;
+  }
+
+  // downloads the image data of interviews from the queue until it is empty
+  void syncWorker()
+  {
+    if( setupApplication() )
+    {
+      OpalService *opal = Application::GetInstance()->GetOpal();
+      while( !stopRequested )
+      {
+        std::string id;
+        {
+          std::lock_guard< std::mutex > lock( queueMutex );
+          if( interviewQueue.empty() ) break;
+          id = interviewQueue.front();
+          interviewQueue.pop();
+        }
+
+        int files = opal->GetFilesReceived();
+        double bytes = opal->GetBytesReceived();
+        bool success = true;
+        try
+        {
+          vtkNew< Interview > interview;
+          if( !interview->Load( "Id", id ) )
+            throw std::runtime_error( "Interview no longer exists" );
+          interview->UpdateExamData();
+          interview->UpdateImageData();
+        }
+        catch( std::exception &e )
+        {
+          success = false;
+          Utilities::log( "Unable to synchronize interview " + id + ": " + e.what() );
+        }
+
+        std::lock_guard< std::mutex > lock( statsMutex );
+        if( success ) interviewsDone++;
+        else interviewsFailed++;
+        filesReceived += opal->GetFilesReceived() - files;
+        bytesReceived += opal->GetBytesReceived() - bytes;
+      }
+
+      Utilities::log( "Opal transfer statistics of worker:\n" + opal->GetStatisticsSummary() );
+    }
+
+    Application::DeleteInstance();
+    runningWorkers--;
+  }
+
+  // checks every image file against the image store's index, adding images downloaded before
+  // the index existed to it (along with their DICOM attributes), making missing thumbnails and
+  // marking the exams of damaged images so that they are downloaded again, returns whether all
+  // images are intact
+  bool auditImages( const bool checkHash )
+  {
+    std::vector< vtkSmartPointer< Image > > imageList;
+    ActiveRecord::GetAll( &imageList );
+
+    int indexed = 0, damaged = 0, thumbnails = 0;
+    for( auto it = imageList.cbegin(); it != imageList.cend() && !stopRequested; ++it )
+    {
+      Image *image = *it;
+      std::string id = image->Get( "Id" ).ToString();
+      try
+      {
+        vtkVariant hash = image->Get( "Hash" );
+        bool intact = true;
+        if( !image->Get( "FileName" ).IsValid() && image->VerifyFile( false ) )
+        {
+          image->StoreFile( hash.IsValid() ? hash.ToString() : "" );
+          image->StoreDICOMAttributes();
+          indexed++;
+        }
+        else if( !image->VerifyFile( checkHash ) )
+        {
+          intact = false;
+          damaged++;
+          Utilities::log( "Image " + id + " is missing or damaged, its exam will be downloaded again" );
+          vtkSmartPointer< Exam > exam;
+          if( image->GetRecord( exam ) )
+          {
+            exam->Set( "Downloaded", 0 );
+            exam->Save();
+          }
+        }
+
+        // intact images downloaded before thumbnails were made are given one
+        if( intact && !vtkImageThumbnailCache::GetDirectory().empty() &&
+            vtkImageThumbnailCache::GetFileName( image->GetFileName() ).empty() &&
+            vtkImageThumbnailCache::Store( image->GetFileName() ) ) thumbnails++;
+      }
+      catch( std::exception &e )
+      {
+        damaged++;
+        Utilities::log( "Unable to audit image " + id + ": " + e.what() );
+      }
+    }
+
+    std::stringstream stream;
+    stream << "Audited " << imageList.size() << " images (" << ( checkHash ? "sizes and hashes" : "sizes" )
+           << "), " << indexed << " added to the index, " << thumbnails << " thumbnails made, "
+           << damaged << " missing or damaged";
+    cout << stream.str() << endl;
+    Utilities::log( stream.str() );
+    return 0 == damaged;
+  }
+
+  // reports the progress and throughput so far
+  void report( const int total, const double seconds )
+  {
+    std::stringstream stream;
+    {
+      std::lock_guard< std::mutex > lock( statsMutex );
+      double megabytes = bytesReceived / 1048576.0;
+      stream << std::fixed << std::setprecision( 2 )
+             << interviewsDone + interviewsFailed << " of " << total << " interviews synchronized ("
+             << interviewsFailed << " failed), " << filesReceived << " files ("
+             << ( 0 < seconds ? filesReceived / seconds : 0.0 ) << " files/s), "
+             << megabytes << " MB (" << ( 0 < seconds ? megabytes / seconds : 0.0 ) << " MB/s)";
+    }
+    cout << stream.str() << endl;
+    Utilities::log( stream.str() );
+  }
+
+  void usage( const char *name )
+  {
+    cerr << "Usage: " << name << " [-t threads] [-r seconds] [-u] [-a|-A]" << endl
+         << "  -t threads  the number of worker threads (default 4)" << endl
+         << "  -r seconds  how often to report throughput (default 60)" << endl
+         << "  -u          update the list of interviews from Opal first" << endl
+         << "  -a          audit the image store (file sizes only) instead of downloading" << endl
+         << "  -A          audit the image store (file sizes and hashes) instead of downloading" << endl;
+  }
+}
+
+// main function
+int main( int argc, char** argv )
+{
+  int threads = 4;
+  int interval = 60;
+  bool updateInterviews = false;
+  bool audit = false;
+  bool checkHash = false;
+
+  int option;
+  while( -1 != ( option = getopt( argc, argv, "t:r:uaA" ) ) )
+  {
+    if( 't' == option ) threads = atoi( optarg );
+    else if( 'r' == option ) interval = atoi( optarg );
+    else if( 'u' == option ) updateInterviews = true;
+    else if( 'a' == option ) audit = true;
+    else if( 'A' == option ) audit = checkHash = true;
+    else
+    {
+      usage( argv[0] );
+      return EXIT_FAILURE;
+    }
+  }
+
+  if( 1 > threads || 1 > interval )
+  {
+    usage( argv[0] );
+    return EXIT_FAILURE;
+  }
+
+  // curl must be initialized before any other threads are started
+  curl_global_init( CURL_GLOBAL_ALL );
+
+  int status = EXIT_FAILURE;
+  int total = 0;
+  try
+  {
+    // the main thread sets up its application first so that the libraries it uses are
+    // initialized before any worker threads are started
+    if( !setupApplication() )
+    {
+      Application::DeleteInstance();
+      curl_global_cleanup();
+      return status;
+    }
+
+    if( updateInterviews ) Interview::UpdateInterviewData();
+
+    if( audit )
+    {
+      std::signal( SIGINT, stopHandler );
+      std::signal( SIGTERM, stopHandler );
+      if( auditImages( checkHash ) && !stopRequested ) status = EXIT_SUCCESS;
+      Application::DeleteInstance();
+      curl_global_cleanup();
+      return status;
+    }
+
+    // interviews which have no exams yet or which have exams which haven't been downloaded
+    vtkSmartPointer< vtkAlderMySQLQuery > query = Application::GetInstance()->GetDB()->GetQuery();
+    query->SetQuery(
+      "SELECT DISTINCT Interview.Id FROM Interview "
+      "LEFT JOIN Exam ON Interview.Id = Exam.InterviewId "
+      "WHERE Exam.Id IS NULL OR ( Exam.Stage = 'Completed' AND Exam.Downloaded = 0 ) "
+      "ORDER BY Interview.Id" );
+    query->Execute();
+
+    if( query->HasError() )
+    {
+      Utilities::log( query->GetLastErrorText() );
+      throw std::runtime_error( "There was an error while trying to query the database." );
+    }
+
+    while( query->NextRow() ) interviewQueue.push( query->DataValue( 0 ).ToString() );
+    total = interviewQueue.size();
+    Application::DeleteInstance();
+  }
+  catch( std::exception &e )
+  {
+    cerr << "Uncaught exception: " << e.what() << endl;
+    Application::DeleteInstance();
+    curl_global_cleanup();
+    return status;
+  }
+
+  std::stringstream stream;
+  stream << "Synchronizing " << total << " interviews using " << threads << " threads";
+  cout << stream.str() << endl;
+  Utilities::log( stream.str() );
+
+  std::signal( SIGINT, stopHandler );
+  std::signal( SIGTERM, stopHandler );
+
+  auto start = std::chrono::steady_clock::now();
+  std::vector< std::thread > workers;
+  runningWorkers = threads;
+  for( int i = 0; i < threads; ++i ) workers.push_back( std::thread( syncWorker ) );
+
+  // report the throughput periodically until all workers are done
+  auto lastReport = start;
+  while( 0 < runningWorkers )
+  {
+    std::this_thread::sleep_for( std::chrono::milliseconds( 250 ) );
+    auto now = std::chrono::steady_clock::now();
+    if( std::chrono::seconds( interval ) <= now - lastReport )
+    {
+      report( total, std::chrono::duration< double >( now - start ).count() );
+      lastReport = now;
+    }
+  }
+
+  for( auto it = workers.begin(); it != workers.end(); ++it ) it->join();
+  report( total, std::chrono::duration< double >( std::chrono::steady_clock::now() - start ).count() );
+
+  // thumbnails are made in the background, let the ones still queued be finished
+  if( !stopRequested ) vtkImageThumbnailCache::Flush();
+  vtkImageThumbnailCache::Stop();
+
+  if( stopRequested ) cout << "Stopped before all interviews were synchronized" << endl;
+  else if( 0 == interviewsFailed && interviewQueue.empty() ) status = EXIT_SUCCESS;
+
+  curl_global_cleanup();
+  return status;
+}
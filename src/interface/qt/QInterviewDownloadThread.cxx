@@ -0,0 +1,120 @@
+/*=========================================================================
+
+  Program:  Alder (CLSA Medical Image Quality Assessment Tool)
+  Module:   QInterviewDownloadThread.cxx
+  Language: C++
+
+  Author: Patrick Emond <emondpd AT mcmaster DOT ca>
+  Author: Dean Inglis <inglisd AT mcmaster DOT ca>
+
+=========================================================================*/
+#include "QInterviewDownloadThread.h"
+
+#include "Application.h"
+#include "CancellationToken.h"
+#include "Exam.h"
+#include "Image.h"
+#include "Interview.h"
+#include "Utilities.h"
+
+#include "vtkDecodedImageCache.h"
+#include "vtkNew.h"
+#include "vtkSmartPointer.h"
+
+#include <stdexcept>
+#include <vector>
+
+//-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-
+QInterviewDownloadThread::QInterviewDownloadThread( const std::string interviewId, QObject* parent )
+  : QThread( parent )
+{
+  this->interviewId = interviewId;
+  this->token = std::make_shared< Alder::CancellationToken >();
+  this->job = std::make_shared< Alder::ProgressChannel::Job >();
+
+  // connected first so that the statistics are added before any other slot deletes the thread
+  QObject::connect( this, SIGNAL( finished() ), this, SLOT( slotAddStatistics() ) );
+}
+
+//-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-
+QInterviewDownloadThread::~QInterviewDownloadThread()
+{
+  this->cancel();
+  this->wait();
+}
+
+//-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-
+void QInterviewDownloadThread::cancel()
+{
+  this->token->Cancel();
+}
+
+//-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-
+void QInterviewDownloadThread::run()
+{
+  Alder::Application *app = Alder::Application::GetInstance();
+  try
+  {
+    app->Setup( ALDER_CONFIG_FILE );
+    app->SetCancellationToken( this->token );
+    Alder::ProgressChannel::GetInstance()->SetJob( this->job );
+
+    // the interview is loaded by this thread's own database connection
+    vtkNew< Alder::Interview > interview;
+    if( !interview->Load( "Id", this->interviewId ) )
+      throw std::runtime_error( "The interview no longer exists." );
+
+    vtkNew< Command > observer;
+    observer->thread = this;
+    interview->AddObserver( Alder::Interview::ExamImageDataEvent, observer.GetPointer() );
+    interview->UpdateImageData();
+  }
+  catch( std::exception &e )
+  {
+    this->error = e.what();
+    Alder::Utilities::log( "Unable to download interview " + this->interviewId + ": " + e.what() );
+  }
+
+  // the thread's Opal service is deleted along with its application
+  this->statistics.clear();
+  for( int i = 0; i < Alder::OpalService::EndpointCount; ++i )
+    this->statistics.push_back(
+      app->GetOpal()->GetStatistics( static_cast< Alder::OpalService::Endpoint >( i ) ) );
+
+  Alder::ProgressChannel::GetInstance()->SetJob( NULL );
+  Alder::Application::DeleteInstance();
+}
+
+//-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-
+void QInterviewDownloadThread::slotAddStatistics()
+{
+  Alder::OpalService *opal = Alder::Application::GetInstance()->GetOpal();
+  for( size_t i = 0; i < this->statistics.size(); ++i )
+    opal->AddStatistics( static_cast< Alder::OpalService::Endpoint >( i ), this->statistics[i] );
+  this->statistics.clear();
+}
+
+//-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-
+void QInterviewDownloadThread::Command::Execute(
+  vtkObject *caller, unsigned long eventId, void *callData )
+{
+  Alder::Exam *exam = static_cast< Alder::Exam* >( callData );
+  if( this->thread && exam ) emit this->thread->examDownloaded( exam->Get( "Id" ).ToInt() );
+
+  // decode the exam's cineloops in the background so that they don't have to be decoded when viewed
+  if( exam && !vtkDecodedImageCache::GetDirectory().empty() )
+  {
+    try
+    {
+      std::vector< vtkSmartPointer< Alder::Image > > imageList;
+      exam->GetList( &imageList );
+      for( auto it = imageList.cbegin(); it != imageList.cend(); ++it )
+        if( 1 < (*it)->GetDICOMDimensions()[2] ) vtkDecodedImageCache::Enqueue( (*it)->GetFileName() );
+    }
+    catch( std::exception &e )
+    {
+      Alder::Utilities::log( "Unable to queue exam " + exam->Get( "Id" ).ToString() +
+                             " for decoding: " + e.what() );
+    }
+  }
+}
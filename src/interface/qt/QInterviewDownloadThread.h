@@ -0,0 +1,87 @@
+/*=========================================================================
+
+  Program:  Alder (CLSA Medical Image Quality Assessment Tool)
+  Module:   QInterviewDownloadThread.h
+  Language: C++
+
+  Author: Patrick Emond <emondpd AT mcmaster DOT ca>
+  Author: Dean Inglis <inglisd AT mcmaster DOT ca>
+
+=========================================================================*/
+
+#ifndef __QInterviewDownloadThread_h
+#define __QInterviewDownloadThread_h
+
+#include <QString>
+#include <QThread>
+
+#include "OpalService.h"
+#include "ProgressChannel.h"
+
+#include "vtkCommand.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace Alder {
+class CancellationToken;
+};
+
+// Downloads the image data of an interview without blocking the user interface.  The thread
+// sets up its own application instance (configuration, database connection and Opal service)
+// and the job is cancelled by its own token, leaving every other operation alone (its progress
+// is likewise reported to its own job of the progress channel).  Once the
+// thread is finished (or cancelled) the statistics of its Opal requests are added to those of
+// the user interface's Opal service.
+class QInterviewDownloadThread : public QThread
+{
+  Q_OBJECT
+private:
+  // forwards the interview's ExamImageDataEvent to the examDownloaded() signal
+  class Command : public vtkCommand
+  {
+  public:
+    static Command *New() { return new Command; }
+    void Execute( vtkObject *caller, unsigned long eventId, void *callData );
+    QInterviewDownloadThread *thread;
+
+  protected:
+    Command() { this->thread = NULL; }
+  };
+
+public:
+  //constructor
+  QInterviewDownloadThread( const std::string interviewId, QObject* parent = 0 );
+  //destructor
+  ~QInterviewDownloadThread();
+
+  std::string getInterviewId() const { return this->interviewId; }
+  std::shared_ptr< Alder::CancellationToken > getCancellationToken() const { return this->token; }
+  std::shared_ptr< Alder::ProgressChannel::Job > getProgressJob() const { return this->job; }
+
+  // the reason the download failed, empty if it didn't (only valid once the thread is finished)
+  QString getError() const { return this->error; }
+
+public slots:
+  virtual void cancel();
+
+signals:
+  // emitted (from the download thread) as soon as each exam's images have been received
+  void examDownloaded( int examId );
+
+private slots:
+  // adds the statistics of the thread's Opal requests to those of the calling thread's service
+  void slotAddStatistics();
+
+protected:
+  void run();
+
+  std::string interviewId;
+  std::shared_ptr< Alder::CancellationToken > token;
+  std::shared_ptr< Alder::ProgressChannel::Job > job;
+  QString error;
+  std::vector< Alder::OpalService::TransferStatistics > statistics;
+};
+
+#endif
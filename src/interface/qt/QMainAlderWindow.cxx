@@ -13,6 +13,7 @@
 
 #include <Application.h>
 #include <Interview.h>
+#include <ProgressChannel.h>
 #include <User.h>
 
 #include <vtkEventQtSlotConnect.h>
@@ -22,6 +23,7 @@
 #include <QAboutDialog.h>
 #include <QAlderDicomTagWidget.h>
 #include <QLoginDialog.h>
+#include <QOpalStatisticsDialog.h>
 #include <QSelectInterviewDialog.h>
 #include <QUserListDialog.h>
 #include <QVTKProgressDialog.h>
@@ -59,6 +61,9 @@ QMainAlderWindow::QMainAlderWindow( QWidget* parent )
   QObject::connect(
     this->ui->actionUpdateDatabase, SIGNAL( triggered() ),
     this, SLOT( slotUpdateDatabase() ) );
+  QObject::connect(
+    this->ui->actionOpalStatistics, SIGNAL( triggered() ),
+    this, SLOT( slotOpalStatistics() ) );
   QObject::connect(
     this->ui->actionExit, SIGNAL( triggered() ),
     qApp, SLOT( closeAllWindows() ) );
@@ -122,19 +127,8 @@ void QMainAlderWindow::slotOpenInterview()
     dialog.setWindowTitle( tr( "Select Interview" ) );
     dialog.exec();
 
-    // update the interview's exams
-    Alder::Interview *activeInterview = app->GetActiveInterview();
-    if( activeInterview && !activeInterview->HasImageData() )
-    {
-      // create a progress dialog to observe the progress of the update
-      QVTKProgressDialog dialog( this );
-      dialog.setModal( true );
-      dialog.setWindowTitle( tr( "Downloading Exam Images" ) );
-      dialog.setMessage( tr( "Please wait while the interview's images are downloaded." ) );
-      dialog.open();
-      app->UpdateActiveInterviewImageData();
-      dialog.accept();
-    }
+    // download the interview's images in the background
+    this->ui->interviewWidget->downloadImageData();
   }
 }
 
@@ -146,6 +140,7 @@ void QMainAlderWindow::slotLogin()
 
   if( loggedIn )
   {
+    this->ui->interviewWidget->cancelDownload();
     app->ResetApplication();
   }
   else
@@ -275,7 +270,10 @@ void QMainAlderWindow::slotUpdateDatabase()
       dialog.setWindowTitle( tr( "Updating Database" ) );
       dialog.setMessage( tr( "Please wait while the database is updated." ) );
       dialog.open();
+      Alder::ProgressChannel *channel = Alder::ProgressChannel::GetInstance();
+      channel->SetJob( dialog.getProgressJob() );
       Alder::Interview::UpdateInterviewData();
+      channel->SetJob( NULL );
       dialog.accept();
       break;
     }
@@ -283,6 +281,15 @@ void QMainAlderWindow::slotUpdateDatabase()
   }
 }
 
+//-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-
+void QMainAlderWindow::slotOpalStatistics()
+{
+  QOpalStatisticsDialog dialog( this );
+  dialog.setModal( true );
+  dialog.setWindowTitle( tr( "Network Statistics" ) );
+  dialog.exec();
+}
+
 //-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-
 void QMainAlderWindow::slotAbout()
 {
@@ -36,6 +36,7 @@ public slots:
   virtual void slotLogin();
   virtual void slotUserManagement();
   virtual void slotUpdateDatabase();
+  virtual void slotOpalStatistics();
 
   // help event functions
   virtual void slotAbout();
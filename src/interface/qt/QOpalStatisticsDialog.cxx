@@ -0,0 +1,114 @@
+/*=========================================================================
+
+  Program:  Alder (CLSA Medical Image Quality Assessment Tool)
+  Module:   QOpalStatisticsDialog.cxx
+  Language: C++
+
+  Author: Patrick Emond <emondpd AT mcmaster DOT ca>
+  Author: Dean Inglis <inglisd AT mcmaster DOT ca>
+
+=========================================================================*/
+#include "QOpalStatisticsDialog.h"
+#include "ui_QOpalStatisticsDialog.h"
+
+#include "Application.h"
+#include "OpalService.h"
+
+#include <QHeaderView>
+#include <QStringList>
+#include <QTableWidget>
+#include <QTableWidgetItem>
+
+//-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-
+QOpalStatisticsDialog::QOpalStatisticsDialog( QWidget* parent )
+  : QDialog( parent )
+{
+  this->ui = new Ui_QOpalStatisticsDialog;
+  this->ui->setupUi( this );
+
+  QStringList labels;
+  labels << "Requests" << "Failed" << "Cache Hits" << "MB" << "MB/s"
+         << "Lookup (ms)" << "Connect (ms)" << "TLS (ms)" << "Wait (ms)" << "Receive (ms)"
+         << "Total (ms)" << "Slowest (ms)";
+  this->ui->statisticsTableWidget->setColumnCount( labels.size() );
+  this->ui->statisticsTableWidget->setHorizontalHeaderLabels( labels );
+  this->ui->statisticsTableWidget->horizontalHeader()->setResizeMode( QHeaderView::ResizeToContents );
+
+  QStringList rows;
+  for( int i = 0; i < Alder::OpalService::EndpointCount; ++i )
+  {
+    Alder::OpalService::Endpoint endpoint = static_cast< Alder::OpalService::Endpoint >( i );
+    QString name = Alder::OpalService::GetEndpointName( endpoint ).c_str();
+    rows << name.left( 1 ).toUpper() + name.mid( 1 );
+  }
+  this->ui->statisticsTableWidget->setRowCount( rows.size() );
+  this->ui->statisticsTableWidget->setVerticalHeaderLabels( rows );
+  this->ui->statisticsTableWidget->setSelectionMode( QAbstractItemView::NoSelection );
+
+  QObject::connect(
+    this->ui->resetPushButton, SIGNAL( clicked( bool ) ),
+    this, SLOT( slotReset() ) );
+  QObject::connect(
+    this->ui->closePushButton, SIGNAL( clicked( bool ) ),
+    this, SLOT( slotClose() ) );
+
+  this->updateInterface();
+}
+
+//-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-
+QOpalStatisticsDialog::~QOpalStatisticsDialog()
+{
+}
+
+//-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-
+void QOpalStatisticsDialog::slotReset()
+{
+  Alder::Application::GetInstance()->GetOpal()->ResetStatistics();
+  this->updateInterface();
+}
+
+//-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-
+void QOpalStatisticsDialog::slotClose()
+{
+  this->accept();
+}
+
+//-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-
+void QOpalStatisticsDialog::updateInterface()
+{
+  Alder::OpalService *opal = Alder::Application::GetInstance()->GetOpal();
+
+  for( int row = 0; row < Alder::OpalService::EndpointCount; ++row )
+  {
+    Alder::OpalService::TransferStatistics statistics =
+      opal->GetStatistics( static_cast< Alder::OpalService::Endpoint >( row ) );
+
+    // times are the means of the successful requests
+    int timed = statistics.Requests - statistics.Failures;
+    double scale = 0 < timed ? 1000.0 / timed : 0.0;
+    double megabytes = statistics.Bytes / 1048576.0;
+
+    QStringList values;
+    values << QString::number( statistics.Requests )
+           << QString::number( statistics.Failures )
+           << QString::number( statistics.CacheHits )
+           << QString::number( megabytes, 'f', 2 )
+           << QString::number( 0.0 < statistics.TotalTime ? megabytes / statistics.TotalTime : 0.0, 'f', 2 )
+           << QString::number( statistics.NameLookupTime * scale, 'f', 0 )
+           << QString::number( statistics.ConnectTime * scale, 'f', 0 )
+           << QString::number( statistics.HandshakeTime * scale, 'f', 0 )
+           << QString::number( statistics.WaitTime * scale, 'f', 0 )
+           << QString::number( statistics.ReceiveTime * scale, 'f', 0 )
+           << QString::number( statistics.TotalTime * scale, 'f', 0 )
+           << QString::number( statistics.SlowestTime * 1000.0, 'f', 0 );
+
+    for( int column = 0; column < values.size(); ++column )
+    {
+      QTableWidgetItem *item = new QTableWidgetItem;
+      item->setFlags( Qt::ItemIsEnabled );
+      item->setTextAlignment( Qt::AlignRight | Qt::AlignVCenter );
+      item->setText( values[column] );
+      this->ui->statisticsTableWidget->setItem( row, column, item );
+    }
+  }
+}
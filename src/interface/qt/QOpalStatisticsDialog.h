@@ -0,0 +1,41 @@
+/*=========================================================================
+
+  Program:  Alder (CLSA Medical Image Quality Assessment Tool)
+  Module:   QOpalStatisticsDialog.h
+  Language: C++
+
+  Author: Patrick Emond <emondpd AT mcmaster DOT ca>
+  Author: Dean Inglis <inglisd AT mcmaster DOT ca>
+
+=========================================================================*/
+
+#ifndef __QOpalStatisticsDialog_h
+#define __QOpalStatisticsDialog_h
+
+#include <QDialog>
+
+class Ui_QOpalStatisticsDialog;
+
+class QOpalStatisticsDialog : public QDialog
+{
+  Q_OBJECT
+
+public:
+  //constructor
+  QOpalStatisticsDialog( QWidget* parent = 0 );
+  //destructor
+  ~QOpalStatisticsDialog();
+  
+public slots:
+  virtual void slotReset();
+  virtual void slotClose();
+
+protected:
+  void updateInterface();
+
+private:
+  // Designer form
+  Ui_QOpalStatisticsDialog *ui;
+};
+
+#endif
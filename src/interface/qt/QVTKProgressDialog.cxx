@@ -12,8 +12,9 @@
 #include "ui_QVTKProgressDialog.h"
 
 #include "Application.h"
+#include "CancellationToken.h"
 
-#include <utility>
+#include <QTimer>
 
 //-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-
 QVTKProgressDialog::QVTKProgressDialog( QWidget* parent )
@@ -21,25 +22,30 @@ QVTKProgressDialog::QVTKProgressDialog( QWidget* parent )
 {
   this->ui = new Ui_QVTKProgressDialog;
   this->ui->setupUi( this );
-  
+
   QObject::connect(
     this->ui->buttonBox, SIGNAL( rejected() ),
     this, SLOT( slotCancel() ) );
 
-  this->observer = vtkSmartPointer< Command >::New();
-  this->observer->ui = this->ui;
+  this->setProgressJob( std::make_shared< Alder::ProgressChannel::Job >() );
 
-  Alder::Application *app = Alder::Application::GetInstance();
-  app->AddObserver( vtkCommand::ConfigureEvent, this->observer );
-  app->AddObserver( vtkCommand::StartEvent, this->observer );
-  app->AddObserver( vtkCommand::ProgressEvent, this->observer );
-  app->AddObserver( vtkCommand::EndEvent, this->observer );
+  // read the channel at a fixed rate while the event loop is running, and have it pump the
+  // dialog while work is being done on this thread instead
+  this->timer = new QTimer( this );
+  this->timer->setInterval( Alder::ProgressChannel::UpdateInterval );
+  QObject::connect(
+    this->timer, SIGNAL( timeout() ),
+    this, SLOT( slotUpdate() ) );
+  this->timer->start();
+  Alder::ProgressChannel::GetInstance()->SetConsumer( this );
 }
 
 //-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-
 QVTKProgressDialog::~QVTKProgressDialog()
 {
-  Alder::Application::GetInstance()->RemoveObserver( this->observer );
+  // another dialog may have become the consumer since this one was created
+  Alder::ProgressChannel::GetInstance()->RemoveConsumer( this );
+  this->timer->stop();
 }
 
 //-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-
@@ -48,53 +54,56 @@ void QVTKProgressDialog::setMessage( QString message )
   this->ui->label->setText( message );
 }
 
+//-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-
+void QVTKProgressDialog::setCancellationToken( const std::shared_ptr< Alder::CancellationToken > &token )
+{
+  this->token = token;
+}
+
+//-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-
+void QVTKProgressDialog::setProgressJob( const std::shared_ptr< Alder::ProgressChannel::Job > &job )
+{
+  this->job = job;
+
+  // only updates posted after the job is given to the dialog are shown
+  Alder::ProgressChannel *channel = Alder::ProgressChannel::GetInstance();
+  Alder::ProgressChannel::State state;
+  this->globalSequence = 0;
+  this->localSequence = 0;
+  channel->Read( *this->job, true, state, this->globalSequence );
+  channel->Read( *this->job, false, state, this->localSequence );
+}
+
+//-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-
+void QVTKProgressDialog::Pump()
+{
+  this->slotUpdate();
+  QApplication::processEvents();
+}
+
 //-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-
 void QVTKProgressDialog::slotCancel()
 {
-  Alder::Application::GetInstance()->SetAbortFlag( true );
+  if( this->token ) this->token->Cancel();
+  else Alder::Application::GetInstance()->SetAbortFlag( true );
 }
 
 //-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-
-void QVTKProgressDialog::Command::Execute(
-  vtkObject *caller, unsigned long eventId, void *callData )
+void QVTKProgressDialog::slotUpdate()
 {
-  if( this->ui )
-  {
-    QProgressBar *progressBar;
-
-    if( vtkCommand::ConfigureEvent == eventId )
-    { // configure the progress bar
-      // pair contains two bools: < which progress bar?, show as busy? >
-      std::pair<bool, bool> progressConfig = *( static_cast< std::pair<bool, bool>* >( callData ) );
-      progressBar = progressConfig.first ? this->ui->globalProgressBar : this->ui->localProgressBar;
-      progressBar->setRange( 0, progressConfig.second ? 0 : 100 );
-    }
-    else if( vtkCommand::StartEvent == eventId )
-    { // set the progress to 0
-      // which progress bar?
-      bool global = *( static_cast< bool* >( callData ) );
-      progressBar = global ? this->ui->globalProgressBar : this->ui->localProgressBar;
-      if( 0 < progressBar->maximum() ) progressBar->setValue( 0 );
-    }
-    else if( vtkCommand::ProgressEvent == eventId )
-    { // set the progress to the call data
-      // pair contains bool and double; < which progress bar?, progress value >
-      std::pair<bool, double> progressConfig = *( static_cast< std::pair<bool, double>* >( callData ) );
-      progressBar = progressConfig.first ? this->ui->globalProgressBar : this->ui->localProgressBar;
-      if( 0 < progressBar->maximum() )
-      {
-        int percent = static_cast<int>( 100 * progressConfig.second );
-        progressBar->setValue( percent );
-      }
-    }
-    else if( vtkCommand::EndEvent == eventId )
-    { // set the progress to 100
-      // which progress bar?
-      bool global = *( static_cast< bool* >( callData ) );
-      progressBar = global ? this->ui->globalProgressBar : this->ui->localProgressBar;
-      progressBar->setValue( 100 );
-    }
-
-    QApplication::processEvents();
-  }
+  this->updateProgressBar( true, this->ui->globalProgressBar, this->globalSequence );
+  this->updateProgressBar( false, this->ui->localProgressBar, this->localSequence );
+}
+
+//-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-
+void QVTKProgressDialog::updateProgressBar(
+  const bool global, QProgressBar *progressBar, unsigned int &sequence )
+{
+  Alder::ProgressChannel::State state;
+  if( !Alder::ProgressChannel::GetInstance()->Read( *this->job, global, state, sequence ) ) return;
+
+  // a busy bar has no maximum and animates on its own
+  int maximum = state.Busy ? 0 : 100;
+  if( maximum != progressBar->maximum() ) progressBar->setRange( 0, maximum );
+  if( 0 < maximum ) progressBar->setValue( static_cast< int >( 100 * state.Progress ) );
 }
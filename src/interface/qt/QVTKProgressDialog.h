@@ -14,25 +14,21 @@
 
 #include <QDialog>
 
-#include "vtkCommand.h"
-#include "vtkSmartPointer.h"
+#include "ProgressChannel.h"
 
+#include <memory>
+
+namespace Alder {
+class CancellationToken;
+};
+
+class QProgressBar;
+class QTimer;
 class Ui_QVTKProgressDialog;
 
-class QVTKProgressDialog : public QDialog
+class QVTKProgressDialog : public QDialog, public Alder::ProgressChannel::Consumer
 {
   Q_OBJECT
-private:
-  class Command : public vtkCommand
-  {
-  public:
-    static Command *New() { return new Command; }
-    void Execute( vtkObject *caller, unsigned long eventId, void *callData );
-    Ui_QVTKProgressDialog *ui;
-
-  protected:
-    Command() { this->ui = NULL; }
-  };  
 
 public:
   //constructor
@@ -41,14 +37,32 @@ public:
   ~QVTKProgressDialog();
 
   void setMessage( QString message );
-  
+
+  // cancelling the dialog cancels the job which owns the token instead of setting the
+  // application's abort flag
+  void setCancellationToken( const std::shared_ptr< Alder::CancellationToken > &token );
+
+  // the dialog shows the progress of its own job unless it is given the job of another thread
+  // (work done on the dialog's thread must bind the thread to the dialog's job while it's done)
+  void setProgressJob( const std::shared_ptr< Alder::ProgressChannel::Job > &job );
+  std::shared_ptr< Alder::ProgressChannel::Job > getProgressJob() const { return this->job; }
+
+  // called by the progress channel while work is being done on the dialog's thread
+  void Pump();
+
 public slots:
   virtual void slotCancel();
+  virtual void slotUpdate();
 
 protected:
-  vtkSmartPointer< Command > observer;
+  // applies the latest state of one of the channel's tasks to its progress bar
+  void updateProgressBar( const bool global, QProgressBar *progressBar, unsigned int &sequence );
 
-protected slots:
+  QTimer *timer;
+  std::shared_ptr< Alder::CancellationToken > token;
+  std::shared_ptr< Alder::ProgressChannel::Job > job;
+  unsigned int globalSequence;
+  unsigned int localSequence;
 
 private:
   // Designer form
@@ -20,6 +20,7 @@
 #include "User.h"
 
 #include "vtkEventQtSlotConnect.h"
+#include "vtkImageThumbnailCache.h"
 #include "vtkMedicalImageViewer.h"
 #include "vtkNew.h"
 #include "vtkRenderer.h"
@@ -67,6 +68,13 @@ QAlderAtlasWidget::QAlderAtlasWidget( QWidget* parent )
   this->Viewer->InterpolateOff();
   this->Viewer->SetImageToSinusoid();
 
+  // the navigation buttons show the thumbnails of the neighbouring atlas images
+  if( !vtkImageThumbnailCache::GetDirectory().empty() )
+  {
+    this->ui->previousPushButton->setIconSize( QSize( 48, 48 ) );
+    this->ui->nextPushButton->setIconSize( QSize( 48, 48 ) );
+  }
+
   this->updateEnabled();
 };
 
@@ -190,9 +198,20 @@ void QAlderAtlasWidget::updateInfo()
   QString uidString = tr( "N/A" );
   QString codeString = tr( "N/A" );
 
+  std::string previousThumbnail, nextThumbnail;
+
   Alder::Image *image = Alder::Application::GetInstance()->GetActiveAtlasImage();
   if( image )
   {
+    if( !vtkImageThumbnailCache::GetDirectory().empty() )
+    {
+      int rating = this->ui->ratingComboBox->currentIndex() + 1;
+      vtkSmartPointer< Alder::Image > previousImage = image->GetPreviousAtlasImage( rating );
+      if( previousImage->Get( "Id" ).IsValid() ) previousThumbnail = previousImage->GetThumbnailFileName();
+      vtkSmartPointer< Alder::Image > nextImage = image->GetNextAtlasImage( rating );
+      if( nextImage->Get( "Id" ).IsValid() ) nextThumbnail = nextImage->GetThumbnailFileName();
+    }
+
     vtkSmartPointer< Alder::Exam > exam;
     vtkSmartPointer< Alder::Interview > interview;
     if( image->GetRecord( exam ) && exam->GetRecord( interview ) )
@@ -217,13 +236,21 @@ void QAlderAtlasWidget::updateInfo()
   this->ui->infoDateValueLabel->setText( dateString );
   this->ui->infoCodeValueLabel->setText( codeString );
   this->ui->infoUIdValueLabel->setText( uidString );
+  this->ui->previousPushButton->setIcon(
+    previousThumbnail.empty() ? QIcon() : QIcon( previousThumbnail.c_str() ) );
+  this->ui->nextPushButton->setIcon(
+    nextThumbnail.empty() ? QIcon() : QIcon( nextThumbnail.c_str() ) );
 }
 
 //-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-
 void QAlderAtlasWidget::updateViewer()
 {
   Alder::Image *image = Alder::Application::GetInstance()->GetActiveAtlasImage();
-  if( image ) this->Viewer->Load( image->GetFileName().c_str() );
+  if( image )
+  {
+    // use the cine rate recorded in the database rather than the one in the file's header
+    this->Viewer->Load( image->GetFileName().c_str(), image->GetDICOMAttribute( "CineRate" ).ToInt() );
+  }
   else this->Viewer->SetImageToSinusoid();
 }
 
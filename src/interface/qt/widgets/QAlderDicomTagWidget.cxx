@@ -133,7 +133,7 @@ void QAlderDicomTagWidgetPrivate::updateUi()
   this->tableWidget->setColumnCount( labels.size() );
   
   this->clearDicomStrings();
-  if(image)
+  if( image && image->IsStored() )
   {
     this->buildDicomStrings( image->GetFileName() );
 
@@ -20,11 +20,13 @@
 #include "User.h"
 
 #include "vtkEventQtSlotConnect.h"
+#include "vtkImageThumbnailCache.h"
 #include "vtkMedicalImageViewer.h"
 #include "vtkNew.h"
 #include "vtkRenderer.h"
 #include "vtkRenderWindow.h"
 
+#include "QInterviewDownloadThread.h"
 #include "QVTKProgressDialog.h"
 
 #include <QMessageBox>
@@ -40,9 +42,13 @@ QAlderInterviewWidget::QAlderInterviewWidget( QWidget* parent )
   
   this->ui = new Ui_QAlderInterviewWidget;
   this->ui->setupUi( this );
+  this->downloadThread = NULL;
+  this->downloadDialog = NULL;
   
   // set up child widgets
   this->ui->examTreeWidget->header()->hide();
+  if( !vtkImageThumbnailCache::GetDirectory().empty() )
+    this->ui->examTreeWidget->setIconSize( QSize( 48, 48 ) );
 
   QObject::connect(
     this->ui->previousPushButton, SIGNAL( clicked() ),
@@ -106,6 +112,7 @@ QAlderInterviewWidget::QAlderInterviewWidget( QWidget* parent )
 //-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-
 QAlderInterviewWidget::~QAlderInterviewWidget()
 {
+  this->cancelDownload();
 }
 
 //-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-
@@ -168,19 +175,127 @@ void QAlderInterviewWidget::updateActiveInterview( Alder::Interview* interview )
     {
       interview->UpdateExamData();
     } 
-    if( !interview->HasImageData() )
+
+    // the images are downloaded after the interview is made active so that the rater can start
+    // on the first exam to arrive
+    Alder::Application *app = Alder::Application::GetInstance();
+    std::string lastImageId;
+    if( app->GetActiveImage() ) lastImageId = app->GetActiveImage()->Get( "Id" ).ToString();
+    app->SetActiveInterview( interview );
+    this->downloadImageData( lastImageId );
+  }
+}
+
+//-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-
+void QAlderInterviewWidget::downloadImageData( const std::string similarImageId )
+{
+  Alder::Application *app = Alder::Application::GetInstance();
+  Alder::Interview *interview = app->GetActiveInterview();
+  std::string interviewId = interview ? interview->Get( "Id" ).ToString() : "";
+
+  // only one interview is downloaded at a time
+  if( this->downloadThread )
+  {
+    if( interviewId == this->downloadThread->getInterviewId() ) return;
+    this->cancelDownload();
+  }
+  if( !interview || interview->HasImageData() ) return;
+
+  this->similarImageId = similarImageId;
+  this->downloadThread = new QInterviewDownloadThread( interviewId, this );
+  QObject::connect(
+    this->downloadThread, SIGNAL( examDownloaded( int ) ),
+    this, SLOT( slotExamDownloaded( int ) ) );
+  QObject::connect(
+    this->downloadThread, SIGNAL( finished() ),
+    this, SLOT( slotDownloadFinished() ) );
+
+  // the progress dialog doesn't block the rest of the interface
+  this->downloadDialog = new QVTKProgressDialog( this );
+  this->downloadDialog->setModal( false );
+  this->downloadDialog->setWindowTitle( tr( "Downloading Exam Images" ) );
+  this->downloadDialog->setMessage(
+    tr( "The interview's images are being downloaded, exams can be rated as they arrive." ) );
+  this->downloadDialog->setCancellationToken( this->downloadThread->getCancellationToken() );
+  this->downloadDialog->setProgressJob( this->downloadThread->getProgressJob() );
+  this->downloadDialog->show();
+
+  this->downloadThread->start();
+  this->updateExamTreeWidget();
+}
+
+//-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-
+void QAlderInterviewWidget::cancelDownload()
+{
+  if( this->downloadThread )
+  {
+    // the cancelled thread stops at its next chance and is deleted once it has
+    QObject::disconnect( this->downloadThread, 0, this, 0 );
+    QObject::connect(
+      this->downloadThread, SIGNAL( finished() ),
+      this->downloadThread, SLOT( deleteLater() ) );
+    this->downloadThread->cancel();
+    if( this->downloadThread->isFinished() ) this->downloadThread->deleteLater();
+    this->downloadThread = NULL;
+  }
+
+  if( this->downloadDialog )
+  {
+    this->downloadDialog->accept();
+    this->downloadDialog->deleteLater();
+    this->downloadDialog = NULL;
+  }
+}
+
+//-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-
+void QAlderInterviewWidget::slotExamDownloaded( int examId )
+{
+  Alder::Application *app = Alder::Application::GetInstance();
+  Alder::Interview *interview = app->GetActiveInterview();
+
+  // show the image similar to the one which was being rated as soon as it has arrived
+  if( interview && !app->GetActiveImage() && !this->similarImageId.empty() )
+  {
+    std::string similar = interview->GetSimilarImage( this->similarImageId );
+    if( !similar.empty() )
     {
-      // create a progress dialog to observe the progress of the update
-      QVTKProgressDialog dialog( this );
-      dialog.setModal( true );
-      dialog.setWindowTitle( tr( "Downloading Exam Images" ) );
-      dialog.setMessage( tr( "Please wait while the interview's images are downloaded." ) );
-      dialog.open();
-      interview->UpdateImageData();
-      dialog.accept();
+      vtkNew< Alder::Image > image;
+      image->Load( "Id", similar );
+      app->SetActiveImage( image.GetPointer() );
+      this->similarImageId = "";
     }
-    
-    Alder::Application::GetInstance()->SetActiveInterview( interview );
+  }
+
+  this->updateExamTreeWidget();
+}
+
+//-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-
+void QAlderInterviewWidget::slotDownloadFinished()
+{
+  // ignore the notice of a download which was cancelled after it was sent
+  if( !this->downloadThread || !this->downloadThread->isFinished() ) return;
+
+  QString error = this->downloadThread->getError();
+  this->downloadThread->deleteLater();
+  this->downloadThread = NULL;
+
+  if( this->downloadDialog )
+  {
+    this->downloadDialog->accept();
+    this->downloadDialog->deleteLater();
+    this->downloadDialog = NULL;
+  }
+
+  this->similarImageId = "";
+  this->updateExamTreeWidget();
+
+  if( !error.isEmpty() )
+  {
+    QMessageBox errorMessage( this );
+    errorMessage.setWindowModality( Qt::WindowModal );
+    errorMessage.setIcon( QMessageBox::Warning );
+    errorMessage.setText( error );
+    errorMessage.exec();
   }
 }
 
@@ -207,7 +322,7 @@ void QAlderInterviewWidget::slotRatingChanged( int value )
   // make sure we have an active user and image
   Alder::User *user = app->GetActiveUser();
   Alder::Image *image = app->GetActiveImage();
-  if( user && image )
+  if( user && image && image->IsStored() )
   {
     // See if we have a rating for this user and image
     std::map< std::string, std::string > map;
@@ -343,6 +458,10 @@ void QAlderInterviewWidget::updateExamTreeWidget()
     QTreeWidgetItem *item = NULL;
     std::map< std::string, QTreeWidgetItem* > modalityLookup;
 
+    // the images of exams which are still being downloaded can't be viewed yet
+    bool downloading = this->downloadThread &&
+      interview->Get( "Id" ).ToString() == this->downloadThread->getInterviewId();
+
     // make root the interview's UID and date
     QString name = tr( "Interview: " );
     name += interview->Get( "UId" ).ToString().c_str();
@@ -393,11 +512,15 @@ void QAlderInterviewWidget::updateExamTreeWidget()
       std::string examType = exam->Get( "Type" ).ToString();
       name += examType.c_str();
 
+      bool pending = downloading && !exam->HasImageData();
+      if( pending ) name += tr( " (downloading)" );
+
       QTreeWidgetItem *examItem = new QTreeWidgetItem( parentItem );
       this->treeModelMap[examItem] = *examIt;
       examItem->setText( 0, name );
       examItem->setExpanded( true );
       examItem->setFlags( Qt::ItemIsEnabled );
+      if( pending ) continue;
 
       // add the images for this exam
       std::vector< vtkSmartPointer< Alder::Image > > imageList;
@@ -413,8 +536,9 @@ void QAlderInterviewWidget::updateExamTreeWidget()
       {
         Alder::Image *image = imageIt->GetPointer();
         
-        // don't show images with parents (that happens in the loop below instead)
-        if( !image->Get( "ParentImageId" ).IsValid() )
+        // images left by an unfinished download aren't shown until their files are stored, and
+        // images with parents are shown in the loop below instead
+        if( image->IsStored() && !image->Get( "ParentImageId" ).IsValid() )
         {
           name = tr( "Image #" );
           name += image->Get( "Acquisition" ).ToString().c_str();
@@ -422,7 +546,10 @@ void QAlderInterviewWidget::updateExamTreeWidget()
           this->treeModelMap[imageItem] = *imageIt;
           imageItem->setText( 0, name );
 
-          if( "CarotidIntima" == examType || "Plaque" == examType )
+          // show the image's thumbnail, if it has one, otherwise mark cineloops
+          std::string thumbnail = image->GetThumbnailFileName();
+          if( !thumbnail.empty() ) imageItem->setIcon( 0, QIcon( thumbnail.c_str() ) );
+          else if( "CarotidIntima" == examType || "Plaque" == examType )
           {
             std::vector<int> dims = image->GetDICOMDimensions();
             if ( dims.size() > 2 && dims[2] > 1 )
@@ -443,11 +570,14 @@ void QAlderInterviewWidget::updateExamTreeWidget()
                ++childImageIt )
           {
             Alder::Image *childImage = childImageIt->GetPointer();
+            if( !childImage->IsStored() ) continue;
             name = tr( "Image #" );
             name += childImage->Get( "Acquisition" ).ToString().c_str();
             QTreeWidgetItem *childImageItem = new QTreeWidgetItem( imageItem );
             this->treeModelMap[childImageItem] = *childImageIt;
             childImageItem->setText( 0, name );
+            thumbnail = childImage->GetThumbnailFileName();
+            if( !thumbnail.empty() ) childImageItem->setIcon( 0, QIcon( thumbnail.c_str() ) );
             childImageItem->setFlags( Qt::ItemIsSelectable | Qt::ItemIsEnabled );
 
             if( activeImage && activeImageId == childImage->Get( "Id" ) )
@@ -513,7 +643,11 @@ void QAlderInterviewWidget::updateRating()
 void QAlderInterviewWidget::updateViewer()
 {
   Alder::Image *image = Alder::Application::GetInstance()->GetActiveImage();
-  if( image ) this->Viewer->Load( image->GetFileName().c_str() );
+  if( image && image->IsStored() )
+  {
+    // use the cine rate recorded in the database rather than the one in the file's header
+    this->Viewer->Load( image->GetFileName().c_str(), image->GetDICOMAttribute( "CineRate" ).ToInt() );
+  }
   else this->Viewer->SetImageToSinusoid();
 }
 
@@ -531,6 +665,8 @@ void QAlderInterviewWidget::updateEnabled()
   this->ui->nextPushButton->setEnabled( interview );
   this->ui->examTreeWidget->setEnabled( interview );
 
-  this->ui->ratingSlider->setEnabled( image );
-  this->ui->noteTextEdit->setEnabled( image );
+  // images left by an unfinished download can't be rated
+  bool stored = image && image->IsStored();
+  this->ui->ratingSlider->setEnabled( stored );
+  this->ui->noteTextEdit->setEnabled( stored );
 }
@@ -17,6 +17,7 @@
 #include "vtkSmartPointer.h"
 
 #include <map>
+#include <string>
 
 namespace Alder { 
 class ActiveRecord; 
@@ -26,7 +27,9 @@ class Interview;
 class vtkEventQtSlotConnect;
 class vtkMedicalImageViewer;
 class Ui_QAlderInterviewWidget;
+class QInterviewDownloadThread;
 class QTreeWidgetItem;
+class QVTKProgressDialog;
 
 class QAlderInterviewWidget : public QWidget
 {
@@ -38,6 +41,20 @@ public:
 
   vtkMedicalImageViewer *GetViewer();
 
+  /**
+   * Downloads the active interview's image data in the background (if it hasn't been already),
+   * cancelling the download of any other interview.  The exam tree is updated as each exam's
+   * images are received.
+   * @param similarImageId string An image of the previous interview, the similar image of the
+   *                              active interview is made active as soon as it is received
+   */
+  void downloadImageData( const std::string similarImageId = "" );
+
+  /**
+   * Cancels the download in progress, if any
+   */
+  void cancelDownload();
+
 public slots:
   virtual void slotPrevious();
   virtual void slotNext();
@@ -50,6 +67,8 @@ public slots:
   virtual void updateRating();
   virtual void updateViewer();
   virtual void updateEnabled();
+  virtual void slotExamDownloaded( int examId );
+  virtual void slotDownloadFinished();
 
 protected:
 
@@ -64,6 +83,11 @@ private:
   vtkSmartPointer<vtkMedicalImageViewer> Viewer;
   vtkSmartPointer<vtkEventQtSlotConnect> Connections;
 
+  // the background download of an interview's image data and the dialog showing its progress
+  QInterviewDownloadThread *downloadThread;
+  QVTKProgressDialog *downloadDialog;
+  std::string similarImageId;
+
   /**
    * Internal update method used in slotPrevious, slotNext
    */
@@ -172,11 +172,11 @@ namespace Alder
   int ActiveRecord::GetLastInsertId() const
   {
     vtkSmartPointer<vtkAlderMySQLQuery> query = Application::GetInstance()->GetDB()->GetQuery();
-    std::stringstream stream;
-    stream << "SELECT Max( Id ) FROM " << this->GetName();
-    
+
+    // LAST_INSERT_ID() is per connection, so records inserted by other connections at the
+    // same time (eg: by alder-sync) don't get in the way
     Utilities::log( "Getting last insert id for table: " + this->GetName() );
-    query->SetQuery( stream.str().c_str() );
+    query->SetQuery( "SELECT LAST_INSERT_ID()" );
     query->Execute();
 
     if( query->HasError() )
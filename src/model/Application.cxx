@@ -11,8 +11,10 @@
 
 #include "Application.h"
 
+#include "CancellationToken.h"
 #include "Configuration.h"
 #include "Database.h"
+#include "DicomAttribute.h"
 #include "Exam.h"
 #include "Image.h"
 #include "Interview.h"
@@ -25,11 +27,12 @@
 #include "vtkObjectFactory.h"
 #include "vtkVariant.h"
 
+#include <mutex>
 #include <stdexcept>
 
 namespace Alder
 {
-  Application* Application::Instance = NULL; // set the initial application
+  thread_local Application* Application::Instance = NULL; // set the initial application
 
   //-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-
   Application::Application()
@@ -44,6 +47,8 @@ namespace Alder
     this->ActiveAtlasImage = NULL;
 
     // populate the constructor and class name registries with all active record classes
+    this->ConstructorRegistry["DicomAttribute"] = &createInstance<DicomAttribute>;
+    this->ClassNameRegistry["DicomAttribute"] = typeid(DicomAttribute).name();
     this->ConstructorRegistry["Exam"] = &createInstance<Exam>;
     this->ClassNameRegistry["Exam"] = typeid(Exam).name();
     this->ConstructorRegistry["Image"] = &createInstance<Image>;
@@ -146,6 +151,20 @@ namespace Alder
     return ""; // this will never happen because of the throw
   }
   
+  //-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-
+  void Application::Setup( const std::string filename )
+  {
+    // the database client and xml libraries can't be initialized by more than one thread at once
+    static std::mutex setupMutex;
+    std::lock_guard< std::mutex > lock( setupMutex );
+
+    if( !this->ReadConfiguration( filename ) )
+      throw std::runtime_error( "Error while reading configuration file \"" + filename + "\"" );
+    if( !this->ConnectToDatabase() )
+      throw std::runtime_error( "Error while connecting to the database" );
+    this->SetupOpalService();
+  }
+
   //-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-
   bool Application::ReadConfiguration( std::string filename )
   {
@@ -188,9 +207,20 @@ namespace Alder
     std::string host = this->Config->GetValue( "Opal", "Host" );
     std::string port = this->Config->GetValue( "Opal", "Port" );
     std::string timeout = this->Config->GetValue( "Opal", "Timeout" );
+    std::string maximumTransfers = this->Config->GetValue( "Opal", "MaximumTransfers" );
+    std::string cacheLifetime = this->Config->GetValue( "Opal", "CacheLifetime" );
+    std::string statisticsInterval = this->Config->GetValue( "Opal", "StatisticsInterval" );
     this->Opal->Setup( user, pass, host );
     if( 0 < port.length() ) this->Opal->SetPort( vtkVariant( port ).ToInt() );
     if( 0 < timeout.length() ) this->Opal->SetTimeout( vtkVariant( timeout ).ToInt() );
+    if( 0 < maximumTransfers.length() )
+      this->Opal->SetMaximumTransfers( vtkVariant( maximumTransfers ).ToInt() );
+    if( 0 < cacheLifetime.length() ) this->Opal->SetCacheLifetime( vtkVariant( cacheLifetime ).ToInt() );
+    if( 0 < statisticsInterval.length() )
+      this->Opal->SetStatisticsInterval( vtkVariant( statisticsInterval ).ToInt() );
+
+    // responses are only cached if a cache directory is configured
+    this->Opal->SetCacheDirectory( this->Config->GetValue( "Path", "OpalCache" ) );
   }
 
   //-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-
@@ -280,6 +310,12 @@ namespace Alder
     this->InvokeEvent( Application::ActiveAtlasImageEvent );
   }
   
+  //-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-
+  bool Application::GetAbortFlag()
+  {
+    return this->AbortFlag || ( this->Token && this->Token->IsCancelled() );
+  }
+
   //-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-
   void Application::UpdateActiveInterviewImageData()
   {
@@ -35,6 +35,7 @@
 #include "vtkCommand.h"
 
 #include <iostream>
+#include <memory>
 #include <stdexcept>
 
 /**
@@ -44,6 +45,7 @@
 
 namespace Alder
 {
+  class CancellationToken;
   class Configuration;
   class Database;
   class Image;
@@ -54,6 +56,12 @@ namespace Alder
   {
   public:
     vtkTypeMacro( Application, ModelObject );
+
+    /**
+     * Returns the application instance.  Every thread has its own instance (and so its own
+     * configuration, database connection and Opal service) which it must set up before use
+     * and delete using DeleteInstance() before it exits.
+     */
     static Application *GetInstance();
     static void DeleteInstance();
     
@@ -66,6 +74,15 @@ namespace Alder
       ActiveAtlasImageEvent
     };
 
+    /**
+     * Sets up the calling thread's instance: reads the configuration from a given file, connects
+     * to the database and sets up the Opal service.  Threads are set up one at a time since the
+     * database client and xml libraries can't be initialized by more than one thread at once.
+     * @param filename string The file to read the configuration from
+     * @throws runtime_error
+     */
+    void Setup( const std::string filename );
+
     /**
      * Reads configuration variables from a given file
      * @param filename string The file to read the configuration from
@@ -150,14 +167,27 @@ namespace Alder
     std::string GetUnmangledClassName( const std::string mangledName ) const;
 
     vtkSetMacro( AbortFlag, bool );
-    vtkGetMacro( AbortFlag, bool );
+
+    /**
+     * Returns whether the operation in progress should stop, either because the abort flag
+     * is set or because the job the thread is running has been cancelled
+     */
+    virtual bool GetAbortFlag();
+
+    /**
+     * Sets the token of the job which the application's thread is running (or an empty
+     * pointer), see CancellationToken
+     */
+    void SetCancellationToken( const std::shared_ptr< CancellationToken > &token )
+    { this->Token = token; }
+    std::shared_ptr< CancellationToken > GetCancellationToken() const { return this->Token; }
     
   protected:
     Application();
     ~Application();
 
     static Application *New();
-    static Application *Instance;
+    static thread_local Application *Instance;
 
     Configuration *Config;
     Database *DB;
@@ -167,6 +197,7 @@ namespace Alder
     Image *ActiveImage;
     Image *ActiveAtlasImage;
     bool AbortFlag;
+    std::shared_ptr< CancellationToken > Token;
     
   private:
     Application( const Application& );  // Not implemented.
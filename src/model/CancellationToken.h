@@ -0,0 +1,64 @@
+/*=========================================================================
+
+  Program:  Alder (CLSA Medical Image Quality Assessment Tool)
+  Module:   CancellationToken.h
+  Language: C++
+
+  Author: Patrick Emond <emondpd AT mcmaster DOT ca>
+  Author: Dean Inglis <inglisd AT mcmaster DOT ca>
+
+=========================================================================*/
+
+/**
+ * @class CancellationToken
+ * @namespace Alder
+ *
+ * @author Patrick Emond <emondpd AT mcmaster DOT ca>
+ * @author Dean Inglis <inglisd AT mcmaster DOT ca>
+ *
+ * @brief Flag used to cancel a job which is running on another thread
+ *
+ * Each job has its own token, shared (by std::shared_ptr) between the thread which may cancel
+ * the job and the thread running it, so that cancelling one job can't affect any other.  The
+ * thread running the job hands the token to its Application (see SetCancellationToken()), after
+ * which the model treats a cancelled token the same as the application's abort flag.
+ */
+
+#ifndef __CancellationToken_h
+#define __CancellationToken_h
+
+#include <atomic>
+
+/**
+ * @addtogroup Alder
+ * @{
+ */
+
+namespace Alder
+{
+  class CancellationToken
+  {
+  public:
+    CancellationToken() : Cancelled( false ) {}
+
+    /**
+     * Asks the job to stop as soon as possible, may be called from any thread
+     */
+    void Cancel() { this->Cancelled = true; }
+
+    /**
+     * Returns whether the job has been asked to stop
+     */
+    bool IsCancelled() const { return this->Cancelled; }
+
+  private:
+    CancellationToken( const CancellationToken& ); /** Not implemented. */
+    void operator=( const CancellationToken& ); /** Not implemented. */
+
+    std::atomic< bool > Cancelled;
+  };
+}
+
+/** @} end of doxygen group */
+
+#endif
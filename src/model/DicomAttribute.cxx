@@ -0,0 +1,18 @@
+/*=========================================================================
+
+  Program:  Alder (CLSA Medical Image Quality Assessment Tool)
+  Module:   DicomAttribute.cxx
+  Language: C++
+
+  Author: Patrick Emond <emondpd AT mcmaster DOT ca>
+  Author: Dean Inglis <inglisd AT mcmaster DOT ca>
+
+=========================================================================*/
+#include "DicomAttribute.h"
+
+#include "vtkObjectFactory.h"
+
+namespace Alder
+{
+  vtkStandardNewMacro( DicomAttribute );
+}
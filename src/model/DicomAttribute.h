@@ -0,0 +1,58 @@
+/*=========================================================================
+
+  Program:  Alder (CLSA Medical Image Quality Assessment Tool)
+  Module:   DicomAttribute.h
+  Language: C++
+
+  Author: Patrick Emond <emondpd AT mcmaster DOT ca>
+  Author: Dean Inglis <inglisd AT mcmaster DOT ca>
+
+=========================================================================*/
+
+/**
+ * @class DicomAttribute
+ * @namespace Alder
+ * 
+ * @author Patrick Emond <emondpd AT mcmaster DOT ca>
+ * @author Dean Inglis <inglisd AT mcmaster DOT ca>
+ * 
+ * @brief An active record for the DicomAttribute table
+ *
+ * Each DICOM image has one record holding the attributes which Alder uses (see
+ * Image::StoreDICOMAttributes()), so that they are available without reading the image's file.
+ */
+
+#ifndef __DicomAttribute_h
+#define __DicomAttribute_h
+
+#include "ActiveRecord.h"
+
+#include <iostream>
+
+/**
+ * @addtogroup Alder
+ * @{
+ */
+
+namespace Alder
+{
+  class DicomAttribute : public ActiveRecord
+  {
+  public:
+    static DicomAttribute *New();
+    vtkTypeMacro( DicomAttribute, ActiveRecord );
+    std::string GetName() const { return "DicomAttribute"; }
+
+  protected:
+    DicomAttribute() {}
+    ~DicomAttribute() {}
+
+  private:
+    DicomAttribute( const DicomAttribute& ); // Not implemented
+    void operator=( const DicomAttribute& ); // Not implemented
+  };
+}
+
+/** @} end of doxygen group */
+
+#endif
@@ -0,0 +1,190 @@
+/*=========================================================================
+
+  Program:  Alder (CLSA Medical Image Quality Assessment Tool)
+  Module:   DicomMetadata.cxx
+  Language: C++
+
+  Author: Patrick Emond <emondpd AT mcmaster DOT ca>
+  Author: Dean Inglis <inglisd AT mcmaster DOT ca>
+
+=========================================================================*/
+#include "DicomMetadata.h"
+
+#include "gdcmReader.h"
+#include "gdcmStringFilter.h"
+
+#include <cstdlib>
+#include <list>
+#include <mutex>
+#include <stdexcept>
+#include <sys/stat.h>
+#include <unordered_map>
+
+namespace Alder
+{
+  namespace
+  {
+    // values longer than this are binary data which nothing asks for, so they aren't kept
+    const uint32_t MaximumValueLength = 256;
+
+    // what a file looked like when it was parsed, used to tell whether it has changed since
+    struct FileState
+    {
+      time_t ModifiedTime;
+      off_t Size;
+      ino_t Inode;
+
+      bool operator==( const FileState &other ) const
+      {
+        return this->ModifiedTime == other.ModifiedTime &&
+               this->Size == other.Size &&
+               this->Inode == other.Inode;
+      }
+    };
+
+    bool getFileState( const std::string fileName, FileState &state )
+    {
+      struct stat info;
+      if( 0 != stat( fileName.c_str(), &info ) ) return false;
+      state.ModifiedTime = info.st_mtime;
+      state.Size = info.st_size;
+      state.Inode = info.st_ino;
+      return true;
+    }
+
+    struct CacheEntry
+    {
+      FileState State;
+      std::shared_ptr< const DicomMetadata > Metadata;
+      std::list< std::string >::iterator Use;
+    };
+
+    // the cache, the most recently used file name is at the front of the use list
+    std::mutex cacheMutex;
+    std::unordered_map< std::string, CacheEntry > cache;
+    std::list< std::string > useList;
+
+    uint32_t makeKey( const uint16_t group, const uint16_t element )
+    {
+      return ( static_cast< uint32_t >( group ) << 16 ) | element;
+    }
+  }
+
+  //-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-
+  std::shared_ptr< const DicomMetadata > DicomMetadata::GetInstance( const std::string fileName )
+  {
+    FileState state;
+    if( !getFileState( fileName, state ) )
+      throw std::runtime_error( "Unable to find DICOM file \"" + fileName + "\"" );
+
+    {
+      std::lock_guard< std::mutex > lock( cacheMutex );
+      auto it = cache.find( fileName );
+      if( cache.end() != it && it->second.State == state )
+      {
+        useList.splice( useList.begin(), useList, it->second.Use );
+        return it->second.Metadata;
+      }
+    }
+
+    // parse the file without holding the lock so that other threads aren't kept waiting
+    std::shared_ptr< const DicomMetadata > metadata = DicomMetadata::Parse( fileName );
+
+    std::lock_guard< std::mutex > lock( cacheMutex );
+    auto it = cache.find( fileName );
+    if( cache.end() == it )
+    {
+      useList.push_front( fileName );
+      it = cache.insert( std::make_pair( fileName, CacheEntry() ) ).first;
+      it->second.Use = useList.begin();
+    }
+    else useList.splice( useList.begin(), useList, it->second.Use );
+    it->second.State = state;
+    it->second.Metadata = metadata;
+
+    // forget the least recently used files once the cache is full
+    while( DicomMetadata::CacheSize < static_cast< int >( useList.size() ) )
+    {
+      cache.erase( useList.back() );
+      useList.pop_back();
+    }
+
+    return metadata;
+  }
+
+  //-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-
+  void DicomMetadata::Forget( const std::string fileName )
+  {
+    std::lock_guard< std::mutex > lock( cacheMutex );
+    auto it = cache.find( fileName );
+    if( cache.end() != it )
+    {
+      useList.erase( it->second.Use );
+      cache.erase( it );
+    }
+  }
+
+  //-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-
+  std::shared_ptr< DicomMetadata > DicomMetadata::Parse( const std::string fileName )
+  {
+    // stop reading at the pixel data, which is all but a few kilobytes of the file
+    gdcm::Reader reader;
+    reader.SetFileName( fileName.c_str() );
+    if( !reader.ReadUpToTag( gdcm::Tag( 0x7fe0, 0x0010 ) ) )
+      throw std::runtime_error( "Unable to read \"" + fileName + "\" as a DICOM file" );
+
+    const gdcm::File &file = reader.GetFile();
+    const gdcm::DataSet &ds = file.GetDataSet();
+    gdcm::StringFilter filter;
+    filter.SetFile( file );
+
+    // the file meta information (group 0002, which has the transfer syntax) comes first
+    std::shared_ptr< DicomMetadata > metadata( new DicomMetadata );
+    const gdcm::DataSet *dataSets[] = { &file.GetHeader(), &ds };
+    for( int i = 0; i < 2; ++i )
+    {
+      const gdcm::DataSet::DataElementSet &elements = dataSets[i]->GetDES();
+      for( auto it = elements.cbegin(); it != elements.cend(); ++it )
+      {
+        const gdcm::Tag &tag = it->GetTag();
+        if( gdcm::VR::SQ == it->GetVR() || it->GetVL().IsUndefined() ||
+            MaximumValueLength < static_cast< uint32_t >( it->GetVL() ) ) continue;
+
+        // remove the padding (spaces and nulls) from the end of the value
+        std::string value = filter.ToString( tag );
+        std::string::size_type end = value.find_last_not_of( std::string( " \0", 2 ) );
+        value.erase( std::string::npos == end ? 0 : end + 1 );
+        metadata->Values[makeKey( tag.GetGroup(), tag.GetElement() )] = value;
+      }
+    }
+
+    return metadata;
+  }
+
+  //-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-
+  bool DicomMetadata::HasValue( const uint16_t group, const uint16_t element ) const
+  {
+    return this->Values.end() != this->Values.find( makeKey( group, element ) );
+  }
+
+  //-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-
+  std::string DicomMetadata::GetValue( const uint16_t group, const uint16_t element ) const
+  {
+    auto it = this->Values.find( makeKey( group, element ) );
+    return this->Values.end() == it ? std::string() : it->second;
+  }
+
+  //-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-
+  std::vector< int > DicomMetadata::GetDimensions() const
+  {
+    std::vector< int > dims( 3, 0 );
+    if( this->HasValue( 0x0028, 0x0011 ) && this->HasValue( 0x0028, 0x0010 ) )
+    {
+      dims[0] = atoi( this->GetValue( 0x0028, 0x0011 ).c_str() ); // columns
+      dims[1] = atoi( this->GetValue( 0x0028, 0x0010 ).c_str() ); // rows
+      int frames = atoi( this->GetValue( 0x0028, 0x0008 ).c_str() ); // number of frames
+      dims[2] = 0 < frames ? frames : 1;
+    }
+    return dims;
+  }
+}
@@ -0,0 +1,97 @@
+/*=========================================================================
+
+  Program:  Alder (CLSA Medical Image Quality Assessment Tool)
+  Module:   DicomMetadata.h
+  Language: C++
+
+  Author: Patrick Emond <emondpd AT mcmaster DOT ca>
+  Author: Dean Inglis <inglisd AT mcmaster DOT ca>
+
+=========================================================================*/
+
+/**
+ * @class DicomMetadata
+ * @namespace Alder
+ *
+ * @author Patrick Emond <emondpd AT mcmaster DOT ca>
+ * @author Dean Inglis <inglisd AT mcmaster DOT ca>
+ *
+ * @brief The header of a DICOM file, parsed without reading its pixel data
+ *
+ * Parsing stops at the pixel data element (7FE0,0010) so that the metadata of a cineloop costs
+ * as much as that of a single frame.  The values of the file meta information and of the data
+ * set's top level elements are kept as strings (sequences and long binary values are left out).
+ *
+ * The metadata of recently used files is kept in a cache which is shared by all threads.
+ * GetInstance() only parses a file when it isn't in the cache or when it has changed (been
+ * replaced or rewritten) since it was parsed, so repeated lookups don't touch the file's contents.
+ */
+
+#ifndef __DicomMetadata_h
+#define __DicomMetadata_h
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+/**
+ * @addtogroup Alder
+ * @{
+ */
+
+namespace Alder
+{
+  class DicomMetadata
+  {
+  public:
+    /**
+     * Returns the metadata of a DICOM file from the cache, parsing the file's header if needed
+     * @param fileName string The file to get the metadata of
+     * @throws runtime_error If the file is missing or isn't a DICOM file
+     */
+    static std::shared_ptr< const DicomMetadata > GetInstance( const std::string fileName );
+
+    /**
+     * Removes a file's metadata from the cache
+     */
+    static void Forget( const std::string fileName );
+
+    /**
+     * The number of files whose metadata is kept in the cache
+     */
+    static const int CacheSize = 1024;
+
+    /**
+     * Returns whether the data set has a (top level) element
+     */
+    bool HasValue( const uint16_t group, const uint16_t element ) const;
+
+    /**
+     * Returns an element's value as a string without padding, or an empty string if the data
+     * set doesn't have the element
+     */
+    std::string GetValue( const uint16_t group, const uint16_t element ) const;
+
+    /**
+     * Returns the number of columns, rows and frames of the image (frames is 1 for single frame
+     * images), or zeros if the file has no image
+     */
+    std::vector< int > GetDimensions() const;
+
+  private:
+    DicomMetadata() {}
+    DicomMetadata( const DicomMetadata& ); /** Not implemented. */
+    void operator=( const DicomMetadata& ); /** Not implemented. */
+
+    static std::shared_ptr< DicomMetadata > Parse( const std::string fileName );
+
+    // values by tag (group in the high word and element in the low word)
+    std::map< uint32_t, std::string > Values;
+  };
+}
+
+/** @} end of doxygen group */
+
+#endif
@@ -16,9 +16,12 @@
 #include "OpalService.h"
 #include "Utilities.h"
 
+#include "vtkImageThumbnailCache.h"
 #include "vtkNew.h"
 #include "vtkObjectFactory.h"
 
+#include <set>
+
 namespace Alder
 {
   vtkStandardNewMacro( Exam );
@@ -50,13 +53,58 @@ namespace Alder
 
   //-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-
   void Exam::UpdateImageData()
+  {
+    std::vector< OpalService::FileTransfer* > transfers;
+    std::map< std::string, std::vector< std::string > > metadata;
+    std::vector< std::string > variables = this->GetMetadataVariables();
+    if( !variables.empty() && !this->HasImageData() )
+    {
+      vtkSmartPointer< Interview > interview;
+      this->GetRecord( interview );
+      metadata = Application::GetInstance()->GetOpal()->GetValueSet(
+        "clsa-dcs-images", this->Get( "Type" ).ToString(), interview->Get( "UId" ).ToString(), variables );
+    }
+
+    this->PrepareImageData( transfers, metadata );
+    Application::GetInstance()->GetOpal()->SaveFiles( transfers ); // invokes progress events
+    this->FinishImageData();
+  }
+
+  //-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-
+  std::vector< std::string > Exam::GetMetadataVariables()
+  {
+    std::vector< std::string > variables;
+    std::string sideVariable = this->GetSideVariable();
+    if( !sideVariable.empty() ) variables.push_back( sideVariable );
+    return variables;
+  }
+
+  //-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-
+  std::string Exam::GetSideVariable()
+  {
+    // exams without laterality don't need to know which side each image belongs to
+    if( "none" == this->Get( "Laterality" ).ToString() ) return "";
+
+    std::string type = this->Get( "Type" ).ToString();
+    if( "CarotidIntima" == type || "Plaque" == type || "RetinalScan" == type ) return "Measure.SIDE";
+    else if( "DualHipBoneDensity" == type ) return "Measure.OUTPUT_HIP_SIDE";
+    else if( "ForearmBoneDensity" == type ) return "OUTPUT_FA_SIDE";
+    return "";
+  }
+
+  //-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-
+  void Exam::PrepareImageData(
+    std::vector< OpalService::FileTransfer* > &transfers,
+    const std::map< std::string, std::vector< std::string > > &metadata )
   {
     vtkSmartPointer< Interview > interview;
 
+    this->PendingImages.clear();
+    this->StoredImages.clear();
+
     // start by getting the UId
     this->GetRecord( interview );
     std::string UId = interview->Get( "UId" ).ToString();
-    bool result;
 
     if( !this->HasImageData() )
     {
@@ -66,191 +114,260 @@ namespace Alder
       settings[ "ExamId" ] = this->Get( "Id" );
       settings[ "Acquisition" ] = 1;
 
+      // the sides of the images provided by Opal, in the order they are stored in
+      std::vector< std::string > sideList;
+      auto found = metadata.find( this->GetSideVariable() );
+      if( metadata.end() != found ) sideList = found->second;
+
       if( "CarotidIntima" == type )
       {
-        // write cineloops 1, 2 and 3
-        // for now, assume that the parent image id for the still image
-        // associated with one of the 3 possible cineloops is the first valid one
-        bool hasParent = false;
-        std::string suffix = ".dcm.gz";
-        std::string sideVariable = "Measure.SIDE";
-        int acquisition = 0;
+        std::string suffix = ".dcm";
         bool repeatable = true;
 
+        // the still image's acquisition follows the last valid cineloop, which isn't known
+        // until the files have been retrieved (see FinishImageData)
+        // it is prepared first so that a still renumbered by an earlier download gives up the
+        // cineloops' acquisitions before they are saved
+        settings[ "Acquisition" ] = 4;
+        this->PrepareImage( type, "Measure.STILL_IMAGE", UId, settings, suffix, repeatable, sideList );
+
+        // write cineloops 1, 2 and 3
         for( int i = 1; i <= 3; ++i )
         {
           std::string variable = "Measure.CINELOOP_";
           variable += vtkVariant( i ).ToString();
           settings[ "Acquisition" ] = i;
-
-          result = this->RetrieveImage( 
-            type, variable, UId, settings, suffix, repeatable, sideVariable );
-
-          if( result )
-          {
-            hasParent = true;
-            acquisition = i;
-          }
+          this->PrepareImage( type, variable, UId, settings, suffix, repeatable, sideList );
         }
 
         //TODO: SR files still need to be downloaded and processed
-
-        acquisition++;
-        settings[ "Acquisition" ] = acquisition;
-        std::string variable = "Measure.STILL_IMAGE";
-        result = this->RetrieveImage( 
-          type, variable, UId, settings, suffix, repeatable, sideVariable );
-
-        if( hasParent && result )
-        {
-          // get the list of cIMT images in this exam
-
-          std::vector< vtkSmartPointer< Alder::Image > > imageList;
-          this->GetList( &imageList );
-          if( imageList.empty() ) 
-            throw std::runtime_error( "Failed list load during cIMT parenting" );
-
-          // map the AcquisitionDateTimes from the dicom file headers to the images
-
-          std::map< int, std::string > acqDateTimes;
-          for( auto imageIt = imageList.cbegin(); imageIt != imageList.cend(); ++imageIt )
-          {
-            Alder::Image *image = imageIt->GetPointer();
-            acqDateTimes[ image->Get( "Id" ).ToInt() ] = image->GetDICOMTag( "AcquisitionDateTime" );
-          }
-
-          // find which cineloop has a matching datetime to the still and set the still's
-          // ParentImageId
-
-          vtkNew< Alder::Image > still;
-          int stillId = still->GetLastInsertId();
-          std::string stillAcqDateTime = acqDateTimes[ stillId ];
-
-          // in case of no matching datetime associate the still with
-          // the group of cineloops
-
-          int parentId = -1;
-          for( auto mapIt = acqDateTimes.cbegin(); mapIt != acqDateTimes.cend(); mapIt++ )
-          {
-          
-            if( mapIt->first == stillId ) continue;
-            
-            if( mapIt->second == stillAcqDateTime ) 
-            {
-              parentId = mapIt->first;
-              break;
-            }
-            else
-            {
-              // use the last inserted cineloop Id in case of no match
-              parentId = mapIt->first > parentId ? mapIt->first : parentId;
-            }
-          }
-
-          if( parentId == -1 )
-            throw std::runtime_error( "Failed to parent cIMT still" );
-          
-          still->Load( "Id", vtkVariant( stillId ).ToString() );
-          still->Set( "ParentImageId", parentId );
-          still->Save();
-        }
       }
       else if( "DualHipBoneDensity" == type )
       {
         std::string variable = "Measure.RES_HIP_DICOM";
-        std::string sideVariable = "Measure.OUTPUT_HIP_SIDE";
         std::string suffix = ".dcm";
         bool repeatable = true;
-        this->RetrieveImage( type, variable, UId, settings, suffix, repeatable, sideVariable );
+        this->PrepareImage( type, variable, UId, settings, suffix, repeatable, sideList );
       }
       else if( "ForearmBoneDensity" == type )
       {
         std::string variable = "RES_FA_DICOM";
-        std::string sideVariable = "OUTPUT_FA_SIDE";
         std::string suffix = ".dcm";
         bool repeatable = false;
-        this->RetrieveImage( type, variable, UId, settings, suffix, repeatable, sideVariable );
+        this->PrepareImage( type, variable, UId, settings, suffix, repeatable, sideList );
       }
       else if( "LateralBoneDensity" == type )
       {
         std::string variable = "RES_SEL_DICOM_MEASURE";
         std::string suffix = ".dcm";
-        this->RetrieveImage( type, variable, UId, settings, suffix );
+        this->PrepareImage( type, variable, UId, settings, suffix );
       }
       else if( "Plaque" == type )
       {
         std::string variable = "Measure.CINELOOP_1";
-        std::string sideVariable = "Measure.SIDE";
-        std::string suffix = ".dcm.gz";        
+        std::string suffix = ".dcm";        
         bool repeatable = true;
-        this->RetrieveImage( type, variable, UId, settings, suffix, repeatable, sideVariable );
+        this->PrepareImage( type, variable, UId, settings, suffix, repeatable, sideList );
       }
       else if( "RetinalScan" == type )
       {
         std::string variable = "Measure.EYE";
-        std::string sideVariable = "Measure.SIDE";
         std::string suffix = ".jpg";
         bool repeatable = true;
-        this->RetrieveImage( type, variable, UId, settings, suffix, repeatable, sideVariable );
+        this->PrepareImage( type, variable, UId, settings, suffix, repeatable, sideList );
       }
       else if( "WholeBodyBoneDensity" == type )
       {
-        std::string variable = "RES_WB_DICOM_1";
         std::string suffix = ".dcm";
-        result = this->RetrieveImage( type, variable, UId, settings, suffix );
+        this->PrepareImage( type, "RES_WB_DICOM_1", UId, settings, suffix );
+        settings[ "Acquisition" ] = 2;
+        this->PrepareImage( type, "RES_WB_DICOM_2", UId, settings, suffix );
+      }
+    }
+
+    for( auto it = this->PendingImages.begin(); it != this->PendingImages.end(); ++it )
+      transfers.push_back( &( it->second ) );
+  }
+
+  //-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-
+  bool Exam::FinishImageData()
+  {
+    // images stored by an earlier attempt count along with the ones retrieved by this one
+    std::map< std::string, vtkSmartPointer< Image > > imageMap = this->StoredImages;
+    std::set< std::string > partialSet;
+    bool complete = true;
+
+    this->StoredImages.clear();
+    if( this->HasImageData() ) return true;
+
+    // check the headers of all retrieved files at once, in parallel
+    std::vector< Image* > retrievedList;
+    for( auto it = this->PendingImages.cbegin(); it != this->PendingImages.cend(); ++it )
+      if( it->second.Success ) retrievedList.push_back( it->first );
+    std::vector< bool > validList = Image::ValidateFiles( retrievedList );
+    std::map< Image*, bool > validMap;
+    for( size_t i = 0; i < retrievedList.size(); ++i ) validMap[retrievedList[i]] = validList[i];
+
+    // keep track of the valid images by variable name
+    for( auto it = this->PendingImages.cbegin(); it != this->PendingImages.cend(); ++it )
+    {
+      Image *image = it->first;
+      const OpalService::FileTransfer &transfer = it->second;
+      std::stringstream log;
+
+      if( !transfer.Success && transfer.Partial )
+      {
+        // keep the image and its incomplete file, the transfer is resumed by the next attempt
+        complete = false;
+        partialSet.insert( transfer.Variable );
+        log << "Keeping incomplete " << transfer.Variable << " (" << transfer.Error << ")";
+        Utilities::log( log.str() );
+      }
+      else if( !transfer.Success )
+      {
+        // the transfer failed, the file may be incomplete so remove it
+        complete = false;
+        remove( transfer.FileName.c_str() );
+        log << "Removing " << transfer.Variable << " from database (" << transfer.Error << ")";
+        Utilities::log( log.str() );
+        image->Remove();
+      }
+      else if( !validMap[image] )
+      {
+        log << "Removing " << transfer.Variable << " from database (invalid)";
+        Utilities::log( log.str() );
+        image->Remove();
+      }
+      else
+      {
+        // index the file in the image store using the hash computed while it was downloaded,
+        // and record its DICOM attributes so that they never have to be read from the file
+        image->StoreFile( transfer.Hash );
+        image->StoreDICOMAttributes();
+
+        // have the image's thumbnail made so that it can be shown without decoding the image (in
+        // the background, this may be running between the transfers of other exams)
+        vtkImageThumbnailCache::Enqueue( image->GetFileName() );
+        imageMap[transfer.Variable] = image;
+      }
+    }
+    this->PendingImages.clear();
 
-        if( result )
+    std::string type = this->Get( "Type" ).ToString();
+    if( "CarotidIntima" == type )
+    {
+      auto stillIt = imageMap.find( "Measure.STILL_IMAGE" );
+      if( imageMap.end() != stillIt )
+      {
+        Image *still = stillIt->second;
+
+        std::vector< Image* > cineloopList;
+        for( int i = 1; i <= 3; ++i )
         {
-          // store the previous image's id
-          vtkNew< Alder::Image > image;
-          int parentId = image->GetLastInsertId();
+          std::string variable = "Measure.CINELOOP_";
+          variable += vtkVariant( i ).ToString();
+          auto cineloopIt = imageMap.find( variable );
+          if( imageMap.end() != cineloopIt ) cineloopList.push_back( cineloopIt->second );
+        }
+
+        // the still's acquisition follows the last cineloop the exam has kept, which is only
+        // known once all of its images are retrieved (until then the still keeps its own
+        // acquisition so that it can't take that of a cineloop which is left to be resumed)
+        if( complete )
+        {
+          std::vector< vtkSmartPointer< Image > > imageList;
+          this->GetList( &imageList );
+          int acquisition = 0;
+          for( auto imageIt = imageList.cbegin(); imageIt != imageList.cend(); ++imageIt )
+          {
+            if( ( *imageIt )->Get( "Id" ).ToInt() == still->Get( "Id" ).ToInt() ) continue;
+            acquisition = std::max( acquisition, ( *imageIt )->Get( "Acquisition" ).ToInt() );
+          }
+          still->Set( "Acquisition", acquisition + 1 );
+        }
+
+        if( !cineloopList.empty() )
+        {
+          // find which cineloop has a matching AcquisitionDateTime in its dicom attributes to
+          // the still and set the still's ParentImageId
+          // in case of no matching datetime associate the still with the group of cineloops
+          std::string stillAcqDateTime = still->GetDICOMTag( "AcquisitionDateTime" );
+          int parentId = -1;
+          for( auto cineloopIt = cineloopList.cbegin(); cineloopIt != cineloopList.cend(); ++cineloopIt )
+          {
+            int id = ( *cineloopIt )->Get( "Id" ).ToInt();
+            if( ( *cineloopIt )->GetDICOMTag( "AcquisitionDateTime" ) == stillAcqDateTime )
+            {
+              parentId = id;
+              break;
+            }
+            else
+            {
+              // use the last inserted cineloop Id in case of no match
+              parentId = id > parentId ? id : parentId;
+            }
+          }
 
-          variable = "RES_WB_DICOM_2";
-          settings[ "Acquisition" ] = 2;
-          this->RetrieveImage( type, variable, UId, settings, suffix );
+          if( parentId == -1 )
+            throw std::runtime_error( "Failed to parent cIMT still" );
 
-          // re-parent this image to the first one
-          image->Load( "Id", vtkVariant( image->GetLastInsertId() ).ToString() );
-          image->Set( "ParentImageId", parentId );
+          still->Set( "ParentImageId", parentId );
+        }
+        still->Save();
+      }
+    }
+    else if( "WholeBodyBoneDensity" == type )
+    {
+      auto secondIt = imageMap.find( "RES_WB_DICOM_2" );
+      if( imageMap.end() != secondIt )
+      {
+        Image *image = secondIt->second;
+        auto firstIt = imageMap.find( "RES_WB_DICOM_1" );
+        if( imageMap.end() != firstIt )
+        {
+          // parent the second image to the first one
+          image->Set( "ParentImageId", firstIt->second->Get( "Id" ) );
           image->Save();
         }
+        else if( partialSet.end() == partialSet.find( "RES_WB_DICOM_1" ) )
+        {
+          // the second image is only kept along with the first one (unless the first one is
+          // still to be resumed, in which case it is parented once the first one is stored)
+          Utilities::log( "Removing RES_WB_DICOM_2 from database (no RES_WB_DICOM_1)" );
+          remove( image->GetFileName().c_str() );
+          image->Remove();
+        }
       }
+    }
 
-      // now set that we have downloaded all the images
+    // now set that we have downloaded all the images
+    if( complete )
+    {
       this->Set( "Downloaded", 1 );
       this->Save();
     }
+
+    return complete;
   }
 
   //-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-
-  bool Exam::RetrieveImage(
+  bool Exam::PrepareImage(
     const std::string type,
     const std::string variable,
     const std::string UId,
     const std::map<std::string, vtkVariant> settings,
     const std::string suffix,
     const bool repeatable,
-    const std::string sideVariable )
+    const std::vector< std::string > &sides )
   {
-    Application *app = Application::GetInstance();
-    OpalService *opal = app->GetOpal();
-    bool result = true;
     int sideIndex = 0;
     std::stringstream log;
     std::string laterality = this->Get( "Laterality" ).ToString();
 
     if( laterality != "none" )
     {
-      std::vector< std::string > sideList;
-      if( repeatable )
-      {
-        sideList = opal->GetValues( "clsa-dcs-images", type, UId, sideVariable );
-      }  
-      else
-      {
-        std::string side = opal->GetValue( "clsa-dcs-images", type, UId, sideVariable );
-        if( !side.empty() ) sideList.push_back( side );
-      }
+      std::vector< std::string > sideList = sides;
+      if( !repeatable && 1 < sideList.size() ) sideList.resize( 1 );
 
       int numSides = sideList.empty() ? 0 : sideList.size();
       
@@ -296,27 +413,55 @@ namespace Alder
       if( !found ) return false;
     }
 
+    // reuse the image record left by an earlier attempt which didn't complete (so that its file
+    // is replaced instead of orphaned), otherwise add a new entry in the image table
+    // records are found by the variable they were retrieved from since acquisitions are renumbered
+    // (see FinishImageData), records made before variables were recorded are found by acquisition
+    vtkSmartPointer< Alder::Image > image = vtkSmartPointer< Alder::Image >::New();
+    std::map< std::string, std::string > key;
+    key["ExamId"] = this->Get( "Id" ).ToString();
+    key["Variable"] = variable;
+    if( !image->Load( key ) )
+    {
+      key.erase( "Variable" );
+      key["Acquisition"] = settings.at( "Acquisition" ).ToString();
+      if( !image->Load( key ) || image->Get( "Variable" ).IsValid() )
+        image = vtkSmartPointer< Alder::Image >::New();
+    }
+
+    // an image whose file was stored by the earlier attempt isn't retrieved again (only the
+    // file's size is checked, the hash was computed as it was downloaded)
+    if( image->IsStored() && image->VerifyFile( false ) )
+    {
+      log << "Keeping " << variable << " stored by an earlier attempt for UId \"" << UId << "\"";
+      Utilities::log( log.str() );
+      this->StoredImages[variable] = image;
+      return true;
+    }
+
     log << "Adding " << variable << " to database for UId \"" << UId << "\"";
     Utilities::log( log.str() );
 
-    // add a new entry in the image table (or replace it)
-    vtkNew< Alder::Image > image;
+    // the file is retrieved again so nothing recorded about the old one still applies
+    const char* staleColumns[] = { "ParentImageId", "Hash", "Size", "Format", "FileName" };
+    for( int i = 0; i < 5; ++i ) image->SetNull( staleColumns[i] );
     for( auto it = settings.cbegin(); it != settings.cend(); it++ ) image->Set( it->first, it->second );
+    image->Set( "Variable", variable );
     image->Save( true );
 
-    // now write the file and validate it
-    std::string fileName = image->CreateFile( suffix );
-    opal->SaveFile( fileName, "clsa-dcs-images", type, UId, variable, repeatable ? sideIndex : -1 );
-
-    if( !image->ValidateFile() )
-    {
-      log.str( "" );
-      log << "Removing " << variable << " from database (invalid)";
-      Utilities::log( log.str() );
-      image->Remove();
-      result = false;
-    }
-    return result;
+    // the file is written once the transfer is performed
+    OpalService::FileTransfer transfer;
+    transfer.FileName = image->CreateFile( suffix );
+    transfer.DataSource = "clsa-dcs-images";
+    transfer.Table = type;
+    transfer.Identifier = UId;
+    transfer.Variable = variable;
+    transfer.Position = repeatable ? sideIndex : -1;
+    transfer.Decompress = true; // some images (eg: cineloops) are stored in Opal gzipped
+    this->PendingImages.push_back(
+      std::pair< vtkSmartPointer< Image >, OpalService::FileTransfer >( image.GetPointer(), transfer ) );
+
+    return true;
   }
 
   //-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-
@@ -23,8 +23,12 @@
 #define __Exam_h
 
 #include "ActiveRecord.h"
+#include "Image.h"
+#include "OpalService.h"
 
 #include <iostream>
+#include <list>
+#include <map>
 
 /**
  * @addtogroup Alder
@@ -55,28 +59,78 @@ namespace Alder
      */
     void UpdateImageData();
 
+    /**
+     * Returns the names of the variables in the exam's Opal table (clsa-dcs-images, named
+     * after the exam's type) which PrepareImageData() needs to plan the exam's downloads.
+     */
+    std::vector< std::string > GetMetadataVariables();
+
+    /**
+     * Creates an image record for each of the exam's images which has to be retrieved from
+     * Opal, appending the file transfers which provide them to the given list.  Images whose
+     * files were already stored by an earlier attempt which didn't complete aren't retrieved
+     * again (see Image::IsStored()).  The transfers
+     * may be performed along with those of other exams, after which FinishImageData() must be
+     * called.
+     * @param transfers vector The list to append the exam's file transfers to
+     * @param metadata map The values of the variables named by GetMetadataVariables()
+     * @throws exception
+     */
+    void PrepareImageData(
+      std::vector< OpalService::FileTransfer* > &transfers,
+      const std::map< std::string, std::vector< std::string > > &metadata );
+
+    /**
+     * Validates the files provided by the transfers created by PrepareImageData(), removing
+     * the images whose files could not be retrieved and adding the others to the image store
+     * (see Image::StoreFile() and Image::StoreDICOMAttributes()) and queueing their thumbnails
+     * (see vtkImageThumbnailCache::Enqueue()), then marks the exam as downloaded.
+     * Returns false if any transfer failed, in which case the exam is not marked as downloaded.
+     * @throws exception
+     */
+    bool FinishImageData();
+
     /**
      * Returns whether a user has rated all images associated with the exam.
      * If the exam has no images this method returns true.
      */
     bool IsRatedBy( User* user );
 
+  protected:
+    Exam() {}
+    ~Exam() {}
+
     /**
-     * Retrieves an image from Opal.
+     * Creates an image record and the file transfer which will retrieve it from Opal, or keeps
+     * the record of an image which an earlier attempt already stored.
+     * Returns false if Opal has no such image for the exam's laterality, as determined by
+     * the list of sides provided by Opal.
      * @throws exception 
      */
-    bool RetrieveImage(
+    bool PrepareImage(
       const std::string type,
       const std::string variable,
       const std::string UId,
       const std::map<std::string, vtkVariant> settings,
       const std::string suffix,
       const bool repeatable = false,
-      const std::string sideVariable = "" );
+      const std::vector< std::string > &sides = std::vector< std::string >() );
 
-  protected:
-    Exam() {}
-    ~Exam() {}
+    /**
+     * Returns the name of the Opal variable which holds the side of the exam's images, or an
+     * empty string if the exam has no laterality
+     */
+    std::string GetSideVariable();
+
+    /**
+     * Images created by PrepareImage() along with the transfers which retrieve them
+     */
+    std::list< std::pair< vtkSmartPointer< Image >, OpalService::FileTransfer > > PendingImages;
+
+    /**
+     * Images found by PrepareImage() to have been stored by an earlier attempt, by variable
+     */
+    std::map< std::string, vtkSmartPointer< Image > > StoredImages;
 
   private:
     Exam( const Exam& ); // Not implemented
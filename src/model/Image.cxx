@@ -11,20 +11,20 @@
 #include "Image.h"
 
 #include "Configuration.h"
+#include "DicomAttribute.h"
+#include "DicomMetadata.h"
 #include "Exam.h"
+#include "ImageFileValidator.h"
 #include "Interview.h"
 #include "Rating.h"
 #include "User.h"
 #include "Utilities.h"
 
 #include "vtkDirectory.h"
-#include "vtkImageDataReader.h"
+#include "vtkImageThumbnailCache.h"
 #include "vtkNew.h"
 #include "vtkObjectFactory.h"
 
-#include "gdcmImageReader.h"
-#include "gdcmDirectoryHelper.h"
-
 #include <stdexcept>
 
 namespace Alder
@@ -76,44 +76,137 @@ namespace Alder
   //-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-
   bool Image::ValidateFile()
   {
-    bool valid;
+    std::vector< Image* > images( 1, this );
+    return Image::ValidateFiles( images )[0];
+  }
+
+  //-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-
+  std::vector< bool > Image::ValidateFiles( const std::vector< Image* > &images )
+  {
+    // file names are looked up here since the database connection belongs to this thread
+    std::vector< std::string > fileNames;
+    for( auto it = images.cbegin(); it != images.cend(); ++it )
+      fileNames.push_back( ( *it )->GetFileName() );
+
+    // only the files' headers are checked, they are decoded when they are displayed
+    std::vector< bool > valid = ImageFileValidator::AreValid( fileNames );
+
+    // if a file isn't valid, remove it from the disk
+    for( size_t i = 0; i < fileNames.size(); ++i )
+      if( !valid[i] ) remove( fileNames[i].c_str() );
+
+    return valid;
+  }
+
+  //-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-
+  void Image::StoreFile( const std::string hash )
+  {
+    this->AssertPrimaryId();
+
     std::string fileName = this->GetFileName();
+    std::string digest = hash.empty() ? Utilities::hashFile( fileName ) : hash;
+    if( digest.empty() ) throw std::runtime_error( "Unable to read image file \"" + fileName + "\"" );
+    unsigned long size = Utilities::getFileLength( fileName );
+
+    // look for identical files already in the store
+    vtkSmartPointer< vtkAlderMySQLQuery > query = Application::GetInstance()->GetDB()->GetQuery();
+    std::stringstream stream;
+    stream << "SELECT Id FROM Image "
+           << "WHERE Hash = " << query->EscapeString( digest ) << " "
+           << "AND Size = " << size << " "
+           << "AND Id != " << this->Get( "Id" ).ToString();
 
-    // now check the file, if it is empty delete the image and the file
-    if( 0 == Utilities::getFileLength( fileName ) )
+    Utilities::log( "Querying Database: " + stream.str() );
+    query->SetQuery( stream.str().c_str() );
+    query->Execute();
+
+    if( query->HasError() )
     {
-      valid = false;
+      Utilities::log( query->GetLastErrorText() );
+      throw std::runtime_error( "There was an error while trying to query the database." );
     }
-    else // file exists
-    {
-      // if the file has a .gz extension, unzip it
-      if( ".gz" == fileName.substr( fileName.length() - 3, 3 ) )
-      {
-        std::string zipFileName = fileName;
-        fileName = fileName.substr( 0, fileName.length() - 3 );
 
-        std::string command = "gunzip ";
-        command += zipFileName;
+    std::vector< std::string > idList;
+    while( query->NextRow() ) idList.push_back( query->DataValue( 0 ).ToString() );
+
+    struct stat fileStat;
+    if( 0 != stat( fileName.c_str(), &fileStat ) )
+      throw std::runtime_error( "Unable to read image file \"" + fileName + "\"" );
 
-        // not a gz file, remove the .gz extension manually
-        Utilities::log( std::string( "Unzipping file: " ) + fileName );
-        if( "ERROR" == Utilities::exec( command ) )
-          rename( zipFileName.c_str(), fileName.c_str() );
+    for( auto it = idList.cbegin(); it != idList.cend(); ++it )
+    {
+      vtkNew< Image > image;
+      if( !image->Load( "Id", *it ) || !image->VerifyFile( false ) ) continue;
+      std::string identical = image->GetFileName();
+      struct stat identicalStat;
+      if( 0 != stat( identical.c_str(), &identicalStat ) ) continue;
+
+      // the files may already be the same file
+      if( fileStat.st_dev == identicalStat.st_dev && fileStat.st_ino == identicalStat.st_ino ) break;
+
+      // link to a temporary name first so that the file is never missing
+      std::string temporary = fileName + ".link";
+      remove( temporary.c_str() );
+      if( 0 == link( identical.c_str(), temporary.c_str() ) )
+      {
+        if( 0 == rename( temporary.c_str(), fileName.c_str() ) )
+        {
+          Utilities::log( "Linked \"" + fileName + "\" to identical image file \"" + identical + "\"" );
+          break;
+        }
+        remove( temporary.c_str() );
       }
+    }
 
-      // now see if we can read the file
-      valid = vtkImageDataReader::IsValidFileName( fileName.c_str() );
+    // the file's name is recorded relative to the image data directory so that GetFileName()
+    // doesn't have to look for it
+    std::string imageData =
+      Application::GetInstance()->GetConfig()->GetValue( "Path", "ImageData" ) + "/";
+    if( 0 == fileName.compare( 0, imageData.length(), imageData ) )
+      this->Set( "FileName", fileName.substr( imageData.length() ) );
+
+    std::string format = Utilities::toLower( Utilities::getFileExtension( fileName ) );
+    this->Set( "Hash", digest );
+    this->Set( "Size", size );
+    this->Set( "Format", format.empty() ? format : format.substr( 1 ) );
+    this->Save();
+  }
+
+  //-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-
+  bool Image::VerifyFile( const bool checkHash )
+  {
+    std::string fileName;
+    try
+    {
+      fileName = this->GetFileName();
+    }
+    catch( std::runtime_error &e )
+    {
+      return false;
     }
 
-    // if the file isn't valid, remove it from the disk
-    if( !valid ) remove( fileName.c_str() );
+    unsigned long size = Utilities::getFileLength( fileName );
+    vtkVariant hash = this->Get( "Hash" );
+    if( !hash.IsValid() ) return 0 < size;
+    if( size != this->Get( "Size" ).ToUnsignedLong() ) return false;
+    return !checkHash || hash.ToString() == Utilities::hashFile( fileName );
+  }
 
-    return valid;
+  //-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-
+  bool Image::IsStored()
+  {
+    return this->Get( "Hash" ).IsValid() && this->Get( "FileName" ).IsValid();
   }
 
   //-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-
   std::string Image::GetFileName()
   {
+    // stored images know their file's name, which doesn't need the exam or the disk to resolve
+    vtkVariant fileName = this->Get( "FileName" );
+    if( fileName.IsValid() )
+      return Application::GetInstance()->GetConfig()->GetValue( "Path", "ImageData" ) + "/" +
+             fileName.ToString();
+
     // make sure the path exists
     std::string path = this->GetFilePath();
 
@@ -127,12 +220,14 @@ namespace Alder
       throw std::runtime_error( error.str() );
     }
 
-    // we don't know the file type yet, search for all files which have our Id
+    // we don't know the file type yet, search for the file named by our Id and any suffix
+    // (making sure that image 12 doesn't find 123.dcm)
     std::string id = this->Get( "Id" ).ToString();
     for( vtkIdType index = 0; index < directory->GetNumberOfFiles(); index++ )
     {
       std::string fileName = directory->GetFile( index );
-      if( fileName.substr( 0, id.length() ) == id )
+      if( 0 == fileName.compare( 0, id.length(), id ) &&
+          ( fileName.length() == id.length() || '.' == fileName[id.length()] ) )
       {
         std::stringstream name;
         name << path << "/" << fileName;
@@ -146,6 +241,15 @@ namespace Alder
     throw std::runtime_error( error.str() );
   }
 
+  //-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-
+  std::string Image::GetThumbnailFileName()
+  {
+    // thumbnails are made once images are stored, so don't search the disk for unstored images
+    if( vtkImageThumbnailCache::GetDirectory().empty() || !this->Get( "FileName" ).IsValid() )
+      return "";
+    return vtkImageThumbnailCache::GetFileName( this->GetFileName() );
+  }
+
   //-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-
   bool Image::IsRatedBy( User* user )
   {
@@ -165,54 +269,109 @@ namespace Alder
   }
   
   //-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-
-  std::string Image::GetDICOMTag( const std::string tagName )
+  bool Image::StoreDICOMAttributes()
   {
     this->AssertPrimaryId();
 
     // get the name of the unzipped file
     std::string fileName = this->GetFileName();
-    if( ".gz" == fileName.substr( fileName.length() - 3, 3 ) )
+    if( ".gz" == Utilities::getFileExtension( fileName ) )
       fileName = fileName.substr( 0, fileName.length() - 3 );
+    if( ".dcm" != Utilities::toLower( Utilities::getFileExtension( fileName ) ) ) return false;
+
+    std::shared_ptr< const DicomMetadata > metadata = DicomMetadata::GetInstance( fileName );
+    std::vector< int > dims = metadata->GetDimensions();
+
+    vtkNew< DicomAttribute > attributes;
+    attributes->Set( "ImageId", this->Get( "Id" ) );
+    attributes->Set( "Width", dims[0] );
+    attributes->Set( "Height", dims[1] );
+    attributes->Set( "Frames", dims[2] );
+
+    std::map< std::string, std::pair< uint16_t, uint16_t > > textMap;
+    textMap["AcquisitionDateTime"] = std::make_pair( 0x0008, 0x002a );
+    textMap["PhotometricInterpretation"] = std::make_pair( 0x0028, 0x0004 );
+    textMap["TransferSyntax"] = std::make_pair( 0x0002, 0x0010 );
+    for( auto it = textMap.cbegin(); it != textMap.cend(); ++it )
+    {
+      std::string value = metadata->GetValue( it->second.first, it->second.second );
+      if( value.empty() ) attributes->SetNull( it->first );
+      else attributes->Set( it->first, value );
+    }
+
+    std::map< std::string, std::pair< uint16_t, uint16_t > > numberMap;
+    numberMap["SeriesNumber"] = std::make_pair( 0x0020, 0x0011 );
+    numberMap["CineRate"] = std::make_pair( 0x0018, 0x0040 );
+    numberMap["RecommendedDisplayFrameRate"] = std::make_pair( 0x0008, 0x2114 );
+    for( auto it = numberMap.cbegin(); it != numberMap.cend(); ++it )
+    {
+      bool valid = false;
+      int value = vtkVariant( metadata->GetValue( it->second.first, it->second.second ) ).ToInt( &valid );
+      if( valid ) attributes->Set( it->first, value );
+      else attributes->SetNull( it->first );
+    }
+
+    // replace any attributes recorded for a previous copy of the file
+    attributes->Save( true );
+    return true;
+  }
+
+  //-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-
+  bool Image::LoadDICOMAttributes( DicomAttribute *attributes )
+  {
+    this->AssertPrimaryId();
+
+    // the file of an image which hasn't been stored may still be incomplete
+    if( !this->IsStored() ) return false;
+
+    std::string id = this->Get( "Id" ).ToString();
+    if( attributes->Load( "ImageId", id ) ) return true;
 
-    gdcm::ImageReader reader;
-    reader.SetFileName( fileName.c_str() );
-    reader.Read();
-    const gdcm::File &file = reader.GetFile();
-    const gdcm::DataSet &ds = file.GetDataSet();
+    // images stored before their attributes were recorded have them recorded now
+    return this->StoreDICOMAttributes() && attributes->Load( "ImageId", id );
+  }
+
+  //-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-
+  vtkVariant Image::GetDICOMAttribute( const std::string name )
+  {
+    vtkNew< DicomAttribute > attributes;
+    return this->LoadDICOMAttributes( attributes.GetPointer() ) ? attributes->Get( name ) : vtkVariant();
+  }
 
+  //-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-
+  std::string Image::GetDICOMTag( const std::string tagName )
+  {
     // TODO: use GDCM to get the correct tags
-    gdcm::Tag tag;
-    if( "AcquisitionDateTime" == tagName ) tag = gdcm::Tag( 0x0008, 0x002a );
-    else if( "SeriesNumber" == tagName ) tag = gdcm::Tag( 0x0020,0x0011 );
-    else throw std::runtime_error( "Unknown DICOM tag name." );
+    if( "AcquisitionDateTime" != tagName && "SeriesNumber" != tagName )
+      throw std::runtime_error( "Unknown DICOM tag name." );
 
-    if( !ds.FindDataElement( tag ) )
+    vtkVariant value = this->GetDICOMAttribute( tagName );
+    if( !value.IsValid() )
       throw std::runtime_error( "Unknown DICOM tag with name " + tagName );
 
-    return std::string( 
-      gdcm::DirectoryHelper::GetStringValueFromTag( tag, ds ) );
+    return value.ToString();
   }
 
   //-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-
   std::vector<int> Image::GetDICOMDimensions()
   {
-    this->AssertPrimaryId();
-
-    // get the name of the unzipped file
-    std::string fileName = this->GetFileName();
-    if( ".gz" == fileName.substr( fileName.length() - 3, 3 ) )
-      fileName = fileName.substr( 0, fileName.length() - 3 );
+    // files which can't be read have no dimensions
+    std::vector<int> dims( 3, 0 );
+    try
+    {
+      vtkNew< DicomAttribute > attributes;
+      if( this->LoadDICOMAttributes( attributes.GetPointer() ) )
+      {
+        dims[0] = attributes->Get( "Width" ).ToInt();
+        dims[1] = attributes->Get( "Height" ).ToInt();
+        dims[2] = attributes->Get( "Frames" ).ToInt();
+      }
+    }
+    catch( std::runtime_error &e )
+    {
+    }
 
-    gdcm::ImageReader reader;
-    reader.SetFileName( fileName.c_str() );
-    reader.Read();
-    gdcm::Image &image = reader.GetImage();
-    
-    std::vector<int> dims;
-    for( int i = 0; i < 3; ++i )
-      dims.push_back( image.GetDimension(i) );
-    
-    return dims;  
+    return dims;
   }
 
   //-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-
@@ -31,6 +31,7 @@
 
 namespace Alder
 {
+  class DicomAttribute;
   class User;
   class Image : public ActiveRecord
   {
@@ -58,26 +59,88 @@ namespace Alder
     std::string CreateFile( const std::string suffix );
 
     /**
-     * Once the file is written to the disk this method validates it.  It will unzip gzipped files
-     * and if the file is empty or unreadable it will delete the file.
+     * Once the file is written to the disk this method validates it.  If the file is empty or
+     * incomplete it will delete the file.  (Gzipped files are decompressed by OpalService as
+     * they are downloaded.)  Only the file's header and end are read (see ImageFileValidator).
      * @return bool Whether the file is valid
      */
     bool ValidateFile();
 
+    /**
+     * Validates the files of several images at once, in parallel, deleting those which aren't
+     * valid (see ValidateFile())
+     * @return vector Whether each image's file is valid, in the order of the given images
+     */
+    static std::vector< bool > ValidateFiles( const std::vector< Image* > &images );
+
+    /**
+     * Records the name, size, format and content hash (SHA-256) of the image's file in the image
+     * store's index (the Image table).  If an identical file is already in the store then the
+     * image's file is replaced by a hard link to it so that duplicate images only use disk space
+     * once.  This method must be called once the file has been validated.
+     * @param hash string The file's hash, if already known (it is computed otherwise)
+     * @throws runtime_error
+     */
+    void StoreFile( const std::string hash = "" );
+
+    /**
+     * Checks that the image's file matches the size and (optionally) the hash recorded by
+     * StoreFile(), without decoding the image.  Files of images which have not been stored are
+     * only checked for being non-empty.
+     * @param checkHash bool Whether to hash the file or only check its size
+     * @return bool Whether the file is intact (false if it is missing)
+     */
+    bool VerifyFile( const bool checkHash = true );
+
+    /**
+     * Returns whether the image's file has been stored (see StoreFile()).  The images of an exam
+     * whose download hasn't finished may not have been, and they can't be viewed or rated.
+     */
+    bool IsStored();
+
     /**
      * Get the file name that this record represents (including path)
-     * NOTE: this method depends on the file already existing, if it doesn't already
-     * exist it will throw an exception
+     * The name of an image's file is recorded by StoreFile(), after which it is returned without
+     * any database or disk access (so the file may no longer exist).  Until then the exam's
+     * directory is searched for the file.
+     * NOTE: until the file has been stored this method depends on the file already existing,
+     * if it doesn't already exist it will throw an exception
      */
     std::string GetFileName();
 
+    /**
+     * Get the name of the image's thumbnail (see vtkImageThumbnailCache), or an empty string if
+     * the image doesn't have one (or its thumbnail is out of date).
+     */
+    std::string GetThumbnailFileName();
+
     /**
      * Get whether a particular user has rated this image
      */
     bool IsRatedBy( User* user );
 
     /**
-     * Get arbitrary DICOM tag value.  Works only for dicom images.
+     * Records the DICOM attributes which Alder uses (the columns of the DicomAttribute table) so
+     * that they are available without reading the image's file.  Only the file's header is
+     * parsed (see DicomMetadata).  This method must be called once the file has been validated.
+     * @return bool Whether the image has DICOM attributes (false if it isn't a DICOM file)
+     * @throws runtime_error
+     */
+    bool StoreDICOMAttributes();
+
+    /**
+     * Get one of the image's DICOM attributes (a column of the DicomAttribute table) without
+     * reading the image's file.  The attributes of images which were stored before they were
+     * recorded are recorded first.  The result is invalid if the image doesn't have the attribute
+     * or hasn't been stored.
+     * @throws runtime_error
+     */
+    vtkVariant GetDICOMAttribute( const std::string name );
+
+    /**
+     * Get arbitrary DICOM tag value (AcquisitionDateTime or SeriesNumber) from the image's DICOM
+     * attributes.  Works only for dicom images.
+     * @throws runtime_error
      */
     std::string GetDICOMTag( const std::string tagName );
 
@@ -87,7 +150,8 @@ namespace Alder
     std::string GetDICOMAcquisitionDateTime();
 
     /**
-     * Get the number of rows, columns and frames.  Works only for dicom images.
+     * Get the number of columns, rows and frames from the image's DICOM attributes.  Works only
+     * for dicom images, returns zeros for files which can't be read.
      */
     std::vector<int> GetDICOMDimensions();
 
@@ -110,6 +174,12 @@ namespace Alder
     Image() {}
     ~Image() {}
 
+    /**
+     * Loads the image's DicomAttribute record, storing the attributes first if necessary
+     * @return bool Whether the image has DICOM attributes
+     */
+    bool LoadDICOMAttributes( DicomAttribute *attributes );
+
   private:
     Image( const Image& ); // Not implemented
     void operator=( const Image& ); // Not implemented
@@ -0,0 +1,259 @@
+/*=========================================================================
+
+  Program:  Alder (CLSA Medical Image Quality Assessment Tool)
+  Module:   ImageFileValidator.cxx
+  Language: C++
+
+  Author: Patrick Emond <emondpd AT mcmaster DOT ca>
+  Author: Dean Inglis <inglisd AT mcmaster DOT ca>
+
+=========================================================================*/
+#include "ImageFileValidator.h"
+
+#include "DicomMetadata.h"
+
+#include "vtkImageDataReader.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <stdexcept>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+
+namespace Alder
+{
+  namespace
+  {
+    // how much of the start and the end of a file is read (the file meta information is well
+    // under a kilobyte, what is left is room for long private meta elements)
+    const size_t HeadLength = 8192;
+    const size_t TailLength = 64;
+
+    // the DICOM preamble is followed by "DICM" then the file meta information
+    const size_t PreambleLength = 128;
+    const size_t MetaOffset = PreambleLength + 4;
+
+    // the end of encapsulated pixel data: the sequence delimitation item (FFFE,E0DD) of length 0
+    const unsigned char SequenceDelimiter[] = { 0xfe, 0xff, 0xdd, 0xe0, 0x00, 0x00, 0x00, 0x00 };
+
+    const unsigned char PNGSignature[] = { 0x89, 'P', 'N', 'G', 0x0d, 0x0a, 0x1a, 0x0a };
+    const unsigned char PNGEnd[] = { 0x00, 0x00, 0x00, 0x00, 'I', 'E', 'N', 'D', 0xae, 0x42, 0x60, 0x82 };
+
+    // the start and end of a file, read without going through the rest of it
+    struct FileSample
+    {
+      std::string Head;
+      std::string Tail;
+      uint64_t Length;
+    };
+
+    bool readSample( const std::string fileName, FileSample &sample )
+    {
+      int descriptor = open( fileName.c_str(), O_RDONLY );
+      if( -1 == descriptor ) return false;
+
+      struct stat info;
+      bool success = 0 == fstat( descriptor, &info ) && 0 < info.st_size;
+      if( success )
+      {
+        sample.Length = info.st_size;
+        size_t headLength = std::min( static_cast< uint64_t >( HeadLength ), sample.Length );
+        size_t tailLength = std::min( static_cast< uint64_t >( TailLength ), sample.Length );
+        sample.Head.resize( headLength );
+        sample.Tail.resize( tailLength );
+        success =
+          static_cast< ssize_t >( headLength ) == pread( descriptor, &sample.Head[0], headLength, 0 ) &&
+          static_cast< ssize_t >( tailLength ) ==
+            pread( descriptor, &sample.Tail[0], tailLength, sample.Length - tailLength );
+      }
+
+      close( descriptor );
+      return success;
+    }
+
+    bool startsWith( const std::string &data, const unsigned char *bytes, const size_t length )
+    {
+      return length <= data.size() && 0 == memcmp( data.data(), bytes, length );
+    }
+
+    bool endsWith( const std::string &data, const unsigned char *bytes, const size_t length )
+    {
+      return length <= data.size() && 0 == memcmp( data.data() + data.size() - length, bytes, length );
+    }
+
+    uint16_t readUInt16( const std::string &data, const size_t offset )
+    {
+      const unsigned char *bytes = reinterpret_cast< const unsigned char* >( data.data() ) + offset;
+      return bytes[0] | ( bytes[1] << 8 );
+    }
+
+    uint32_t readUInt32( const std::string &data, const size_t offset )
+    {
+      return readUInt16( data, offset ) | ( static_cast< uint32_t >( readUInt16( data, offset + 2 ) ) << 16 );
+    }
+
+    // finds the end of the file meta information (group 0002, always explicit VR little endian)
+    // and its transfer syntax, returns false if the group is malformed or longer than the head
+    bool parseMetaInformation( const std::string &head, size_t &metaEnd, std::string &transferSyntax )
+    {
+      size_t offset = MetaOffset;
+      while( offset + 8 <= head.size() && 0x0002 == readUInt16( head, offset ) )
+      {
+        uint16_t element = readUInt16( head, offset + 2 );
+        std::string vr = head.substr( offset + 4, 2 );
+
+        // these VRs have two reserved bytes and a 32-bit length, all others a 16-bit length
+        size_t valueOffset, valueLength;
+        if( "OB" == vr || "OD" == vr || "OF" == vr || "OL" == vr || "OV" == vr || "OW" == vr ||
+            "SQ" == vr || "SV" == vr || "UC" == vr || "UN" == vr || "UR" == vr || "UT" == vr ||
+            "UV" == vr )
+        {
+          if( offset + 12 > head.size() ) return false;
+          valueOffset = offset + 12;
+          valueLength = readUInt32( head, offset + 8 );
+        }
+        else
+        {
+          valueOffset = offset + 8;
+          valueLength = readUInt16( head, offset + 6 );
+        }
+        if( valueOffset + valueLength > head.size() ) return false;
+
+        if( 0x0010 == element )
+        {
+          // remove the padding (spaces and nulls) from the end of the value
+          transferSyntax = head.substr( valueOffset, valueLength );
+          std::string::size_type end = transferSyntax.find_last_not_of( std::string( " \0", 2 ) );
+          transferSyntax.erase( std::string::npos == end ? 0 : end + 1 );
+        }
+        offset = valueOffset + valueLength;
+      }
+
+      // the data set must start within the head, otherwise the group may have been cut short
+      metaEnd = offset;
+      return MetaOffset < offset && offset + 4 <= head.size() && !transferSyntax.empty();
+    }
+
+    // JPEG baseline through JPEG 2000 (1.2.840.10008.1.2.4.50 to .93) end every frame with the
+    // end of image marker (the MPEG and HEVC syntaxes which follow them don't)
+    bool isJPEGTransferSyntax( const std::string &transferSyntax )
+    {
+      const std::string prefix = "1.2.840.10008.1.2.4.";
+      if( 0 != transferSyntax.compare( 0, prefix.size(), prefix ) ) return false;
+      int number = atoi( transferSyntax.c_str() + prefix.size() );
+      return 50 <= number && number <= 93;
+    }
+
+    bool isNativeTransferSyntax( const std::string &transferSyntax )
+    {
+      return "1.2.840.10008.1.2" == transferSyntax ||
+             "1.2.840.10008.1.2.1" == transferSyntax ||
+             "1.2.840.10008.1.2.2" == transferSyntax;
+    }
+
+    // returns whether a file ends with its encapsulated pixel data
+    bool endsWithPixelData( const FileSample &sample, const std::string &transferSyntax )
+    {
+      if( !endsWith( sample.Tail, SequenceDelimiter, sizeof( SequenceDelimiter ) ) ) return false;
+      if( !isJPEGTransferSyntax( transferSyntax ) ) return true;
+
+      std::string fragmentEnd = sample.Tail.substr( 0, sample.Tail.size() - sizeof( SequenceDelimiter ) );
+      if( !fragmentEnd.empty() && '\0' == fragmentEnd[fragmentEnd.size() - 1] )
+        fragmentEnd.erase( fragmentEnd.size() - 1 );
+      const unsigned char endOfImage[] = { 0xff, 0xd9 };
+      return endsWith( fragmentEnd, endOfImage, sizeof( endOfImage ) );
+    }
+
+    bool isValidDICOM( const std::string fileName, const FileSample &sample )
+    {
+      size_t metaEnd;
+      std::string transferSyntax;
+      if( !parseMetaInformation( sample.Head, metaEnd, transferSyntax ) ) return false;
+
+      if( isNativeTransferSyntax( transferSyntax ) )
+      {
+        // the file must be long enough to hold all of its frames after the header
+        try
+        {
+          std::shared_ptr< const DicomMetadata > metadata = DicomMetadata::GetInstance( fileName );
+          std::vector< int > dims = metadata->GetDimensions();
+          uint64_t samples = std::max( 1, atoi( metadata->GetValue( 0x0028, 0x0002 ).c_str() ) );
+          uint64_t bits = std::max( 1, atoi( metadata->GetValue( 0x0028, 0x0100 ).c_str() ) );
+          uint64_t pixelDataLength =
+            static_cast< uint64_t >( dims[0] ) * dims[1] * dims[2] * samples * ( ( bits + 7 ) / 8 );
+          return metaEnd + pixelDataLength <= sample.Length;
+        }
+        catch( std::exception &e )
+        {
+          return false;
+        }
+      }
+      else if( "1.2.840.10008.1.2.1.99" == transferSyntax )
+      {
+        // the deflated data set's length can't be known without inflating it
+        return true;
+      }
+
+      // encapsulated pixel data usually ends the file with the sequence delimiter, and when the
+      // frames are JPEG images the last fragment ends with the end of image marker (and a byte
+      // of padding), files with elements after the pixel data (eg: data set trailing padding)
+      // are checked by the reader instead
+      return endsWithPixelData( sample, transferSyntax ) ||
+             vtkImageDataReader::IsValidFileName( fileName.c_str() );
+    }
+
+    bool isValidJPEG( const FileSample &sample )
+    {
+      // some writers pad the file with nulls after the end of image marker
+      std::string tail = sample.Tail;
+      std::string::size_type end = tail.find_last_not_of( '\0' );
+      tail.erase( std::string::npos == end ? 0 : end + 1 );
+      const unsigned char endOfImage[] = { 0xff, 0xd9 };
+      return endsWith( tail, endOfImage, sizeof( endOfImage ) );
+    }
+  }
+
+  //-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-
+  bool ImageFileValidator::IsValid( const std::string fileName )
+  {
+    FileSample sample;
+    if( !readSample( fileName, sample ) ) return false;
+
+    const unsigned char startOfImage[] = { 0xff, 0xd8, 0xff };
+    if( MetaOffset < sample.Head.size() && 0 == sample.Head.compare( PreambleLength, 4, "DICM" ) )
+      return isValidDICOM( fileName, sample );
+    else if( startsWith( sample.Head, startOfImage, sizeof( startOfImage ) ) )
+      return isValidJPEG( sample );
+    else if( startsWith( sample.Head, PNGSignature, sizeof( PNGSignature ) ) )
+      return endsWith( sample.Tail, PNGEnd, sizeof( PNGEnd ) );
+
+    // DICOM files without a preamble and all other formats are only identified by their contents
+    return vtkImageDataReader::IsValidFileName( fileName.c_str() );
+  }
+
+  //-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-
+  std::vector< bool > ImageFileValidator::AreValid( const std::vector< std::string > &fileNames )
+  {
+    // each thread takes the next file to check (vector< bool > can't be written by many threads)
+    const int count = fileNames.size();
+    std::vector< char > valid( count, 0 );
+    std::atomic< int > next( 0 );
+    auto work = [&]()
+    {
+      for( int i = next++; i < count; i = next++ ) valid[i] = ImageFileValidator::IsValid( fileNames[i] );
+    };
+
+    const int threadCount = std::max( 1u, std::thread::hardware_concurrency() );
+    std::vector< std::thread > threads;
+    for( int t = 1; t < threadCount && t < count; ++t ) threads.push_back( std::thread( work ) );
+    work();
+    for( auto it = threads.begin(); it != threads.end(); ++it ) it->join();
+
+    return std::vector< bool >( valid.begin(), valid.end() );
+  }
+}
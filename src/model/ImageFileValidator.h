@@ -0,0 +1,70 @@
+/*=========================================================================
+
+  Program:  Alder (CLSA Medical Image Quality Assessment Tool)
+  Module:   ImageFileValidator.h
+  Language: C++
+
+  Author: Patrick Emond <emondpd AT mcmaster DOT ca>
+  Author: Dean Inglis <inglisd AT mcmaster DOT ca>
+
+=========================================================================*/
+
+/**
+ * @class ImageFileValidator
+ * @namespace Alder
+ *
+ * @author Patrick Emond <emondpd AT mcmaster DOT ca>
+ * @author Dean Inglis <inglisd AT mcmaster DOT ca>
+ *
+ * @brief Checks that downloaded image files are complete without decoding them
+ *
+ * Only the first few kilobytes and the last few bytes of a file are read.  DICOM files must have
+ * the preamble, the "DICM" prefix and a well formed file meta information group (which has the
+ * transfer syntax).  Files with encapsulated (compressed) pixel data must end with the pixel
+ * data's sequence delimiter, preceded by the JPEG end of image marker when the transfer syntax is
+ * a JPEG one, or else be readable by the reader (elements may follow the pixel data), and files
+ * with native pixel data must be long enough to hold all of their frames (see DicomMetadata).
+ * JPEG files must start with the start of image marker and end with the end of image marker, and
+ * PNG files must end with their IEND chunk.  Other formats are only identified by their magic
+ * number (see vtkImageDataReader::IsValidFileName()).
+ *
+ * Files are decoded by the reader only when they are displayed.
+ */
+
+#ifndef __ImageFileValidator_h
+#define __ImageFileValidator_h
+
+#include <string>
+#include <vector>
+
+/**
+ * @addtogroup Alder
+ * @{
+ */
+
+namespace Alder
+{
+  class ImageFileValidator
+  {
+  public:
+    /**
+     * Returns whether a file is a complete image file (false if it is missing or empty)
+     */
+    static bool IsValid( const std::string fileName );
+
+    /**
+     * Validates several files at once using a thread per core
+     * @return vector Whether each file is valid, in the order of the given file names
+     */
+    static std::vector< bool > AreValid( const std::vector< std::string > &fileNames );
+
+  private:
+    ImageFileValidator(); /** Not implemented. */
+    ImageFileValidator( const ImageFileValidator& ); /** Not implemented. */
+    void operator=( const ImageFileValidator& ); /** Not implemented. */
+  };
+}
+
+/** @} end of doxygen group */
+
+#endif
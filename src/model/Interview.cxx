@@ -14,19 +14,74 @@
 #include "Exam.h"
 #include "Modality.h"
 #include "OpalService.h"
+#include "ProgressChannel.h"
 #include "User.h"
 #include "Utilities.h"
 
-#include "vtkCommand.h"
 #include "vtkNew.h"
 #include "vtkObjectFactory.h"
 #include "vtkSmartPointer.h"
 
+#include <algorithm>
 #include <map>
+#include <set>
 #include <stdexcept>
 
 namespace Alder
 {
+  namespace
+  {
+    // finishes each exam as soon as the last of its file transfers is done with, so that its
+    // images can be viewed while those of the other exams are still being downloaded
+    class ExamImageDataTracker : public OpalService::TransferListener
+    {
+    public:
+      ExamImageDataTracker( Interview *owner ) : Owner( owner ) {}
+
+      void AddExam( Exam *exam, std::vector< OpalService::FileTransfer* >::const_iterator first,
+        std::vector< OpalService::FileTransfer* >::const_iterator last )
+      {
+        this->Remaining[exam] = last - first;
+        for( auto it = first; it != last; ++it ) this->ExamOfTransfer[*it] = exam;
+      }
+
+      void TransferDone( OpalService::FileTransfer *transfer )
+      {
+        auto found = this->ExamOfTransfer.find( transfer );
+        if( this->ExamOfTransfer.end() != found && 0 == --this->Remaining[found->second] )
+          this->Finish( found->second );
+      }
+
+      // finishes the exam unless it already has been, exams which had a failed transfer are not
+      // marked as downloaded so they will be tried again
+      void Finish( Exam *exam )
+      {
+        if( !this->Finished.insert( exam ).second ) return;
+        try
+        {
+          if( !exam->FinishImageData() && this->Error.empty() &&
+              !Application::GetInstance()->GetAbortFlag() )
+            this->Error = "Unable to retrieve all images from Opal, please try again.";
+        }
+        catch( std::exception &e )
+        {
+          // the other exams' transfers are still in progress, so report the error once done
+          if( this->Error.empty() ) this->Error = e.what();
+        }
+        this->Owner->InvokeEvent( Interview::ExamImageDataEvent, exam );
+      }
+
+      std::string GetError() const { return this->Error; }
+
+    private:
+      Interview *Owner;
+      std::map< OpalService::FileTransfer*, Exam* > ExamOfTransfer;
+      std::map< Exam*, int > Remaining;
+      std::set< Exam* > Finished;
+      std::string Error;
+    };
+  }
+
   vtkStandardNewMacro( Interview );
 
   //-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-
@@ -296,10 +351,6 @@ namespace Alder
 
     OpalService *opal = Application::GetInstance()->GetOpal();
 
-    // get exam metadata from Opal for this interview
-    std::map< std::string, std::string > examData = 
-      opal->GetRow( "alder", "Exam", this->Get( "UId" ).ToString() );
-
     // build a map of modalities and exams
     std::map<  std::string, std::vector< std::pair< std::string, std::string > > >
       modalityMap;
@@ -323,6 +374,26 @@ namespace Alder
        {"RetinalScan","right"}
      };  
 
+    // get the exam metadata for this interview from Opal, selecting only what we need
+    std::vector< std::string > variables;
+    for( auto mapIt = modalityMap.cbegin(); mapIt != modalityMap.cend(); ++mapIt )
+    {
+      for( auto vecIt = mapIt->second.cbegin(); vecIt != mapIt->second.cend(); ++vecIt )
+      {
+        if( variables.end() != std::find( variables.begin(), variables.end(), vecIt->first + ".Stage" ) )
+          continue;
+        variables.push_back( vecIt->first + ".Stage" );
+        variables.push_back( vecIt->first + ".Interviewer" );
+        variables.push_back( vecIt->first + ".DatetimeAcquired" );
+      }
+    }
+
+    std::map< std::string, std::string > examData;
+    std::map< std::string, std::vector< std::string > > valueSet =
+      opal->GetValueSet( "alder", "Exam", this->Get( "UId" ).ToString(), variables );
+    for( auto it = valueSet.cbegin(); it != valueSet.cend(); ++it )
+      examData[it->first] = it->second.empty() ? "" : it->second[0];
+
     vtkVariant interviewId = this->Get( "Id" );
 
     for( auto mapIt = modalityMap.cbegin(); mapIt != modalityMap.cend(); ++mapIt )
@@ -355,27 +426,60 @@ namespace Alder
     {
       double index = 0;
       bool global = true;
-      std::pair<bool, double> progressConfig = std::pair<bool, double>( global, 0.0 );
       Application *app = Application::GetInstance();
+      ProgressChannel *channel = ProgressChannel::GetInstance();
+      OpalService *opal = app->GetOpal();
+      std::vector< OpalService::FileTransfer* > transfers;
+      ExamImageDataTracker tracker( this );
 
-      // we are going to be downloading file type data here, so
-      // we tell opal service on the first curl callback to NOT check if the data
-      // has a substantial return size, and force that we monitor all file downloads using curl progress
-      OpalService::SetCurlProgressChecking( false );
+      channel->Start( global );
 
-      app->InvokeEvent( vtkCommand::StartEvent, static_cast<void *>( &global ) );
+      // gather the metadata needed to plan all downloads up front, one request per Opal table
+      std::map< std::string, std::vector< std::string > > tableVariables;
+      for( auto examIt = examList.cbegin(); examIt != examList.cend(); ++examIt )
+      {
+        if( ( *examIt )->HasImageData() ) continue;
+        std::vector< std::string > &list = tableVariables[( *examIt )->Get( "Type" ).ToString()];
+        std::vector< std::string > variables = ( *examIt )->GetMetadataVariables();
+        for( auto it = variables.cbegin(); it != variables.cend(); ++it )
+          if( list.end() == std::find( list.begin(), list.end(), *it ) ) list.push_back( *it );
+      }
+
+      std::map< std::string, std::map< std::string, std::vector< std::string > > > metadata;
+      std::string UId = this->Get( "UId" ).ToString();
+      for( auto it = tableVariables.cbegin(); it != tableVariables.cend(); ++it )
+      {
+        if( app->GetAbortFlag() ) break;
+        if( !it->second.empty() )
+          metadata[it->first] = opal->GetValueSet( "clsa-dcs-images", it->first, UId, it->second );
+      }
+
+      // determine which images each exam needs, then download all of them at once
       double size = examList.size();
       for( auto examIt = examList.cbegin(); examIt != examList.cend(); ++examIt, ++index )
       {
-        progressConfig.second = index / size;
-        app->InvokeEvent( vtkCommand::ProgressEvent, static_cast<void *>( &progressConfig ) );
+        channel->Progress( global, index / size );
         if( app->GetAbortFlag() ) break;
-        ( *examIt )->UpdateImageData(); // invokes progress events
+        int first = transfers.size();
+        ( *examIt )->PrepareImageData( transfers, metadata[( *examIt )->Get( "Type" ).ToString()] );
+        tracker.AddExam( *examIt, transfers.begin() + first, transfers.end() );
       }
 
+      // each exam is finished by the tracker as soon as all of its files have been received
+      // (this is done even if the job was cancelled so that the transfers which are left keep
+      // the data received by earlier attempts, see OpalService::SaveFiles)
+      opal->SaveFiles( transfers, &tracker ); // invokes progress events
+
+      // finish the exams which had nothing to download or whose transfers were never started
+      examList.resize( static_cast< int >( index ) );
+      for( auto examIt = examList.cbegin(); examIt != examList.cend(); ++examIt )
+        tracker.Finish( *examIt );
+
       if( app->GetAbortFlag() ) app->SetAbortFlag( false );
 
-      app->InvokeEvent( vtkCommand::EndEvent, static_cast<void *>( &global ) );
+      channel->End( global );
+
+      if( !tracker.GetError().empty() ) throw std::runtime_error( tracker.GetError() );
     }
   }
 
@@ -383,6 +487,7 @@ namespace Alder
   void Interview::UpdateInterviewData()
   {
     Application *app = Application::GetInstance();
+    ProgressChannel *channel = ProgressChannel::GetInstance();
     OpalService *opal = app->GetOpal();
 
     // get a list of all interview start dates
@@ -390,24 +495,17 @@ namespace Alder
     std::map< std::string, std::string > map, key;
     bool done = false;
     bool global = true;
-    std::pair<bool, double> progressConfig = std::pair<bool, double>( global, 0.0 );
     int limit = 100;
     double index = 0;
 
     std::vector< std::string > identifierList = opal->GetIdentifiers( "alder", "Interview" );
     double size = (double) identifierList.size();
 
-    // we are going to be downloading non file type data here, so
-    // we tell opal service on the first curl callback to check if the data
-    // has a substantial return size that we can monitor using curl progress
-    OpalService::SetCurlProgressChecking( true );
-
-    app->InvokeEvent( vtkCommand::StartEvent, static_cast<void *>( &global ) );
+    channel->Start( global );
 
     do
     {
-      progressConfig.second = index / size;
-      app->InvokeEvent( vtkCommand::ProgressEvent, static_cast<void *>( &progressConfig ) );
+      channel->Progress( global, index / size );
       if( app->GetAbortFlag() ) break;
       list = opal->GetRows( "alder", "Interview", index, limit ); // invokes progress events
 
@@ -434,7 +532,7 @@ namespace Alder
     } while ( !list.empty() );
 
     if( app->GetAbortFlag() ) app->SetAbortFlag( false );
-    else app->InvokeEvent( vtkCommand::EndEvent, static_cast<void *>( &global ) );
+    else channel->End( global );
   }
 
   //-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-
@@ -454,6 +552,7 @@ namespace Alder
            << "AND Exam.Stage = simExam.Stage "
            << "JOIN Image AS simImage ON simImage.ExamId = simExam.Id "
            << "WHERE Exam.InterviewId = " << this->Get( "Id" ).ToString() << " "
+           << "AND Exam.Downloaded = 1 "
            << "AND simImage.Id = " << imageId << " "
            << "LIMIT 1";
 
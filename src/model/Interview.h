@@ -25,6 +25,8 @@
 #include "ActiveRecord.h"
 #include "Image.h"
 
+#include "vtkCommand.h"
+
 #include <iostream>
 
 /**
@@ -41,6 +43,11 @@ namespace Alder
     vtkTypeMacro( Interview, ActiveRecord );
     std::string GetName() const { return "Interview"; }
 
+    enum CustomEvents
+    {
+      ExamImageDataEvent = vtkCommand::UserEvent + 200
+    };
+
     /**
      * Updates the Interview table with all existing interviews in Opal
      */
@@ -55,6 +62,8 @@ namespace Alder
     /**
      * Updates all exam and image data associated with the interview from Opal
      * Note: exam data must be downloaded before image data
+     * While updating the image data an ExamImageDataEvent (with the Exam as call data) is
+     * invoked as soon as each exam's images have been received, before those of the others.
      */
     void UpdateExamData();
     void UpdateImageData();
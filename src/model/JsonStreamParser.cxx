@@ -0,0 +1,271 @@
+/*=========================================================================
+
+  Program:  Alder (CLSA Medical Image Quality Assessment Tool)
+  Module:   JsonStreamParser.cxx
+  Language: C++
+
+  Author: Patrick Emond <emondpd AT mcmaster DOT ca>
+  Author: Dean Inglis <inglisd AT mcmaster DOT ca>
+
+=========================================================================*/
+#include "JsonStreamParser.h"
+
+#include <cctype>
+#include <cstdlib>
+#include <sstream>
+
+namespace Alder
+{
+  //-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-
+  JsonStreamParser::JsonStreamParser()
+  {
+    this->CurrentState = DefaultState;
+    this->HighSurrogate = 0;
+    this->ExpectingKey = false;
+    this->Done = false;
+  }
+
+  //-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-
+  bool JsonStreamParser::Parse( const char *data, const size_t length )
+  {
+    if( !this->Error.empty() ) return false;
+    for( size_t i = 0; i < length; ++i )
+      if( !this->ParseCharacter( data[i] ) ) return false;
+    return true;
+  }
+
+  //-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-
+  bool JsonStreamParser::Finish()
+  {
+    if( !this->Error.empty() ) return false;
+
+    // a number or literal at the end of the document has nothing following it
+    if( NumberState == this->CurrentState || LiteralState == this->CurrentState )
+      if( !this->EndToken() ) return false;
+
+    if( DefaultState != this->CurrentState ) return this->SetError( "Unterminated string" );
+    if( !this->Done ) return this->SetError( "Incomplete document" );
+    return true;
+  }
+
+  //-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-
+  bool JsonStreamParser::ParseCharacter( const char c )
+  {
+    switch( this->CurrentState )
+    {
+      case StringState:
+        if( '"' == c )
+        {
+          this->CurrentState = DefaultState;
+          return this->EndToken();
+        }
+        else if( '\\' == c ) this->CurrentState = EscapeState;
+        else if( 0x20 > static_cast< unsigned char >( c ) )
+          return this->SetError( "Control character in string" );
+        else this->Token += c;
+        return true;
+
+      case EscapeState:
+        this->CurrentState = StringState;
+        switch( c )
+        {
+          case '"': this->Token += '"'; break;
+          case '\\': this->Token += '\\'; break;
+          case '/': this->Token += '/'; break;
+          case 'b': this->Token += '\b'; break;
+          case 'f': this->Token += '\f'; break;
+          case 'n': this->Token += '\n'; break;
+          case 'r': this->Token += '\r'; break;
+          case 't': this->Token += '\t'; break;
+          case 'u':
+            this->Escape = "";
+            this->CurrentState = UnicodeState;
+            break;
+          default: return this->SetError( "Invalid escape sequence in string" );
+        }
+        return true;
+
+      case UnicodeState:
+        if( !isxdigit( c ) ) return this->SetError( "Invalid unicode escape sequence in string" );
+        this->Escape += c;
+        if( 4 == this->Escape.size() )
+        {
+          unsigned int codePoint = strtoul( this->Escape.c_str(), NULL, 16 );
+          if( 0xD800 <= codePoint && codePoint < 0xDC00 )
+          {
+            // the high half of a surrogate pair, the low half should follow
+            this->HighSurrogate = codePoint;
+          }
+          else if( 0xDC00 <= codePoint && codePoint < 0xE000 && 0 != this->HighSurrogate )
+          {
+            this->AppendCodePoint(
+              0x10000 + ( ( this->HighSurrogate - 0xD800 ) << 10 ) + ( codePoint - 0xDC00 ) );
+            this->HighSurrogate = 0;
+          }
+          else this->AppendCodePoint( codePoint );
+          this->CurrentState = StringState;
+        }
+        return true;
+
+      case NumberState:
+        if( isdigit( c ) || '+' == c || '-' == c || '.' == c || 'e' == c || 'E' == c )
+        {
+          this->Token += c;
+          return true;
+        }
+        if( !this->EndToken() ) return false;
+        break; // the character which ended the number still has to be parsed
+
+      case LiteralState:
+        if( isalpha( c ) )
+        {
+          this->Token += c;
+          return true;
+        }
+        if( !this->EndToken() ) return false;
+        break; // the character which ended the literal still has to be parsed
+
+      default:
+        break;
+    }
+
+    // we are between tokens
+    if( isspace( c ) ) return true;
+    if( this->Done ) return this->SetError( "Unexpected data after the end of the document" );
+
+    if( '"' == c )
+    {
+      this->Token = "";
+      this->CurrentState = StringState;
+      return true;
+    }
+    else if( '-' == c || isdigit( c ) || 't' == c || 'f' == c || 'n' == c )
+    {
+      this->Token = c;
+      this->CurrentState = isalpha( c ) ? LiteralState : NumberState;
+      return true;
+    }
+
+    return this->ParseStructure( c );
+  }
+
+  //-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-
+  bool JsonStreamParser::ParseStructure( const char c )
+  {
+    bool inObject = !this->Containers.empty() && '{' == this->Containers.back();
+
+    if( '{' == c || '[' == c )
+    {
+      if( inObject && this->ExpectingKey ) return this->SetError( "Expected an object key" );
+
+      // remember which member of the parent object the container belongs to
+      this->Keys.push_back( inObject ? this->CurrentKey : "" );
+      this->Containers.push_back( c );
+      this->CurrentKey = "";
+      this->ExpectingKey = '{' == c;
+      if( '{' == c ) this->OnStartObject();
+      else this->OnStartArray();
+    }
+    else if( '}' == c || ']' == c )
+    {
+      if( this->Containers.empty() || ( '}' == c ) != inObject )
+        return this->SetError( "Mismatched closing bracket" );
+
+      if( '}' == c ) this->OnEndObject();
+      else this->OnEndArray();
+      this->CurrentKey = this->Keys.back();
+      this->Keys.pop_back();
+      this->Containers.pop_back();
+      this->ExpectingKey = false;
+      if( this->Containers.empty() ) this->Done = true;
+    }
+    else if( ',' == c )
+    {
+      if( this->Containers.empty() ) return this->SetError( "Unexpected comma" );
+      if( inObject ) this->ExpectingKey = true;
+    }
+    else if( ':' == c )
+    {
+      if( !inObject ) return this->SetError( "Unexpected colon" );
+    }
+    else
+    {
+      std::stringstream stream;
+      stream << "Unexpected character '" << c << "'";
+      return this->SetError( stream.str() );
+    }
+
+    return true;
+  }
+
+  //-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-
+  bool JsonStreamParser::EndToken()
+  {
+    ValueType type = StringValue;
+    if( NumberState == this->CurrentState )
+    {
+      char *end;
+      strtod( this->Token.c_str(), &end );
+      if( '\0' != *end ) return this->SetError( "Invalid number \"" + this->Token + "\"" );
+      type = NumberValue;
+    }
+    else if( LiteralState == this->CurrentState )
+    {
+      if( "true" == this->Token || "false" == this->Token ) type = BooleanValue;
+      else if( "null" == this->Token ) type = NullValue;
+      else return this->SetError( "Invalid literal \"" + this->Token + "\"" );
+    }
+    this->CurrentState = DefaultState;
+
+    bool inObject = !this->Containers.empty() && '{' == this->Containers.back();
+    if( inObject && this->ExpectingKey )
+    {
+      if( StringValue != type ) return this->SetError( "Expected an object key" );
+      this->CurrentKey = this->Token;
+      this->ExpectingKey = false;
+      this->OnKey( this->CurrentKey );
+    }
+    else
+    {
+      this->OnValue( this->Token, type );
+      if( this->Containers.empty() ) this->Done = true;
+    }
+
+    return true;
+  }
+
+  //-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-
+  void JsonStreamParser::AppendCodePoint( unsigned int codePoint )
+  {
+    // encode the code point as utf-8
+    if( 0x80 > codePoint )
+    {
+      this->Token += static_cast< char >( codePoint );
+    }
+    else if( 0x800 > codePoint )
+    {
+      this->Token += static_cast< char >( 0xC0 | ( codePoint >> 6 ) );
+      this->Token += static_cast< char >( 0x80 | ( codePoint & 0x3F ) );
+    }
+    else if( 0x10000 > codePoint )
+    {
+      this->Token += static_cast< char >( 0xE0 | ( codePoint >> 12 ) );
+      this->Token += static_cast< char >( 0x80 | ( ( codePoint >> 6 ) & 0x3F ) );
+      this->Token += static_cast< char >( 0x80 | ( codePoint & 0x3F ) );
+    }
+    else
+    {
+      this->Token += static_cast< char >( 0xF0 | ( codePoint >> 18 ) );
+      this->Token += static_cast< char >( 0x80 | ( ( codePoint >> 12 ) & 0x3F ) );
+      this->Token += static_cast< char >( 0x80 | ( ( codePoint >> 6 ) & 0x3F ) );
+      this->Token += static_cast< char >( 0x80 | ( codePoint & 0x3F ) );
+    }
+  }
+
+  //-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-
+  bool JsonStreamParser::SetError( const std::string error )
+  {
+    this->Error = error;
+    return false;
+  }
+}
@@ -0,0 +1,132 @@
+/*=========================================================================
+
+  Program:  Alder (CLSA Medical Image Quality Assessment Tool)
+  Module:   JsonStreamParser.h
+  Language: C++
+
+  Author: Patrick Emond <emondpd AT mcmaster DOT ca>
+  Author: Dean Inglis <inglisd AT mcmaster DOT ca>
+
+=========================================================================*/
+
+/**
+ * @class JsonStreamParser
+ * @namespace Alder
+ *
+ * @author Patrick Emond <emondpd AT mcmaster DOT ca>
+ * @author Dean Inglis <inglisd AT mcmaster DOT ca>
+ *
+ * @brief Incremental (SAX style) json parser
+ *
+ * Json text is passed to the parser in pieces of any size as it is received and the parser
+ * reports what it finds by calling its virtual On*() methods, so that large documents can be
+ * processed without first building them in memory.  Subclasses override the methods they are
+ * interested in and use GetDepth() and GetKey() to determine where in the document they are.
+ */
+
+#ifndef __JsonStreamParser_h
+#define __JsonStreamParser_h
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+/**
+ * @addtogroup Alder
+ * @{
+ */
+
+namespace Alder
+{
+  class JsonStreamParser
+  {
+  public:
+    enum ValueType
+    {
+      StringValue,
+      NumberValue,
+      BooleanValue,
+      NullValue
+    };
+
+    JsonStreamParser();
+    virtual ~JsonStreamParser() {}
+
+    /**
+     * Parses the next piece of the document, returning false if it has a syntax error
+     * @param data char* The text to parse
+     * @param length size_t The length of the text
+     */
+    bool Parse( const char *data, const size_t length );
+
+    /**
+     * Must be called once the whole document has been passed to Parse(), returns whether
+     * the document was complete and valid
+     */
+    bool Finish();
+
+    /**
+     * Returns a description of the syntax error found while parsing, if any
+     */
+    std::string GetError() const { return this->Error; }
+
+  protected:
+    // start events are called after the container is opened and end events before it is
+    // closed, so GetDepth() includes the container in both cases
+    virtual void OnStartObject() {}
+    virtual void OnEndObject() {}
+    virtual void OnStartArray() {}
+    virtual void OnEndArray() {}
+    virtual void OnKey( const std::string &key ) {}
+    virtual void OnValue( const std::string &value, const ValueType type ) {}
+
+    /**
+     * Returns the number of objects and arrays which are currently open
+     */
+    int GetDepth() const { return this->Containers.size(); }
+
+    /**
+     * Returns the key of the object member which the open container at the given level
+     * (starting at 0 for the document's root) is the value of, or an empty string if the
+     * container is an array element
+     */
+    std::string GetKey( const int level ) const { return this->Keys[level]; }
+
+    /**
+     * Returns the key of the current member in the innermost open object
+     */
+    std::string GetCurrentKey() const { return this->CurrentKey; }
+
+  private:
+    enum State
+    {
+      DefaultState,
+      StringState,
+      EscapeState,
+      UnicodeState,
+      NumberState,
+      LiteralState
+    };
+
+    bool ParseCharacter( const char c );
+    bool ParseStructure( const char c );
+    bool EndToken();
+    void AppendCodePoint( unsigned int codePoint );
+    bool SetError( const std::string error );
+
+    State CurrentState;
+    std::string Token;
+    std::string Escape;
+    unsigned int HighSurrogate;
+    std::vector< char > Containers;
+    std::vector< std::string > Keys;
+    std::string CurrentKey;
+    bool ExpectingKey;
+    bool Done;
+    std::string Error;
+  };
+}
+
+/** @} end of doxygen group */
+
+#endif
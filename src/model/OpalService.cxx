@@ -13,50 +13,1015 @@
 
 #include "Application.h"
 #include "Configuration.h"
+#include "JsonStreamParser.h"
+#include "ProgressChannel.h"
 #include "Utilities.h"
 
-#include "vtkCommand.h"
+#include "vtkDirectory.h"
 #include "vtkObjectFactory.h"
 
+#include <algorithm>
+#include <cstring>
+#include <ctime>
+#include <deque>
+#include <fstream>
+#include <iomanip>
 #include <sstream>
 #include <stdexcept>
-#include </usr/include/curl/curl.h>
-#include </usr/include/curl/stdcheaders.h>
-#include </usr/include/curl/easy.h>
+#include <unistd.h>
+#include <zlib.h>
 
 namespace Alder
 {
-  // initialize the configureEventSent static ivar
-  bool OpalService::configureEventSent = false;
-  bool OpalService::curlProgressChecking = true;
+  // the size of the buffer used to decompress gzipped data
+  static const size_t GZIP_CHUNK_SIZE = 262144;
+
+  // the amount of data received between updates of a partial file's journal
+  static const curl_off_t JOURNAL_INTERVAL = 1048576;
+
+  // the amount of preceding data needed to resume decompressing in the middle of deflate data
+  static const size_t DEFLATE_WINDOW_SIZE = 32768;
+
+  // the size of the pieces a cached response is passed on in
+  static const size_t CACHE_CHUNK_SIZE = 65536;
+
+  // splits a response header line into its (lower case) name and its value, returns false if
+  // the line isn't a header with a value
+  static bool splitHeader( const char *data, const size_t length, std::string &name, std::string &value )
+  {
+    std::string line( data, length );
+    std::string::size_type colon = line.find( ':' );
+    if( std::string::npos == colon ) return false;
+
+    std::string::size_type first = line.find_first_not_of( " \t", colon + 1 );
+    std::string::size_type last = line.find_last_not_of( " \t\r\n" );
+    if( std::string::npos == first || last < first ) return false;
+
+    name = Utilities::toLower( line.substr( 0, colon ) );
+    value = line.substr( first, last - first + 1 );
+    return true;
+  }
+
+  class OpalService::FileWriter
+  {
+  public:
+    FileWriter( const std::string fileName, const bool decompress )
+      : FileName( fileName ), JournalName( FileWriter::GetJournalName( fileName ) ),
+        Decompress( decompress ), File( NULL ), Curl( NULL ), Started( false ), Resumable( false ),
+        Detected( false ), Compressed( false ), Initialized( false ), Raw( false ), Prime( false ),
+        StreamEnded( false ), TrailerPending( false ), Corrupt( false ), RangeRejected( false ),
+        Start( 0 ), Position( 0 ), Length( -1 ), Output( 0 ), Member( 0 ), Crc( crc32( 0L, Z_NULL, 0 ) )
+    {
+      this->Stream.zalloc = Z_NULL;
+      this->Stream.zfree = Z_NULL;
+      this->Stream.opaque = Z_NULL;
+    }
+
+    ~FileWriter()
+    {
+      this->Close();
+    }
+
+    // the journal of a partial file is kept (hidden) in the same directory as the file
+    static std::string GetJournalName( const std::string fileName )
+    {
+      std::string::size_type slash = fileName.rfind( '/' );
+      return std::string::npos == slash ? "." + fileName + ".journal" :
+        fileName.substr( 0, slash + 1 ) + "." + fileName.substr( slash + 1 ) + ".journal";
+    }
+
+    // opens the file, continuing where an earlier incomplete transfer left off if its journal
+    // is found, returns false if the file could not be opened
+    bool Open()
+    {
+      if( this->ReadJournal() )
+      {
+        // throw away anything written after the last checkpoint
+        if( 0 == truncate( this->FileName.c_str(), this->Saved.Output ) )
+          this->File = fopen( this->FileName.c_str(), "r+b" );
+
+        bool resumed = NULL != this->File && this->HashSaved();
+        if( resumed && this->Compressed ) resumed = this->ResumeStream();
+
+        if( resumed )
+        {
+          this->Start = this->Saved.Offset - ( 0 < this->Saved.Bits ? 1 : 0 );
+          this->Position = this->Start;
+          this->Output = this->Saved.Output;
+          this->Member = this->Saved.Member;
+          this->Crc = this->Saved.Crc;
+          this->Detected = this->Decompress;
+
+          std::stringstream log;
+          log << "Resuming transfer of \"" << this->FileName << "\" at byte " << this->Saved.Offset;
+          Utilities::log( log.str() );
+          return true;
+        }
+
+        // the partial file can't be used, start again from the beginning
+        this->Close();
+        remove( this->JournalName.c_str() );
+        this->Saved = Checkpoint();
+        this->Length = -1;
+        this->Validator = "";
+        this->Compressed = false;
+        this->Hash.Restart();
+      }
+
+      // the file may be a hard link to an identical image (see Image::StoreFile()) so it is
+      // replaced instead of overwritten
+      remove( this->FileName.c_str() );
+      this->File = fopen( this->FileName.c_str(), "wb" );
+      return NULL != this->File;
+    }
+
+    // the offset in the data (as sent by Opal) which the transfer must start at
+    curl_off_t GetResumeOffset() const { return this->Start; }
+
+    // the ETag (or last modification date) of the data an incomplete transfer received
+    std::string GetValidator() const { return this->Validator; }
+
+    void SetCurl( CURL *curl ) { this->Curl = curl; }
+
+    // the SHA-256 digest of the file's contents, once Finish() has succeeded
+    std::string GetDigest() const { return this->Digest; }
+
+    // whether the data received can't be decompressed (or doesn't match its checksum)
+    bool IsCorrupt() const { return this->Corrupt; }
+
+    // whether Opal sent something other than the rest of the data when resuming a transfer
+    bool IsRangeRejected() const { return this->RangeRejected; }
+
+    // keeps track of the response headers which identify the version of the data
+    void Header( const char *data, const size_t length )
+    {
+      std::string name, value;
+      if( !splitHeader( data, length, name, value ) ) return;
+
+      // weak ETags can't be used to resume a transfer
+      if( "etag" == name && 0 != value.compare( 0, 2, "W/" ) ) this->Validator = value;
+      else if( "last-modified" == name && this->Validator.empty() ) this->Validator = value;
+    }
+
+    // writes received data, returns false if the data could not be written
+    bool Write( const char *data, size_t length )
+    {
+      if( !this->Started && !this->Begin() ) return false;
+
+      if( this->Prime && 0 < length )
+      {
+        // the byte before the resume offset holds the first bits of the next deflate block
+        int value = static_cast< unsigned char >( data[0] ) >> ( 8 - this->Saved.Bits );
+        if( Z_OK != inflatePrime( &this->Stream, this->Saved.Bits, value ) ) return false;
+        if( !this->SetDictionary() ) return false;
+        this->Prime = false;
+        this->Position++;
+        data++;
+        length--;
+      }
+
+      if( !this->Decompress || ( this->Detected && !this->Compressed ) )
+      {
+        if( !this->WriteOutput( data, length ) ) return false;
+        this->Position += length;
+        this->UpdateJournal( 0 );
+        return true;
+      }
+
+      if( this->Detected ) return this->Inflate( data, length );
+
+      // hold on to the data until we have enough to check for the gzip magic number
+      this->Head.append( data, length );
+      return 2 > this->Head.size() ? true : this->Detect();
+    }
+
+    // called once all data has been received, verifies the data (discarding it if it is
+    // incomplete or corrupt) and returns whether the file was successfully written
+    bool Finish( std::string &error )
+    {
+      // data too short to be gzipped is written as-is
+      if( this->Decompress && !this->Detected && !this->Detect() )
+        error = "Unable to write file \"" + this->FileName + "\"";
+      else if( this->Compressed && ( !this->StreamEnded || this->TrailerPending ) )
+        error = "Incomplete gzip data received from Opal";
+      else if( 0 <= this->Length && this->Position != this->Length )
+        error = "Incomplete data received from Opal";
+      else if( 0 != fflush( this->File ) )
+        error = "Unable to write file \"" + this->FileName + "\"";
+
+      if( !error.empty() )
+      {
+        this->Discard();
+        return false;
+      }
+
+      this->Close();
+      remove( this->JournalName.c_str() );
+      this->Digest = Utilities::digestString( this->Hash );
+      return true;
+    }
+
+    // keeps the partial file and its journal so that the transfer can be resumed later, returns
+    // false (discarding the partial file) if none of the data can be used to resume
+    bool Suspend()
+    {
+      // data which isn't decompressed can be resumed from exactly where it stopped
+      if( this->Resumable && NULL != this->File && 0 == fflush( this->File ) &&
+          ( !this->Decompress || ( this->Detected && !this->Compressed ) ) )
+      {
+        this->Saved.Offset = this->Position;
+        this->Saved.Output = this->Output;
+        this->WriteJournal();
+      }
+
+      this->Close();
+      if( 0 < this->Saved.Offset ) return true;
+      this->Discard();
+      return false;
+    }
+
+    // removes the file and its journal
+    void Discard()
+    {
+      this->Close();
+      remove( this->FileName.c_str() );
+      remove( this->JournalName.c_str() );
+    }
+
+  protected:
+    // the point in the data which a transfer can be resumed from
+    struct Checkpoint
+    {
+      Checkpoint() : Offset( 0 ), Output( 0 ), Member( 0 ), Crc( 0 ), Bits( 0 ) {}
+      curl_off_t Offset; // the amount of data (as sent by Opal) which has been used
+      curl_off_t Output; // the amount of data which has been written to the file
+      curl_off_t Member; // the amount of data decompressed from the current gzip member
+      unsigned long Crc; // the checksum of the data decompressed from the current gzip member
+      int Bits; // the number of bits of the last used byte which belong to the next block
+    };
+
+    // checks the response once the first data has been received
+    bool Begin()
+    {
+      long code = 0;
+      double size = -1.0;
+      this->Started = true;
+      curl_easy_getinfo( this->Curl, CURLINFO_RESPONSE_CODE, &code );
+      curl_easy_getinfo( this->Curl, CURLINFO_CONTENT_LENGTH_DOWNLOAD, &size );
+
+      if( 0 < this->Start )
+      {
+        // Opal must send the rest of the same data, not all of it (or an error)
+        if( 206 != code || ( 0 <= size && 0 <= this->Length && this->Length != this->Start + size ) )
+        {
+          this->RangeRejected = true;
+          return false;
+        }
+      }
+      else if( 0 <= size ) this->Length = static_cast< curl_off_t >( size );
+
+      // only keep a journal of actual data (not of error messages)
+      this->Resumable = 200 == code || 206 == code;
+      return true;
+    }
+
+    bool Detect()
+    {
+      this->Detected = true;
+      this->Compressed = 2 <= this->Head.size() &&
+        0x1f == static_cast< unsigned char >( this->Head[0] ) &&
+        0x8b == static_cast< unsigned char >( this->Head[1] );
+
+      if( this->Compressed )
+      {
+        // add 16 to the window bits to decode the gzip header and trailer
+        if( !this->InitializeStream( 16 + MAX_WBITS ) ) return false;
+        return this->Inflate( this->Head.data(), this->Head.size() );
+      }
+
+      if( !this->WriteOutput( this->Head.data(), this->Head.size() ) ) return false;
+      this->Position += this->Head.size();
+      return true;
+    }
+
+    // writes data to the file, keeping track of its size and digest
+    bool WriteOutput( const char *data, const size_t length )
+    {
+      if( length != fwrite( data, 1, length, this->File ) ) return false;
+      this->Hash.Update( reinterpret_cast< const unsigned char* >( data ), length );
+      this->Output += length;
+      return true;
+    }
+
+    // adds the data kept from an earlier incomplete transfer to the digest, leaving the file
+    // positioned at its end
+    bool HashSaved()
+    {
+      std::vector< char > buffer( GZIP_CHUNK_SIZE );
+      curl_off_t remaining = this->Saved.Output;
+      while( 0 < remaining )
+      {
+        size_t length = remaining < static_cast< curl_off_t >( buffer.size() ) ? remaining : buffer.size();
+        if( length != fread( &buffer[0], 1, length, this->File ) ) return false;
+        this->Hash.Update( reinterpret_cast< const unsigned char* >( &buffer[0] ), length );
+        remaining -= length;
+      }
+      return 0 == fseek( this->File, 0, SEEK_END );
+    }
+
+    bool InitializeStream( const int windowBits )
+    {
+      if( this->Initialized ) inflateEnd( &this->Stream );
+      this->Initialized = Z_OK == inflateInit2( &this->Stream, windowBits );
+      this->Raw = 0 > windowBits;
+      this->Buffer.resize( GZIP_CHUNK_SIZE );
+      return this->Initialized;
+    }
+
+    // prepares to continue decompressing from the last checkpoint, which is in the middle of a
+    // gzip member's deflate data (so without the gzip header, which is why the stream is raw)
+    bool ResumeStream()
+    {
+      if( !this->InitializeStream( -MAX_WBITS ) ) return false;
+
+      // the data preceding the checkpoint is needed to decompress the data which follows it
+      curl_off_t size = this->Saved.Member < DEFLATE_WINDOW_SIZE ? this->Saved.Member : DEFLATE_WINDOW_SIZE;
+      this->Window.resize( size );
+      if( 0 < size )
+      {
+        if( 0 != fseek( this->File, this->Saved.Output - size, SEEK_SET ) ||
+            size != fread( &this->Window[0], 1, size, this->File ) ||
+            0 != fseek( this->File, 0, SEEK_END ) ) return false;
+      }
+
+      // when the checkpoint isn't on a byte boundary the dictionary is set once the byte
+      // preceding it has been received (see Write())
+      this->Prime = 0 < this->Saved.Bits;
+      return this->Prime ? true : this->SetDictionary();
+    }
+
+    bool SetDictionary()
+    {
+      bool success = this->Window.empty() ||
+        Z_OK == inflateSetDictionary( &this->Stream, &this->Window[0], this->Window.size() );
+      this->Window.clear();
+      return success;
+    }
+
+    bool Inflate( const char *data, const size_t length )
+    {
+      curl_off_t base = this->Position;
+      this->Stream.next_in = reinterpret_cast< Bytef* >( const_cast< char* >( data ) );
+      this->Stream.avail_in = length;
+
+      do
+      {
+        if( this->StreamEnded )
+        {
+          if( this->TrailerPending && !this->ReadTrailer() ) return false;
+          if( this->TrailerPending || 0 == this->Stream.avail_in ) break;
+
+          // a new gzip member may follow the end of the previous one
+          if( this->Raw ? !this->InitializeStream( 16 + MAX_WBITS ) : Z_OK != inflateReset( &this->Stream ) )
+            return false;
+          this->StreamEnded = false;
+          this->Member = 0;
+          this->Crc = crc32( 0L, Z_NULL, 0 );
+        }
+
+        // stop at the end of every deflate block so that checkpoints can be made
+        this->Stream.next_out = &this->Buffer[0];
+        this->Stream.avail_out = this->Buffer.size();
+        int result = inflate( &this->Stream, Z_BLOCK );
+        if( Z_DATA_ERROR == result || Z_NEED_DICT == result ) this->Corrupt = true;
+        if( Z_OK != result && Z_STREAM_END != result && Z_BUF_ERROR != result ) return false;
+
+        size_t have = this->Buffer.size() - this->Stream.avail_out;
+        if( !this->WriteOutput( reinterpret_cast< const char* >( &this->Buffer[0] ), have ) ) return false;
+        this->Position = base + ( reinterpret_cast< const char* >( this->Stream.next_in ) - data );
+        this->Member += have;
+        this->Crc = crc32( this->Crc, &this->Buffer[0], have );
+
+        if( Z_STREAM_END == result )
+        {
+          // zlib only checks the trailer of gzip members which it has decoded the header of
+          this->StreamEnded = true;
+          this->TrailerPending = this->Raw;
+        }
+        else if( ( this->Stream.data_type & 128 ) && !( this->Stream.data_type & 64 ) )
+        {
+          // between two blocks of deflate data (and not after the last one)
+          this->UpdateJournal( this->Stream.data_type & 7 );
+        }
+
+        // no progress can be made without more input
+        if( Z_BUF_ERROR == result ) break;
+      }
+      while( 0 < this->Stream.avail_in || 0 == this->Stream.avail_out );
+
+      this->Position = base + ( reinterpret_cast< const char* >( this->Stream.next_in ) - data );
+      return true;
+    }
+
+    // reads the gzip trailer (checksum and size) following a resumed member's deflate data
+    bool ReadTrailer()
+    {
+      while( 8 > this->Trailer.size() && 0 < this->Stream.avail_in )
+      {
+        this->Trailer += static_cast< char >( *this->Stream.next_in );
+        this->Stream.next_in++;
+        this->Stream.avail_in--;
+      }
+      if( 8 > this->Trailer.size() ) return true;
+
+      unsigned long crc = 0, size = 0;
+      for( int i = 3; i >= 0; --i )
+      {
+        crc = ( crc << 8 ) | static_cast< unsigned char >( this->Trailer[i] );
+        size = ( size << 8 ) | static_cast< unsigned char >( this->Trailer[i + 4] );
+      }
+      this->Trailer = "";
+      this->TrailerPending = false;
+
+      if( crc != this->Crc || size != ( this->Member & 0xffffffffUL ) )
+      {
+        Utilities::log( "Checksum of \"" + this->FileName + "\" does not match the data received" );
+        this->Corrupt = true;
+        return false;
+      }
+      return true;
+    }
+
+    // records the current position in the journal, if enough data has been received since the
+    // last time it was recorded
+    void UpdateJournal( const int bits )
+    {
+      if( !this->Resumable || JOURNAL_INTERVAL > this->Position - this->Saved.Offset ) return;
+
+      // everything written so far must be in the file before the journal refers to it
+      if( 0 != fflush( this->File ) ) return;
+
+      this->Saved.Offset = this->Position;
+      this->Saved.Output = this->Output;
+      this->Saved.Member = this->Member;
+      this->Saved.Crc = this->Crc;
+      this->Saved.Bits = bits;
+      this->WriteJournal();
+    }
+
+    void WriteJournal()
+    {
+      // write to a temporary file first so that the journal is never left half written
+      std::string temporary = this->JournalName + ".tmp";
+      std::ofstream stream( temporary.c_str(), std::ofstream::out | std::ofstream::trunc );
+      stream << "Offset " << this->Saved.Offset << std::endl
+             << "Output " << this->Saved.Output << std::endl
+             << "Member " << this->Saved.Member << std::endl
+             << "Crc " << this->Saved.Crc << std::endl
+             << "Bits " << this->Saved.Bits << std::endl
+             << "Compressed " << ( this->Compressed ? 1 : 0 ) << std::endl
+             << "Length " << this->Length << std::endl
+             << "Validator " << this->Validator << std::endl;
+      stream.close();
+      if( stream.fail() || 0 != rename( temporary.c_str(), this->JournalName.c_str() ) )
+        remove( temporary.c_str() );
+    }
+
+    // reads the journal left by an earlier transfer, returns false if there isn't a valid one
+    bool ReadJournal()
+    {
+      std::ifstream stream( this->JournalName.c_str() );
+      if( !stream.is_open() ) return false;
+
+      std::map< std::string, std::string > values;
+      std::string line;
+      while( std::getline( stream, line ) )
+      {
+        std::string::size_type space = line.find( ' ' );
+        if( std::string::npos != space ) values[line.substr( 0, space )] = line.substr( space + 1 );
+      }
+
+      Checkpoint saved;
+      int compressed = -1;
+      std::stringstream( values["Offset"] ) >> saved.Offset;
+      std::stringstream( values["Output"] ) >> saved.Output;
+      std::stringstream( values["Member"] ) >> saved.Member;
+      std::stringstream( values["Crc"] ) >> saved.Crc;
+      std::stringstream( values["Bits"] ) >> saved.Bits;
+      std::stringstream( values["Compressed"] ) >> compressed;
+      std::stringstream( values["Length"] ) >> this->Length;
+      this->Validator = values["Validator"];
+
+      // the file must still have all the data the journal refers to
+      bool valid = 0 < saved.Offset && 0 <= saved.Output && 0 <= saved.Bits && 8 > saved.Bits &&
+        ( 0 == compressed || ( 1 == compressed && this->Decompress ) ) &&
+        saved.Output <= static_cast< curl_off_t >( Utilities::getFileLength( this->FileName ) );
+      if( !valid )
+      {
+        remove( this->JournalName.c_str() );
+        this->Length = -1;
+        this->Validator = "";
+        return false;
+      }
+
+      this->Saved = saved;
+      this->Compressed = 1 == compressed;
+      return true;
+    }
+
+    void Close()
+    {
+      if( this->Initialized ) inflateEnd( &this->Stream );
+      this->Initialized = false;
+      if( NULL != this->File ) fclose( this->File );
+      this->File = NULL;
+    }
+
+    std::string FileName;
+    std::string JournalName;
+    bool Decompress;
+    FILE *File;
+    CURL *Curl;
+    bool Started;
+    bool Resumable;
+    bool Detected;
+    bool Compressed;
+    bool Initialized;
+    bool Raw;
+    bool Prime;
+    bool StreamEnded;
+    bool TrailerPending;
+    bool Corrupt;
+    bool RangeRejected;
+    curl_off_t Start;
+    curl_off_t Position;
+    curl_off_t Length;
+    curl_off_t Output;
+    curl_off_t Member;
+    unsigned long Crc;
+    Checkpoint Saved;
+    std::string Validator;
+    std::string Digest;
+    CryptoPP::SHA256 Hash;
+    std::string Head;
+    std::string Trailer;
+    std::vector< Bytef > Window;
+    std::vector< Bytef > Buffer;
+    z_stream Stream;
+  };
+
+  // this function is used by curl to write a file transfer's data
+  size_t OpalService::curlWriteCallback( char *ptr, size_t size, size_t nmemb, void *userdata )
+  {
+    // returning anything other than the amount of data received aborts the transfer
+    size_t length = size * nmemb;
+    return static_cast< FileWriter* >( userdata )->Write( ptr, length ) ? length : 0;
+  }
+
+  // this function is used by curl to pass a file transfer's response headers
+  size_t OpalService::curlHeaderCallback( char *ptr, size_t size, size_t nmemb, void *userdata )
+  {
+    size_t length = size * nmemb;
+    static_cast< FileWriter* >( userdata )->Header( ptr, length );
+    return length;
+  }
+
+  // opens a uniquely named temporary file next to the given file, since several threads (each
+  // with its own service) may be writing the same cache entry at once
+  static FILE* openTemporary( const std::string fileName, std::string &temporary )
+  {
+    std::string pattern = fileName + ".XXXXXX";
+    std::vector< char > name( pattern.begin(), pattern.end() );
+    name.push_back( '\0' );
+
+    int descriptor = mkstemp( &name[0] );
+    if( -1 == descriptor ) return NULL;
+
+    FILE *file = fdopen( descriptor, "wb" );
+    if( NULL == file )
+    {
+      close( descriptor );
+      remove( &name[0] );
+      return NULL;
+    }
+    temporary = &name[0];
+    return file;
+  }
+
+  class OpalService::CachedResponse
+  {
+  public:
+    // a negative lifetime (or a service without a cache directory) disables caching, a lifetime
+    // of zero means that the cached copy must always be revalidated with Opal before it is used
+    CachedResponse( const OpalService *service, const std::string servicePath, const int lifetime )
+      : Lifetime( lifetime ), Time( 0 ), Complete( false ), Status( 0 ), Parser( NULL ), Body( NULL ),
+        File( NULL ), Attempted( false )
+    {
+      if( service->CacheDirectory.empty() || 0 > lifetime ) return;
+
+      // what Opal returns depends on who is asking, so the user is part of the key
+      std::stringstream key;
+      key << service->Username << "@" << service->Host << ":" << service->Port << servicePath;
+      std::string keyString = key.str();
+      CryptoPP::SHA256 hash;
+      hash.Update( reinterpret_cast< const unsigned char* >( keyString.c_str() ), keyString.length() );
+      std::string name = Utilities::digestString( hash );
+
+      // entries are spread over directories named after the first two digits of their hash
+      this->Directory = service->CacheDirectory + "/" + name.substr( 0, 2 );
+      this->FileName = this->Directory + "/" + name + ".json";
+      this->MetaName = this->Directory + "/" + name + ".meta";
+      this->ReadMeta();
+    }
+
+    ~CachedResponse()
+    {
+      if( NULL != this->File ) fclose( this->File );
+      if( !this->TemporaryName.empty() ) remove( this->TemporaryName.c_str() );
+    }
+
+    void SetParser( JsonStreamParser *parser ) { this->Parser = parser; }
+    void SetBody( std::string *body ) { this->Body = body; }
+
+    // whether there is a cached copy of the response
+    bool IsCached() const { return 0 < this->Time; }
+
+    // whether the cached copy can be used without asking Opal whether it has changed (an
+    // incomplete response may have more data to come, so it is always revalidated)
+    bool IsFresh() const
+    {
+      double age = difftime( time( NULL ), this->Time );
+      return this->IsCached() && this->Complete && 0.0 <= age && age < this->Lifetime;
+    }
+
+    // whether Opal has confirmed that the cached copy is still current
+    bool IsNotModified() const { return 304 == this->Status && this->IsCached(); }
+
+    // adds the headers which ask Opal to only send the response if it has changed
+    curl_slist* AddValidators( curl_slist *headers ) const
+    {
+      if( !this->IsCached() ) return headers;
+      if( !this->ETag.empty() )
+        headers = curl_slist_append( headers, ( "If-None-Match: " + this->ETag ).c_str() );
+      if( !this->LastModified.empty() )
+        headers = curl_slist_append( headers, ( "If-Modified-Since: " + this->LastModified ).c_str() );
+      return headers;
+    }
+
+    // keeps track of the status and the response headers which identify the version of the data
+    void Header( const char *data, const size_t length )
+    {
+      // every response (including interim and redirect responses) starts with a status line
+      if( 5 <= length && 0 == strncmp( data, "HTTP/", 5 ) )
+      {
+        std::string line( data, length );
+        std::string::size_type space = line.find( ' ' );
+        this->Status = std::string::npos == space ? 0 : atoi( line.c_str() + space + 1 );
+        this->NewETag = "";
+        this->NewLastModified = "";
+        return;
+      }
+
+      std::string name, value;
+      if( !splitHeader( data, length, name, value ) ) return;
+      if( "etag" == name ) this->NewETag = value;
+      else if( "last-modified" == name ) this->NewLastModified = value;
+    }
+
+    // passes received data on, keeping a copy of it if it is to be cached, returns false if
+    // the data could not be parsed
+    bool Write( const char *data, const size_t length )
+    {
+      // a not modified response has no body, the cached copy is used instead
+      if( this->IsNotModified() ) return true;
+
+      if( !this->Attempted && !this->FileName.empty() && 200 == this->Status )
+      {
+        this->Attempted = true;
+        if( !Utilities::fileExists( this->Directory ) )
+          vtkDirectory::MakeDirectory( this->Directory.c_str() );
+        this->File = openTemporary( this->FileName, this->TemporaryName );
+      }
+
+      // the response can still be used if it can't be cached
+      if( NULL != this->File && length != fwrite( data, 1, length, this->File ) ) this->Discard();
+
+      return this->Pass( data, length );
+    }
+
+    // passes the cached copy on, returns false if it could not be read or parsed
+    bool Replay()
+    {
+      FILE *file = fopen( this->FileName.c_str(), "rb" );
+      if( NULL == file ) return false;
+
+      std::vector< char > buffer( CACHE_CHUNK_SIZE );
+      bool success = true;
+      size_t length;
+      while( success && 0 < ( length = fread( &buffer[0], 1, buffer.size(), file ) ) )
+        success = this->Pass( &buffer[0], length );
+      if( ferror( file ) ) success = false;
+      fclose( file );
+      return success;
+    }
+
+    // called once the response has been parsed, stores a response received from Opal or notes
+    // that Opal has confirmed the cached copy is still current, along with whether it is complete
+    void Commit( const bool complete )
+    {
+      if( this->IsNotModified() )
+      {
+        if( !this->NewETag.empty() ) this->ETag = this->NewETag;
+        if( !this->NewLastModified.empty() ) this->LastModified = this->NewLastModified;
+        this->Time = time( NULL );
+        this->Complete = complete;
+        this->WriteMeta();
+        return;
+      }
+
+      if( NULL == this->File ) return;
+      bool written = 0 == fclose( this->File );
+      this->File = NULL;
+
+      // a response which is never fresh is only worth keeping if it can be revalidated
+      bool useful = 0 < this->Lifetime || !this->NewETag.empty() || !this->NewLastModified.empty();
+      if( !written || !useful ) return;
+
+      // the old metadata must not describe the new response
+      remove( this->MetaName.c_str() );
+      if( 0 == rename( this->TemporaryName.c_str(), this->FileName.c_str() ) )
+      {
+        this->TemporaryName = "";
+        this->ETag = this->NewETag;
+        this->LastModified = this->NewLastModified;
+        this->Time = time( NULL );
+        this->Complete = complete;
+        this->WriteMeta();
+      }
+    }
+
+    // removes the cached copy (when it turns out to be damaged)
+    void Remove()
+    {
+      if( this->FileName.empty() ) return;
+      remove( this->MetaName.c_str() );
+      remove( this->FileName.c_str() );
+      this->Time = 0;
+    }
+
+  private:
+    bool Pass( const char *data, const size_t length )
+    {
+      if( NULL != this->Parser ) return this->Parser->Parse( data, length );
+      if( NULL != this->Body ) this->Body->append( data, length );
+      return true;
+    }
+
+    void Discard()
+    {
+      fclose( this->File );
+      this->File = NULL;
+      remove( this->TemporaryName.c_str() );
+      this->TemporaryName = "";
+    }
+
+    // the metadata is kept in the same "name value" format as a file transfer's journal
+    void ReadMeta()
+    {
+      std::ifstream stream( this->MetaName.c_str() );
+      if( !stream.is_open() || !Utilities::fileExists( this->FileName ) ) return;
+
+      std::map< std::string, std::string > values;
+      std::string line;
+      while( std::getline( stream, line ) )
+      {
+        std::string::size_type space = line.find( ' ' );
+        if( std::string::npos != space ) values[line.substr( 0, space )] = line.substr( space + 1 );
+      }
+
+      std::stringstream( values["Time"] ) >> this->Time;
+      this->ETag = values["ETag"];
+      this->LastModified = values["LastModified"];
+      this->Complete = "1" == values["Complete"];
+    }
+
+    void WriteMeta()
+    {
+      // write to a temporary file first so that the metadata is never left half written
+      std::string temporary;
+      FILE *file = openTemporary( this->MetaName, temporary );
+      if( NULL == file ) return;
+
+      std::stringstream stream;
+      stream << "Time " << this->Time << std::endl
+             << "ETag " << this->ETag << std::endl
+             << "LastModified " << this->LastModified << std::endl
+             << "Complete " << ( this->Complete ? 1 : 0 ) << std::endl;
+      std::string meta = stream.str();
+      bool written = meta.length() == fwrite( meta.c_str(), 1, meta.length(), file );
+      if( 0 != fclose( file ) ) written = false;
+      if( !written || 0 != rename( temporary.c_str(), this->MetaName.c_str() ) )
+        remove( temporary.c_str() );
+    }
+
+    int Lifetime;
+    time_t Time;
+    bool Complete;
+    int Status;
+    JsonStreamParser *Parser;
+    std::string *Body;
+    FILE *File;
+    bool Attempted;
+    std::string Directory;
+    std::string FileName;
+    std::string MetaName;
+    std::string TemporaryName;
+    std::string ETag;
+    std::string LastModified;
+    std::string NewETag;
+    std::string NewLastModified;
+  };
+
+  // this function is used by curl to pass a (possibly cached) response's data
+  size_t OpalService::curlResponseCallback( char *ptr, size_t size, size_t nmemb, void *userdata )
+  {
+    // returning anything other than the amount of data received aborts the transfer
+    size_t length = size * nmemb;
+    return static_cast< CachedResponse* >( userdata )->Write( ptr, length ) ? length : 0;
+  }
+
+  // this function is used by curl to pass a (possibly cached) response's headers
+  size_t OpalService::curlResponseHeaderCallback( char *ptr, size_t size, size_t nmemb, void *userdata )
+  {
+    size_t length = size * nmemb;
+    static_cast< CachedResponse* >( userdata )->Header( ptr, length );
+    return length;
+  }
+
+  // collects the identifiers from a list of entities: [ { "identifier": "...", ... }, ... ]
+  class IdentifierParser : public JsonStreamParser
+  {
+  public:
+    IdentifierParser( std::vector< std::string > &list ) : List( list ) {}
+
+  protected:
+    void OnValue( const std::string &value, const ValueType type )
+    {
+      if( 2 == this->GetDepth() && "identifier" == this->GetCurrentKey() && 0 < value.length() )
+        this->List.push_back( value );
+    }
+
+    std::vector< std::string > &List;
+  };
+
+  // collects rows from a list of value sets, adding each row as soon as it has been received:
+  // { "variables": [ "...", ... ],
+  //   "valueSets": [ { "identifier": "...", "values": [ { "value": "..." }, ... ] }, ... ] }
+  class ValueSetParser : public JsonStreamParser
+  {
+  public:
+    ValueSetParser( std::map< std::string, std::map< std::string, std::string > > &list )
+      : List( list ) {}
+
+  protected:
+    void OnStartObject()
+    {
+      if( 5 == this->GetDepth() && this->InValues() ) this->Values.push_back( "" );
+    }
+
+    void OnEndObject()
+    {
+      int depth = this->GetDepth();
+      if( 3 == depth && "valueSets" == this->GetKey( 1 ) )
+      {
+        if( 0 < this->Identifier.length() )
+        {
+          // Opal lists the variables first, but just in case it doesn't keep the row for later
+          if( this->Variables.empty() )
+            this->Pending.push_back( std::make_pair( this->Identifier, this->Values ) );
+          else this->AddRow( this->Identifier, this->Values );
+        }
+        this->Identifier = "";
+        this->Values.clear();
+      }
+      else if( 1 == depth )
+      {
+        std::vector< std::pair< std::string, std::vector< std::string > > >::iterator it;
+        for( it = this->Pending.begin(); it != this->Pending.end(); ++it )
+          this->AddRow( it->first, it->second );
+        this->Pending.clear();
+      }
+    }
+
+    void OnValue( const std::string &value, const ValueType type )
+    {
+      int depth = this->GetDepth();
+      if( 2 == depth && "variables" == this->GetKey( 1 ) )
+        this->Variables.push_back( value );
+      else if( 3 == depth && "valueSets" == this->GetKey( 1 ) && "identifier" == this->GetCurrentKey() )
+        this->Identifier = value;
+      else if( 5 == depth && this->InValues() && "value" == this->GetCurrentKey() )
+        this->Values.back() = value;
+    }
+
+    // whether the innermost container is one of a value set's values
+    bool InValues() const
+    {
+      return "valueSets" == this->GetKey( 1 ) && "values" == this->GetKey( 3 );
+    }
+
+    void AddRow( const std::string identifier, const std::vector< std::string > &values )
+    {
+      std::map< std::string, std::string > &map = this->List[identifier];
+      for( int j = 0; j < values.size(); ++j )
+        map[j < this->Variables.size() ? this->Variables[j] : ""] = values[j];
+    }
+
+    std::map< std::string, std::map< std::string, std::string > > &List;
+    std::vector< std::string > Variables;
+    std::string Identifier;
+    std::vector< std::string > Values;
+    std::vector< std::pair< std::string, std::vector< std::string > > > Pending;
+  };
+
+  // collects all values of each variable of a single value set, where regular variables have
+  // a single value and repeatable variables have a list of values:
+  // { "variables": [ "...", ... ], "valueSets": [ { "identifier": "...", "values": [
+  //   { "value": "..." }, { "values": [ { "value": "..." }, ... ] }, ... ] } ] }
+  class ValueListParser : public JsonStreamParser
+  {
+  public:
+    ValueListParser( std::map< std::string, std::vector< std::string > > &list ) : List( list ) {}
+
+  protected:
+    void OnStartObject()
+    {
+      if( 5 == this->GetDepth() && this->InValues() ) this->Values.push_back( std::vector< std::string >() );
+    }
+
+    void OnEndObject()
+    {
+      // only the first value set is used
+      if( 3 == this->GetDepth() && "valueSets" == this->GetKey( 1 ) && this->Variables.size() )
+        for( int j = 0; j < this->Values.size() && j < this->Variables.size(); ++j )
+          if( 0 == this->List.count( this->Variables[j] ) ) this->List[this->Variables[j]] = this->Values[j];
+    }
+
+    void OnValue( const std::string &value, const ValueType type )
+    {
+      int depth = this->GetDepth();
+      if( 2 == depth && "variables" == this->GetKey( 1 ) )
+        this->Variables.push_back( value );
+      else if( "value" == this->GetCurrentKey() && NullValue != type && this->InValues() &&
+               ( 5 == depth || ( 7 == depth && "values" == this->GetKey( 5 ) ) ) )
+        this->Values.back().push_back( value );
+    }
+
+    // whether the innermost container is (part of) one of a value set's values
+    bool InValues() const
+    {
+      return 4 < this->GetDepth() && "valueSets" == this->GetKey( 1 ) && "values" == this->GetKey( 3 );
+    }
+
+    std::map< std::string, std::vector< std::string > > &List;
+    std::vector< std::string > Variables;
+    std::vector< std::vector< std::string > > Values;
+  };
 
   // this function is used by curl to send progress signals
   int OpalService::curlProgressCallback(
-    const void * const notUsed,
+    void *clientp,
     const double downTotal, const double downNow,
     const double upTotal, const double upNow )
   {
     Application *app = Application::GetInstance();
+    ProgressChannel *channel = ProgressChannel::GetInstance();
+    TransferProgress *transfer = static_cast< TransferProgress* >( clientp );
+    ProgressState *state = transfer->State;
 
     if( !app->GetAbortFlag() )
     {
       bool global = false;
-      // send the configure event if it hasn't been sent yet
-      if( !OpalService::configureEventSent  )
-      {
-        // send a pair, the first argument is that this is the local progress, the second to set the mode
-        bool progressBusy = OpalService::curlProgressChecking ? (0.0 == downTotal) : false;
-        std::pair<bool, bool> configureProgress = std::pair<bool, bool>( global, progressBusy );
-        app->InvokeEvent( vtkCommand::ConfigureEvent, static_cast<void *>( &configureProgress ) );
-        OpalService::configureEventSent = true;
+      // configure the local progress meter if it hasn't been configured yet
+      if( !state->Configured )
+      {
+        channel->Configure( global, state->Checking ? ( 0.0 == downTotal ) : false );
+        state->Configured = true;
         return 0;
       }
 
-      // if the downTotal is 0 then we can't send a progress event
-      std::pair<bool, double> progress =
-        std::pair<bool, double>( global, ( 0.0 == downTotal ? downTotal : downNow / downTotal ) );
-       
-      app->InvokeEvent( vtkCommand::ProgressEvent, static_cast<void *>( &progress ) );
+      // progress is that of all transfers sharing the state
+      state->DownTotal[transfer->Index] = downTotal;
+      state->DownNow[transfer->Index] = downNow;
+      double total = 0.0, now = 0.0;
+      for( int i = 0; i < state->DownTotal.size(); ++i )
+      {
+        total += state->DownTotal[i];
+        now += state->DownNow[i];
+      }
+
+      // updates are coalesced by the channel, so posting every callback costs next to nothing
+      channel->Progress( global, 0.0 == total ? total : now / total );
     }
 
     return app->GetAbortFlag() ? 1 : 0;
@@ -72,6 +1037,38 @@ namespace Alder
     this->Host = "localhost";
     this->Port = 8843;
     this->Timeout = 10;
+    this->MaximumTransfers = 4;
+    this->CacheDirectory = "";
+    this->CacheLifetime = 86400;
+    this->FilesReceived = 0;
+    this->BytesReceived = 0.0;
+    this->StatisticsInterval = 600;
+    this->LastSummaryTime = time( NULL );
+
+    this->Share = curl_share_init();
+    if( this->Share )
+    {
+      curl_share_setopt( this->Share, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS );
+      curl_share_setopt( this->Share, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION );
+#if LIBCURL_VERSION_NUM >= 0x073900
+      curl_share_setopt( this->Share, CURLSHOPT_SHARE, CURL_LOCK_DATA_CONNECT );
+#endif
+    }
+  }
+
+  //-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-
+  OpalService::~OpalService()
+  {
+    // the handles must be cleaned up before the share they use
+    for( auto it = this->HandlePool.cbegin(); it != this->HandlePool.cend(); ++it )
+      curl_easy_cleanup( *it );
+    this->HandlePool.clear();
+
+    if( this->Share )
+    {
+      curl_share_cleanup( this->Share );
+      this->Share = NULL;
+    }
   }
 
   //-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-
@@ -87,87 +1084,384 @@ namespace Alder
   }
 
   //-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-
-  Json::Value OpalService::Read(
-    const std::string servicePath, const std::string fileName, const bool progress ) const
+  curl_slist* OpalService::CreateHeaders() const
   {
-    bool toFile = 0 < fileName.length();
-    FILE *file;
-    CURL *curl;
-    std::stringstream urlStream;
-    std::string credentials, url, result;
+    std::string credentials;
     struct curl_slist *headers = NULL;
-    CURLcode res;
-    Json::Value root;
-    Json::Reader reader;
-    Application *app = Application::GetInstance();
 
     // encode the credentials
     Utilities::base64String( this->Username + ":" + this->Password, credentials );
     credentials = "Authorization:X-Opal-Auth " + credentials;
 
-    urlStream << "https://" << this->Host << ":" << this->Port << "/ws" + servicePath;
-    url = urlStream.str();
-    Utilities::log( "Querying Opal: " + url );
-
-    curl = curl_easy_init();
-    if( !curl ) 
-      throw std::runtime_error( "Unable to create cURL connection to Opal" );
-
     // put the credentials in a header and the option to return data in json format
     headers = curl_slist_append( headers, "Accept: application/json" );
     headers = curl_slist_append( headers, credentials.c_str() );
 
-    // if we are writing to a file, open it
-    if( toFile ) 
-    {
-      file = fopen( fileName.c_str(), "wb" );
+    return headers;
+  }
 
-      if( NULL == file )
-      {
-        std::stringstream stream;
-        stream << "Unable to open file \"" << fileName << "\" for writing." << endl;
-        throw std::runtime_error( stream.str().c_str() );
-      }
-      curl_easy_setopt( curl, CURLOPT_WRITEFUNCTION, Utilities::writePointerToFile );
-      curl_easy_setopt( curl, CURLOPT_WRITEDATA, file );
+  //-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-
+  CURL* OpalService::CreateHandle( const std::string servicePath, curl_slist *headers ) const
+  {
+    std::stringstream urlStream;
+    urlStream << "https://" << this->Host << ":" << this->Port << "/ws" + servicePath;
+    std::string url = urlStream.str();
+    Utilities::log( "Querying Opal: " + url );
+
+    // reuse a pooled handle if there is one, resetting it keeps its live connections
+    CURL *curl;
+    if( !this->HandlePool.empty() )
+    {
+      curl = this->HandlePool.back();
+      this->HandlePool.pop_back();
+      curl_easy_reset( curl );
     }
     else
     {
-      curl_easy_setopt( curl, CURLOPT_WRITEFUNCTION, Utilities::writePointerToString );
-      curl_easy_setopt( curl, CURLOPT_WRITEDATA, &result );
+      curl = curl_easy_init();
+      if( !curl ) 
+        throw std::runtime_error( "Unable to create cURL connection to Opal" );
     }
 
-    curl_easy_setopt( curl, CURLOPT_SSLVERSION, 3 );
+    if( this->Share ) curl_easy_setopt( curl, CURLOPT_SHARE, this->Share );
+    curl_easy_setopt( curl, CURLOPT_SSLVERSION, CURL_SSLVERSION_TLSv1 );
     curl_easy_setopt( curl, CURLOPT_SSL_VERIFYPEER, 0 );
+    curl_easy_setopt( curl, CURLOPT_TCP_KEEPALIVE, 1L );
+#if LIBCURL_VERSION_NUM >= 0x072f00
+    // use HTTP/2 if the server supports it, waiting to multiplex over an existing connection
+    // rather than opening a new one
+    curl_easy_setopt( curl, CURLOPT_HTTP_VERSION, CURL_HTTP_VERSION_2TLS );
+    curl_easy_setopt( curl, CURLOPT_PIPEWAIT, 1L );
+#endif
+    curl_easy_setopt( curl, CURLOPT_CONNECTTIMEOUT, static_cast<long>( this->Timeout ) );
     curl_easy_setopt( curl, CURLOPT_HTTPHEADER, headers );
     curl_easy_setopt( curl, CURLOPT_URL, url.c_str() );
+
+    return curl;
+  }
+
+  //-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-
+  void OpalService::ReleaseHandle( CURL *curl ) const
+  {
+    // keep as many handles as there can be transfers in progress at once
+    int maximum = 0 < this->MaximumTransfers ? this->MaximumTransfers : 1;
+    if( this->HandlePool.size() < maximum ) this->HandlePool.push_back( curl );
+    else curl_easy_cleanup( curl );
+  }
+
+  //-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-
+  Json::Value OpalService::Read(
+    const std::string servicePath, const std::string fileName,
+    const bool progress, const int lifetime,
+    const std::function< bool( const Json::Value& ) > &complete ) const
+  {
+    FILE *file;
+    CURL *curl;
+    struct curl_slist *headers;
+    CURLcode res;
+    Json::Value root;
+
+    // responses are only cached when they are read into memory
+    if( 0 == fileName.length() )
+    {
+      std::string result;
+      Json::Reader reader;
+      CachedResponse response( this, servicePath, lifetime );
+      response.SetBody( &result );
+      this->CheckResult( this->Fetch( servicePath, response, progress ) );
+
+      if( 0 == result.length() )
+        throw std::runtime_error( "Empty response from Opal service" );
+      else if( !reader.parse( result.c_str(), root ) )
+      {
+        response.Remove();
+        throw std::runtime_error( "Unable to parse result from Opal service" );
+      }
+
+      response.Commit( !complete || complete( root ) );
+      return root;
+    }
+
+    headers = this->CreateHeaders();
+    try
+    {
+      curl = this->CreateHandle( servicePath, headers );
+    }
+    catch( std::runtime_error &e )
+    {
+      curl_slist_free_all( headers );
+      throw;
+    }
+
+    file = fopen( fileName.c_str(), "wb" );
+    if( NULL == file )
+    {
+      curl_slist_free_all( headers );
+      this->ReleaseHandle( curl );
+      std::stringstream stream;
+      stream << "Unable to open file \"" << fileName << "\" for writing." << endl;
+      throw std::runtime_error( stream.str().c_str() );
+    }
+    curl_easy_setopt( curl, CURLOPT_WRITEFUNCTION, Utilities::writePointerToFile );
+    curl_easy_setopt( curl, CURLOPT_WRITEDATA, file );
+
+    // file type data is not checked for a substantial size before showing progress
+    res = this->Perform( curl, headers, FileEndpoint, false, progress );
+    fclose( file );
+    this->CheckResult( res );
+
+    return root;
+  }
+
+  //-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-
+  void OpalService::Read(
+    const std::string servicePath, JsonStreamParser &parser,
+    const bool progress, const int lifetime, const std::function< bool() > &complete ) const
+  {
+    CachedResponse response( this, servicePath, lifetime );
+    response.SetParser( &parser );
+    CURLcode res = this->Fetch( servicePath, response, progress );
+
+    // the write callback stops the transfer as soon as the parser finds an error
+    if( CURLE_WRITE_ERROR == res && !parser.GetError().empty() )
+    {
+      throw std::runtime_error(
+        "Unable to parse result from Opal service: " + parser.GetError() );
+    }
+    this->CheckResult( res );
+
+    // whatever was parsed before a user abort is left with the parser
+    if( CURLE_OK == res )
+    {
+      if( !parser.Finish() )
+      {
+        response.Remove();
+        throw std::runtime_error(
+          "Unable to parse result from Opal service: " + parser.GetError() );
+      }
+      response.Commit( !complete || complete() );
+    }
+  }
+
+  //-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-
+  CURLcode OpalService::Fetch(
+    const std::string servicePath, CachedResponse &response, const bool progress ) const
+  {
+    Endpoint endpoint = OpalService::GetEndpoint( servicePath );
+
+    // a fresh copy is used without contacting Opal at all
+    if( response.IsFresh() )
+    {
+      if( response.Replay() )
+      {
+        this->Statistics[endpoint].CacheHits++;
+        return CURLE_OK;
+      }
+      response.Remove();
+      throw std::runtime_error( "Unable to read cached result from Opal service" );
+    }
+
+    CURL *curl;
+    struct curl_slist *headers = response.AddValidators( this->CreateHeaders() );
+
+    try
+    {
+      curl = this->CreateHandle( servicePath, headers );
+    }
+    catch( std::runtime_error &e )
+    {
+      curl_slist_free_all( headers );
+      throw;
+    }
+
+    curl_easy_setopt( curl, CURLOPT_WRITEFUNCTION, OpalService::curlResponseCallback );
+    curl_easy_setopt( curl, CURLOPT_WRITEDATA, &response );
+    curl_easy_setopt( curl, CURLOPT_HEADERFUNCTION, OpalService::curlResponseHeaderCallback );
+    curl_easy_setopt( curl, CURLOPT_HEADERDATA, &response );
+
+    // when reading non file type data we check whether the response has a substantial size
+    // which we can monitor using curl progress
+    CURLcode res = this->Perform( curl, headers, endpoint, true, progress );
+
+    // Opal has confirmed that the cached copy is still current
+    if( CURLE_OK == res && response.IsNotModified() )
+    {
+      if( !response.Replay() )
+      {
+        response.Remove();
+        throw std::runtime_error( "Unable to read cached result from Opal service" );
+      }
+      this->Statistics[endpoint].CacheHits++;
+    }
+
+    return res;
+  }
+
+  //-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-
+  CURLcode OpalService::Perform(
+    CURL *curl, curl_slist *headers, const Endpoint endpoint,
+    const bool checking, const bool progress ) const
+  {
+    ProgressChannel *channel = ProgressChannel::GetInstance();
+    ProgressState state( checking, 1 );
+    TransferProgress transfer = { &state, 0 };
+
     if( progress )
     {
       curl_easy_setopt( curl, CURLOPT_NOPROGRESS, 0L );
       curl_easy_setopt( curl, CURLOPT_PROGRESSFUNCTION, OpalService::curlProgressCallback );
+      curl_easy_setopt( curl, CURLOPT_PROGRESSDATA, &transfer );
     }  
 
     // we are using the local progress bar for curl progress, not the global one
     bool global = false;
 
-    // invoke the start event using the local progress bar
-    app->InvokeEvent( vtkCommand::StartEvent, static_cast<void *>( &global ) );
-     
-    // if set, the configure event will be performed during the first callback within curl progress
-    res = curl_easy_perform( curl );
-
-    // invoke the end event using the local progress bar
-    app->InvokeEvent( vtkCommand::EndEvent, static_cast<void *>( &global ) );
+    // start the local progress meter, it is configured by the first curl progress callback
+    channel->Start( global );
+    CURLcode res = curl_easy_perform( curl );
+    channel->End( global );
 
     // clean up
+    this->RecordTransfer( curl, endpoint, res );
     curl_slist_free_all( headers );
-    curl_easy_cleanup( curl );
-    if( toFile ) fclose( file );
+    this->ReleaseHandle( curl );
+
+    return res;
+  }
+
+  //-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-
+  void OpalService::RecordTransfer( CURL *curl, const Endpoint endpoint, const CURLcode res ) const
+  {
+    // requests aborted by the user say nothing about the network
+    if( CURLE_ABORTED_BY_CALLBACK == res && Application::GetInstance()->GetAbortFlag() ) return;
+
+    TransferStatistics &statistics = this->Statistics[endpoint];
+    statistics.Requests++;
+    if( CURLE_OK != res ) statistics.Failures++;
+    else
+    {
+      // curl reports the time from the start of the request to the end of each phase
+      double nameLookup = 0.0, connect = 0.0, handshake = 0.0, firstByte = 0.0, total = 0.0, bytes = 0.0;
+      curl_easy_getinfo( curl, CURLINFO_NAMELOOKUP_TIME, &nameLookup );
+      curl_easy_getinfo( curl, CURLINFO_CONNECT_TIME, &connect );
+      curl_easy_getinfo( curl, CURLINFO_APPCONNECT_TIME, &handshake );
+      curl_easy_getinfo( curl, CURLINFO_STARTTRANSFER_TIME, &firstByte );
+      curl_easy_getinfo( curl, CURLINFO_TOTAL_TIME, &total );
+      curl_easy_getinfo( curl, CURLINFO_SIZE_DOWNLOAD, &bytes );
+
+      // there is no handshake (or connection) when an existing connection is reused
+      double connected = std::max( connect, handshake );
+      statistics.NameLookupTime += nameLookup;
+      statistics.ConnectTime += std::max( 0.0, connect - nameLookup );
+      statistics.HandshakeTime += 0.0 < handshake ? std::max( 0.0, handshake - connect ) : 0.0;
+      statistics.WaitTime += std::max( 0.0, firstByte - connected );
+      statistics.ReceiveTime += std::max( 0.0, total - firstByte );
+      statistics.TotalTime += total;
+      statistics.SlowestTime = std::max( statistics.SlowestTime, total );
+      statistics.Bytes += bytes;
+    }
+
+    time_t now = time( NULL );
+    if( 0 < this->StatisticsInterval && difftime( now, this->LastSummaryTime ) >= this->StatisticsInterval )
+    {
+      this->LastSummaryTime = now;
+      Utilities::log( "Opal transfer statistics:\n" + this->GetStatisticsSummary() );
+    }
+  }
+
+  //-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-
+  OpalService::Endpoint OpalService::GetEndpoint( const std::string servicePath )
+  {
+    // service paths are those built by the Get*() and SaveFile*() methods
+    std::string path = servicePath.substr( 0, servicePath.find( '?' ) );
+    std::string::size_type slash = path.rfind( '/' );
+    std::string last = std::string::npos == slash ? path : path.substr( slash + 1 );
+
+    if( "entities" == last ) return IdentifiersEndpoint;
+    else if( "valueSets" == last ) return RowsEndpoint;
+    else if( "value" == last ) return FileEndpoint;
+    return ValuesEndpoint;
+  }
+
+  //-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-
+  std::string OpalService::GetEndpointName( const Endpoint endpoint )
+  {
+    if( IdentifiersEndpoint == endpoint ) return "identifiers";
+    else if( RowsEndpoint == endpoint ) return "rows";
+    else if( ValuesEndpoint == endpoint ) return "values";
+    else if( FileEndpoint == endpoint ) return "files";
+    return "";
+  }
+
+  //-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-
+  OpalService::TransferStatistics OpalService::GetStatistics( const Endpoint endpoint ) const
+  {
+    if( 0 > endpoint || EndpointCount <= endpoint )
+      throw std::runtime_error( "Tried to get the statistics of an unknown kind of Opal request" );
+    return this->Statistics[endpoint];
+  }
+
+  //-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-
+  void OpalService::AddStatistics( const Endpoint endpoint, const TransferStatistics &statistics )
+  {
+    if( 0 > endpoint || EndpointCount <= endpoint )
+      throw std::runtime_error( "Tried to add the statistics of an unknown kind of Opal request" );
+
+    TransferStatistics &total = this->Statistics[endpoint];
+    total.Requests += statistics.Requests;
+    total.Failures += statistics.Failures;
+    total.CacheHits += statistics.CacheHits;
+    total.NameLookupTime += statistics.NameLookupTime;
+    total.ConnectTime += statistics.ConnectTime;
+    total.HandshakeTime += statistics.HandshakeTime;
+    total.WaitTime += statistics.WaitTime;
+    total.ReceiveTime += statistics.ReceiveTime;
+    total.TotalTime += statistics.TotalTime;
+    total.SlowestTime = std::max( total.SlowestTime, statistics.SlowestTime );
+    total.Bytes += statistics.Bytes;
+  }
+
+  //-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-
+  void OpalService::ResetStatistics()
+  {
+    for( int i = 0; i < EndpointCount; ++i ) this->Statistics[i] = TransferStatistics();
+    this->LastSummaryTime = time( NULL );
+  }
+
+  //-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-
+  std::string OpalService::GetStatisticsSummary() const
+  {
+    std::stringstream stream;
+    stream << std::fixed << std::setprecision( 0 );
+    for( int i = 0; i < EndpointCount; ++i )
+    {
+      const TransferStatistics &statistics = this->Statistics[i];
+      if( 0 == statistics.Requests && 0 == statistics.CacheHits ) continue;
+
+      // mean times (in milliseconds) of the successful requests
+      int timed = statistics.Requests - statistics.Failures;
+      double scale = 0 < timed ? 1000.0 / timed : 0.0;
+      stream << OpalService::GetEndpointName( static_cast< Endpoint >( i ) ) << ": "
+             << statistics.Requests << " requests (" << statistics.Failures << " failed), "
+             << statistics.CacheHits << " cache hits, " << std::setprecision( 2 )
+             << statistics.Bytes / 1048576.0 << " MB at "
+             << ( 0.0 < statistics.TotalTime ? statistics.Bytes / 1048576.0 / statistics.TotalTime : 0.0 )
+             << " MB/s, mean ms: lookup " << std::setprecision( 0 )
+             << statistics.NameLookupTime * scale << ", connect " << statistics.ConnectTime * scale
+             << ", tls " << statistics.HandshakeTime * scale << ", wait " << statistics.WaitTime * scale
+             << ", receive " << statistics.ReceiveTime * scale << ", total " << statistics.TotalTime * scale
+             << " (slowest " << statistics.SlowestTime * 1000.0 << ")" << std::endl;
+    }
+    return stream.str();
+  }
 
+  //-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-
+  void OpalService::CheckResult( const CURLcode res ) const
+  {
     if( 0 != res )
     {
       // don't display abort errors (code 42) when the user initiated the abort
-      if( !( CURLE_ABORTED_BY_CALLBACK == res && app->GetAbortFlag() ) )
+      if( !( CURLE_ABORTED_BY_CALLBACK == res && Application::GetInstance()->GetAbortFlag() ) )
       {
         std::stringstream stream;
         stream << "Received cURL error " << res << " when attempting to contact Opal: ";
@@ -175,16 +1469,6 @@ namespace Alder
         throw std::runtime_error( stream.str().c_str() );
       }
     }
-
-    if( !toFile )
-    {
-      if( 0 == result.length() )
-        throw std::runtime_error( "Empty response from Opal service" );
-      else if( !reader.parse( result.c_str(), root ) )
-        throw std::runtime_error( "Unable to parse result from Opal service" );
-    }
-
-    return root;
   }
 
   //-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-
@@ -193,14 +1477,10 @@ namespace Alder
   {
     std::stringstream stream;
     stream << "/datasource/" << dataSource << "/table/" << table << "/entities";
-    Json::Value root = this->Read( stream.str() );
-    
+
     std::vector< std::string > list;
-    for( int i = 0; i < root.size(); ++i )
-    {
-      std::string identifier = root[i].get( "identifier", "" ).asString();
-      if( 0 < identifier.length() ) list.push_back( identifier );
-    }
+    IdentifierParser parser( list );
+    this->Read( stream.str(), parser, true, 0 );
 
     // Opal doesn't sort results, do so now
     std::sort( list.begin(), list.end() );
@@ -212,29 +1492,12 @@ namespace Alder
     const std::string dataSource, const std::string table, const int offset, const int limit ) const
   {
     std::map< std::string, std::map< std::string, std::string > > list;
-    std::string identifier, key, value;
     std::stringstream stream;
 
     stream << "/datasource/" << dataSource << "/table/" << table
            << "/valueSets?offset=" << offset << "&limit=" << limit;
-    Json::Value root = this->Read( stream.str() );
-    
-    for( int i = 0; i < root["valueSets"].size(); ++i )
-    {
-      identifier = root["valueSets"][i].get( "identifier", "" ).asString();
-
-      if( 0 < identifier.length() )
-      {
-        std::map< std::string, std::string > map;
-        for( int j = 0; j < root["valueSets"][i]["values"].size(); ++j )
-        {
-          key = root["variables"][j].asString();
-          value = root["valueSets"][i]["values"][j].get( "value", "" ).asString();
-          map[key] = value;
-        }
-        list[identifier] = map;
-      }
-    }
+    ValueSetParser parser( list );
+    this->Read( stream.str(), parser, true, 0 );
 
     return list;
   }
@@ -243,25 +1506,22 @@ namespace Alder
   std::map< std::string, std::string > OpalService::GetRow(
     const std::string dataSource, const std::string table, const std::string identifier ) const
   {
-    std::map< std::string, std::string > map;
-    std::string key, value;
+    std::map< std::string, std::map< std::string, std::string > > list;
     std::stringstream stream;
 
     stream << "/datasource/" << dataSource << "/table/" << table
            << "/valueSet/" << identifier;
-    Json::Value root = this->Read( stream.str(), "", false );
-    
-    if( 0 < root["valueSets"][0].get( "identifier", "" ).asString().length() )
+    // the row is complete once every one of its variables has a value
+    ValueSetParser parser( list );
+    this->Read( stream.str(), parser, false, this->CacheLifetime, [&list]()
     {
-      for( int j = 0; j < root["valueSets"][0]["values"].size(); ++j )
-      {
-        key = root["variables"][j].asString();
-        value = root["valueSets"][0]["values"][j].get( "value", "" ).asString();
-        map[key] = value;
-      }
-    }
+      if( list.empty() ) return false;
+      for( auto it = list.begin()->second.cbegin(); it != list.begin()->second.cend(); ++it )
+        if( it->second.empty() ) return false;
+      return true;
+    } );
 
-    return map;
+    return list.empty() ? std::map< std::string, std::string >() : list.begin()->second;
   }
 
   //-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-
@@ -269,27 +1529,61 @@ namespace Alder
     const std::string dataSource, const std::string table,
     const std::string variable, const int offset, const int limit )
   {
+    std::map< std::string, std::map< std::string, std::string > > list;
     std::map< std::string, std::string > map;
-    std::string identifier, value;
     std::stringstream stream;
 
     stream << "/datasource/" << dataSource << "/table/" << table
            << "/valueSets?offset=" << offset << "&limit=" << limit
            << "&select=name().eq('" << variable << "')";
-    Json::Value root = this->Read( stream.str() );
-    
-    for( int i = 0; i < root["valueSets"].size(); ++i )
+    ValueSetParser parser( list );
+    this->Read( stream.str(), parser, true, 0 );
+
+    // only the one variable was selected, so each row has (at most) one value
+    std::map< std::string, std::map< std::string, std::string > >::iterator it;
+    for( it = list.begin(); it != list.end(); ++it )
+      map[it->first] = it->second.empty() ? "" : it->second.begin()->second;
+
+    return map;
+  }
+
+  //-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-
+  std::map< std::string, std::vector< std::string > > OpalService::GetValueSet(
+    const std::string dataSource, const std::string table, const std::string identifier,
+    const std::vector< std::string > &variables, const bool progress ) const
+  {
+    std::map< std::string, std::vector< std::string > > list;
+    std::stringstream stream;
+
+    stream << "/datasource/" << dataSource << "/table/" << table
+           << "/valueSet/" << identifier;
+
+    // restrict the value set to the requested variables
+    if( !variables.empty() )
     {
-      identifier = root["valueSets"][i].get( "identifier", "" ).asString();
+      stream << "?select=name().any(";
+      for( auto it = variables.cbegin(); it != variables.cend(); ++it )
+        stream << ( variables.cbegin() == it ? "" : "," ) << "'" << *it << "'";
+      stream << ")";
+    }
 
-      if( 0 < identifier.length() )
+    // the value set is complete once every requested variable has a value
+    ValueListParser parser( list );
+    this->Read( stream.str(), parser, progress, this->CacheLifetime, [&list, &variables]()
+    {
+      if( list.empty() ) return false;
+      for( auto it = variables.cbegin(); it != variables.cend(); ++it )
       {
-        value = root["valueSets"][i]["values"][0].get( "value", "" ).asString();
-        map[identifier] = value;
+        auto found = list.find( *it );
+        if( list.end() == found || found->second.empty() ) return false;
       }
-    }
+      return true;
+    } );
 
-    return map;
+    // make sure every requested variable is included, even if Opal has no value for it
+    for( auto it = variables.cbegin(); it != variables.cend(); ++it ) list[*it];
+
+    return list;
   }
 
   //-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-
@@ -300,7 +1594,10 @@ namespace Alder
     std::stringstream stream;
     stream << "/datasource/" << dataSource << "/table/" << table
            << "/valueSet/" << identifier << "/variable/" << variable;
-    return this->Read( stream.str(), "", false ).get( "value", "" ).asString();
+    return this->Read( stream.str(), "", false, this->CacheLifetime, []( const Json::Value &root )
+    {
+      return !root.get( "value", "" ).asString().empty();
+    } ).get( "value", "" ).asString();
   }
 
   //-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-
@@ -314,7 +1611,8 @@ namespace Alder
            << "/valueSet/" << identifier << "/variable/" << variable;
 
     // loop through the values array and get all the values
-    Json::Value values = this->Read( stream.str() ).get( "values", "" );
+    Json::Value values = this->Read( stream.str(), "", true, this->CacheLifetime,
+      []( const Json::Value &root ) { return 0 < root.get( "values", "" ).size(); } ).get( "values", "" );
 
     for( int i = 0; i < values.size(); ++i )
       retValues.push_back( values[i].get( "value", "" ).asString() );
@@ -340,4 +1638,213 @@ namespace Alder
 
     this->Read( stream.str(), fileName );
   }
+
+  //-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-
+  void OpalService::SaveFiles(
+    const std::vector< FileTransfer* > &transfers, TransferListener *listener ) const
+  {
+    if( transfers.empty() ) return;
+
+    Application *app = Application::GetInstance();
+    int size = transfers.size();
+    int maximum = 0 < this->MaximumTransfers ? this->MaximumTransfers : 1;
+
+    CURLM *multi = curl_multi_init();
+    if( !multi ) 
+      throw std::runtime_error( "Unable to create cURL connection to Opal" );
+#ifdef CURLPIPE_MULTIPLEX
+    // allow transfers to share a single HTTP/2 connection
+    curl_multi_setopt( multi, CURLMOPT_PIPELINING, CURLPIPE_MULTIPLEX );
+#endif
+
+    // the progress of all transfers is combined, and since we are downloading file type data we
+    // don't check whether the responses have a substantial size
+    ProgressState state( false, size );
+    std::vector< TransferProgress > progress( size );
+    std::vector< FileWriter* > writers( size, NULL );
+    std::vector< curl_slist* > headers( size, NULL );
+    std::vector< bool > restarted( size, false );
+    std::deque< int > queue;
+    std::map< CURL*, int > active;
+    int running = 0;
+
+    for( int index = 0; index < size; ++index )
+    {
+      transfers[index]->Success = false;
+      transfers[index]->Partial = false;
+      transfers[index]->Hash = "";
+      transfers[index]->Error = "";
+      queue.push_back( index );
+    }
+
+    // we are using the local progress bar for curl progress, not the global one
+    bool global = false;
+
+    // start the local progress meter
+    ProgressChannel::GetInstance()->Start( global );
+
+    while( !app->GetAbortFlag() && ( !queue.empty() || !active.empty() ) )
+    {
+      // start new transfers until we have reached the maximum allowed
+      while( !queue.empty() && active.size() < maximum )
+      {
+        int index = queue.front();
+        queue.pop_front();
+        FileTransfer *transfer = transfers[index];
+
+        std::stringstream stream;
+        stream << "/datasource/" << transfer->DataSource << "/table/" << transfer->Table
+               << "/valueSet/" << transfer->Identifier << "/variable/" << transfer->Variable << "/value";
+        if( 0 <= transfer->Position ) stream << "?pos=" << transfer->Position;
+
+        // the writer continues where an earlier incomplete transfer of the file left off
+        FileWriter *writer = new FileWriter( transfer->FileName, transfer->Decompress );
+        if( !writer->Open() )
+        {
+          transfer->Error = "Unable to open file \"" + transfer->FileName + "\" for writing.";
+          delete writer;
+          if( listener ) listener->TransferDone( transfer );
+          continue;
+        }
+
+        // only ask for the rest of the data if it hasn't changed since the transfer was started
+        headers[index] = this->CreateHeaders();
+        if( 0 < writer->GetResumeOffset() && !writer->GetValidator().empty() )
+        {
+          std::string ifRange = "If-Range: " + writer->GetValidator();
+          headers[index] = curl_slist_append( headers[index], ifRange.c_str() );
+        }
+
+        CURL *curl;
+        try
+        {
+          curl = this->CreateHandle( stream.str(), headers[index] );
+        }
+        catch( std::runtime_error &e )
+        {
+          transfer->Error = e.what();
+          transfer->Partial = writer->Suspend();
+          delete writer;
+          curl_slist_free_all( headers[index] );
+          headers[index] = NULL;
+          if( listener ) listener->TransferDone( transfer );
+          continue;
+        }
+
+        progress[index].State = &state;
+        progress[index].Index = index;
+        writers[index] = writer;
+        writer->SetCurl( curl );
+        curl_easy_setopt( curl, CURLOPT_RESUME_FROM_LARGE, writer->GetResumeOffset() );
+        curl_easy_setopt( curl, CURLOPT_WRITEFUNCTION, OpalService::curlWriteCallback );
+        curl_easy_setopt( curl, CURLOPT_WRITEDATA, writer );
+        curl_easy_setopt( curl, CURLOPT_HEADERFUNCTION, OpalService::curlHeaderCallback );
+        curl_easy_setopt( curl, CURLOPT_HEADERDATA, writer );
+        curl_easy_setopt( curl, CURLOPT_NOPROGRESS, 0L );
+        curl_easy_setopt( curl, CURLOPT_PROGRESSFUNCTION, OpalService::curlProgressCallback );
+        curl_easy_setopt( curl, CURLOPT_PROGRESSDATA, &progress[index] );
+        curl_multi_add_handle( multi, curl );
+        active[curl] = index;
+      }
+
+      curl_multi_perform( multi, &running );
+
+      // collect any transfers which have completed
+      CURLMsg *message;
+      int remaining;
+      while( NULL != ( message = curl_multi_info_read( multi, &remaining ) ) )
+      {
+        if( CURLMSG_DONE != message->msg ) continue;
+
+        CURL *curl = message->easy_handle;
+        CURLcode res = message->data.result;
+        int index = active[curl];
+        FileTransfer *transfer = transfers[index];
+        FileWriter *writer = writers[index];
+
+        // the file's size and (gzip) checksum are verified before it is accepted
+        std::string error;
+        bool finished = CURLE_OK == res && writer->Finish( error );
+        double received = 0.0;
+        curl_easy_getinfo( curl, CURLINFO_SIZE_DOWNLOAD, &received );
+        this->RecordTransfer( curl, FileEndpoint, ( finished || CURLE_OK != res ) ? res : CURLE_WRITE_ERROR );
+        curl_multi_remove_handle( multi, curl );
+        this->ReleaseHandle( curl );
+        active.erase( curl );
+        curl_slist_free_all( headers[index] );
+        headers[index] = NULL;
+        bool retry = false;
+
+        if( finished )
+        {
+          transfer->Success = true;
+          transfer->Hash = writer->GetDigest();
+          this->FilesReceived++;
+          this->BytesReceived += received;
+        }
+        else if( CURLE_OK == res )
+        {
+          transfer->Error = error;
+          Utilities::log( transfer->Error );
+        }
+        else if( ( writer->IsRangeRejected() || CURLE_RANGE_ERROR == res ) && !restarted[index] )
+        {
+          // Opal can't continue the incomplete transfer, so start again from the beginning
+          Utilities::log( "Unable to resume transfer of \"" + transfer->FileName + "\", restarting it" );
+          writer->Discard();
+          restarted[index] = true;
+          queue.push_back( index );
+          retry = true;
+        }
+        else if( writer->IsCorrupt() )
+        {
+          writer->Discard();
+          transfer->Error = "Corrupt gzip data received from Opal";
+          Utilities::log( transfer->Error );
+        }
+        else
+        {
+          // keep what was received so that the transfer can be resumed next time
+          transfer->Partial = writer->Suspend();
+          std::stringstream stream;
+          stream << "Received cURL error " << res << " when attempting to contact Opal: ";
+          stream << curl_easy_strerror( res );
+          transfer->Error = stream.str();
+          Utilities::log( transfer->Error );
+        }
+
+        delete writer;
+        writers[index] = NULL;
+        if( listener && !retry ) listener->TransferDone( transfer );
+      }
+
+      // wait for activity on any of the transfers
+      if( !active.empty() ) curl_multi_wait( multi, NULL, 0, 100, NULL );
+    }
+
+    // if the user aborted then suspend any transfers which are still in progress
+    for( auto it = active.cbegin(); it != active.cend(); ++it )
+    {
+      transfers[it->second]->Partial = writers[it->second]->Suspend();
+      transfers[it->second]->Error = "Transfer aborted by user";
+      delete writers[it->second];
+      curl_multi_remove_handle( multi, it->first );
+      this->ReleaseHandle( it->first );
+      curl_slist_free_all( headers[it->second] );
+      if( listener ) listener->TransferDone( transfers[it->second] );
+    }
+    for( auto it = queue.cbegin(); it != queue.cend(); ++it )
+    {
+      // transfers which weren't started may still have data from an earlier attempt
+      transfers[*it]->Partial =
+        Utilities::fileExists( FileWriter::GetJournalName( transfers[*it]->FileName ) );
+      transfers[*it]->Error = "Transfer aborted by user";
+      if( listener ) listener->TransferDone( transfers[*it] );
+    }
+
+    // end the local progress meter
+    ProgressChannel::GetInstance()->End( global );
+
+    curl_multi_cleanup( multi );
+  }
 }
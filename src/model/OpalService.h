@@ -21,6 +21,15 @@
  * This class provides a programming interface to Opal's RESTful interface by using the
  * curl library.  A description of Opal can be found
  * <a href="http://www.obiba.org/?q=node/63">here</a>.
+ *
+ * When a cache directory is set, metadata responses are kept on disk.  A participant's value
+ * set (GetRow(), GetValueSet(), GetValue() and GetValues()) is used without contacting Opal
+ * until it is older than the cache lifetime, but only once it is complete (every value asked for
+ * is present): an interview which is still being exported may have more data to come, and the
+ * image metadata decides which files are downloaded.  Incomplete value sets and lists covering
+ * all participants (GetIdentifiers(),
+ * GetRows() and GetColumn()) change whenever interviews are added, so they are always
+ * revalidated, which only saves the transfer when Opal sends an ETag or Last-Modified header.
  */
 
 #ifndef __OpalService_h
@@ -31,6 +40,9 @@
 #include "vtkSmartPointer.h"
 #include "vtkAlderMySQLQuery.h"
 
+#include <ctime>
+#include <curl/curl.h>
+#include <functional>
 #include <iostream>
 #include <json/reader.h>
 #include <map>
@@ -45,6 +57,7 @@ class vtkAlderMySQLOpalService;
 
 namespace Alder
 {
+  class JsonStreamParser;
   class User;
   class OpalService : public ModelObject
   {
@@ -52,6 +65,78 @@ namespace Alder
     static OpalService *New();
     vtkTypeMacro( OpalService, ModelObject );
 
+    /**
+     * A file to be downloaded by SaveFiles().  Once the transfer is complete Success is set to
+     * whether the file was received and Hash to the SHA-256 digest of the file (as written), or
+     * if not, Error describes why and Partial whether the incomplete file was kept so that the
+     * transfer can be resumed by a later call to SaveFiles().
+     */
+    struct FileTransfer
+    {
+      FileTransfer() : Position( -1 ), Decompress( false ), Success( false ), Partial( false ) {}
+      std::string FileName;
+      std::string DataSource;
+      std::string Table;
+      std::string Identifier;
+      std::string Variable;
+      int Position;
+      bool Decompress; // whether gzip data is decompressed as it is written to the file
+      bool Success;
+      bool Partial;
+      std::string Hash;
+      std::string Error;
+    };
+
+    /**
+     * Interface of an object which is told as each of the transfers performed by SaveFiles()
+     * is done with, whether it succeeded, failed or was aborted
+     */
+    class TransferListener
+    {
+    public:
+      virtual ~TransferListener() {}
+      virtual void TransferDone( FileTransfer *transfer ) = 0;
+    };
+
+    /**
+     * The kinds of request made to Opal which transfer statistics are kept for
+     */
+    enum Endpoint
+    {
+      IdentifiersEndpoint = 0,
+      RowsEndpoint,
+      ValuesEndpoint,
+      FileEndpoint,
+      EndpointCount
+    };
+
+    /**
+     * Totals of the requests of one kind made since the service was created (or its statistics
+     * were reset).  Times are in seconds, split into the phases of a request: resolving the host
+     * name, connecting, the TLS handshake, waiting for the first byte of the response (Opal's
+     * latency) and receiving the rest of it (bandwidth).  Times are only added for successful
+     * requests.  Responses served from the cache are counted as cache hits, and also as requests
+     * if Opal had to confirm that the cached copy was still current.
+     */
+    struct TransferStatistics
+    {
+      TransferStatistics()
+        : Requests( 0 ), Failures( 0 ), CacheHits( 0 ), NameLookupTime( 0.0 ), ConnectTime( 0.0 ),
+          HandshakeTime( 0.0 ), WaitTime( 0.0 ), ReceiveTime( 0.0 ), TotalTime( 0.0 ),
+          SlowestTime( 0.0 ), Bytes( 0.0 ) {}
+      int Requests;
+      int Failures;
+      int CacheHits;
+      double NameLookupTime;
+      double ConnectTime;
+      double HandshakeTime;
+      double WaitTime;
+      double ReceiveTime;
+      double TotalTime;
+      double SlowestTime;
+      double Bytes;
+    };
+
     /**
      * Defines connection parameters to use when communicating with the Opal server
      */
@@ -67,20 +152,64 @@ namespace Alder
 
     vtkGetMacro( Timeout, int );
     vtkSetMacro( Timeout, int );
-  
+
     /**
-     * Call before invoking the application StartEvent for progress monitoring.
-     * If check is true, then the first curl progress callback will set 
-     * whether the fine level (local) progress should be a regular progress
-     * meter or a busy meter, based on whether the expected size of the data 
-     * to be downloaded is non-zero.  For file type data, this should be called
-     * with false, since we expect (image) files to have significant size.
+     * The maximum number of file transfers which SaveFiles() will have in progress at once
      */
-    static void SetCurlProgressChecking( const bool check = true )
-    {
-      OpalService::configureEventSent = false;
-      OpalService::curlProgressChecking = check;
-    };
+    vtkGetMacro( MaximumTransfers, int );
+    vtkSetMacro( MaximumTransfers, int );
+
+    /**
+     * The directory responses are cached in (an empty string disables the cache)
+     */
+    std::string GetCacheDirectory() const { return this->CacheDirectory; }
+    void SetCacheDirectory( const std::string directory ) { this->CacheDirectory = directory; }
+
+    /**
+     * The number of seconds a cached value set is used for before it is revalidated with Opal
+     */
+    vtkGetMacro( CacheLifetime, int );
+    vtkSetMacro( CacheLifetime, int );
+
+    /**
+     * The number of files and bytes (as sent by Opal) successfully received by SaveFiles()
+     * since the service was created
+     */
+    vtkGetMacro( FilesReceived, int );
+    vtkGetMacro( BytesReceived, double );
+
+    /**
+     * Returns the transfer statistics of one kind of request
+     */
+    TransferStatistics GetStatistics( const Endpoint endpoint ) const;
+
+    /**
+     * Adds the transfer statistics of requests made by another service (eg: that of another
+     * thread) to those of one kind of request
+     */
+    void AddStatistics( const Endpoint endpoint, const TransferStatistics &statistics );
+
+    /**
+     * Clears the transfer statistics of all kinds of request
+     */
+    void ResetStatistics();
+
+    /**
+     * Returns a description of the transfer statistics, one line per kind of request made
+     */
+    std::string GetStatisticsSummary() const;
+
+    /**
+     * Returns the name of a kind of request (as used by the statistics summary)
+     */
+    static std::string GetEndpointName( const Endpoint endpoint );
+
+    /**
+     * How often (in seconds) the statistics summary is written to the log, as long as requests
+     * are being made (0 to never log it)
+     */
+    vtkGetMacro( StatisticsInterval, int );
+    vtkSetMacro( StatisticsInterval, int );
 
     /**
      * Returns a list of all identifiers in a particular data source and table
@@ -121,6 +250,20 @@ namespace Alder
       const std::string dataSource, const std::string table, const std::string variable,
       const int offset = 0, const int limit = 100 );
 
+    /**
+     * Returns several variables for a given identifier using a single request.  Every
+     * variable is returned as a list so that both regular and repeatable variables are
+     * supported (a missing value results in an empty list).
+     * @param dataSource string
+     * @param table string
+     * @param identifier string
+     * @param variables vector The names of the variables to return (all if empty)
+     * @param progress bool
+     */
+    std::map< std::string, std::vector< std::string > > GetValueSet(
+      const std::string dataSource, const std::string table, const std::string identifier,
+      const std::vector< std::string > &variables, const bool progress = false ) const;
+
     /**
      * Returns a particular variable for a given identifier
      * @param dataSource string
@@ -160,9 +303,23 @@ namespace Alder
       const std::string variable,
       const int position = -1 ) const;
 
+    /**
+     * Downloads a list of files concurrently, keeping at most MaximumTransfers in progress at
+     * once.  The local progress reported is that of all transfers combined.  A failed transfer
+     * does not stop the others, instead its Success and Error members are set accordingly.
+     * The data received by a transfer which is interrupted (by the user or a network error) is
+     * kept along with a journal (a hidden file next to it) and the next transfer of the same
+     * file asks Opal for the rest of the data only.
+     * @param transfers vector The files to download
+     * @param listener TransferListener Told as each transfer is done with (optional)
+     * @throws runtime_error
+     */
+    void SaveFiles(
+      const std::vector< FileTransfer* > &transfers, TransferListener *listener = NULL ) const;
+
   protected:
     OpalService();
-    ~OpalService() {}
+    ~OpalService();
 
     /**
      * Returns the response provided by Opal for a given service path, or if fileName is not
@@ -170,10 +327,79 @@ namespace Alder
      * @param servicePath string
      * @param fileName string
      * @param doProgress bool
+     * @param lifetime int How long (in seconds) a cached copy of the response is used for without
+     * revalidating it, zero to always revalidate it or negative to not cache it (files never are)
+     * @param complete function Whether a response has all of its data, an incomplete response is
+     * always revalidated regardless of its lifetime (all responses are complete if not provided)
      * @throws runtime_error
      */
     virtual Json::Value Read(
-      const std::string servicePath, const std::string fileName = "", const bool progress = true ) const;
+      const std::string servicePath, const std::string fileName = "",
+      const bool progress = true, const int lifetime = -1,
+      const std::function< bool( const Json::Value& ) > &complete = nullptr ) const;
+
+    /**
+     * Passes the response provided by Opal for a given service path to a streaming json parser
+     * piece by piece as it is received, so that the whole response is never held in memory.
+     * @param servicePath string
+     * @param parser JsonStreamParser
+     * @param progress bool
+     * @param lifetime int As above
+     * @param complete function Whether what the parser was given has all of its data, as above
+     * @throws runtime_error
+     */
+    virtual void Read(
+      const std::string servicePath, JsonStreamParser &parser,
+      const bool progress = true, const int lifetime = -1,
+      const std::function< bool() > &complete = nullptr ) const;
+
+    /**
+     * Performs a request using a handle set up by CreateHandle(), reporting its progress using
+     * the local progress meter and recording its transfer statistics, then releases the handle
+     * and frees the headers
+     * @param endpoint Endpoint The kind of request the statistics are recorded as
+     * @param checking bool Whether to check the size of the response before showing progress
+     */
+    CURLcode Perform(
+      CURL *curl, curl_slist *headers, const Endpoint endpoint,
+      const bool checking, const bool progress ) const;
+
+    /**
+     * Adds the timing and size of a completed request to the statistics of its kind of request,
+     * writing the statistics summary to the log if it is time to
+     */
+    void RecordTransfer( CURL *curl, const Endpoint endpoint, const CURLcode res ) const;
+
+    /**
+     * Returns which kind of request a service path is
+     */
+    static Endpoint GetEndpoint( const std::string servicePath );
+
+    /**
+     * Throws an exception describing a request's curl error, unless the user aborted it
+     * @throws runtime_error
+     */
+    void CheckResult( const CURLcode res ) const;
+
+    /**
+     * Returns a curl handle set up to request the given service path.  Handles are taken from a
+     * pool so that connections (and TLS sessions) to the server are reused between requests.
+     * Once the request is complete the handle must be given back using ReleaseHandle().
+     * @param servicePath string
+     * @param headers curl_slist The request headers, as returned by CreateHeaders()
+     * @throws runtime_error
+     */
+    CURL* CreateHandle( const std::string servicePath, curl_slist *headers ) const;
+
+    /**
+     * Returns a handle created by CreateHandle() to the pool
+     */
+    void ReleaseHandle( CURL *curl ) const;
+
+    /**
+     * Returns the request headers needed by all requests made to Opal (the caller must free them)
+     */
+    curl_slist* CreateHeaders() const;
 
     std::map< std::string, std::map< std::string, std::map< std::string, std::string > > > Columns;
     std::string Username;
@@ -181,14 +407,78 @@ namespace Alder
     std::string Host;
     int Port;
     int Timeout;
+    int MaximumTransfers;
+    std::string CacheDirectory;
+    int CacheLifetime;
+    mutable int FilesReceived;
+    mutable double BytesReceived;
+    mutable TransferStatistics Statistics[EndpointCount];
+    int StatisticsInterval;
+    mutable time_t LastSummaryTime;
+
+    // connections, TLS sessions and DNS lookups are shared by all handles, which is why
+    // a service must only ever be used by one thread
+    CURLSH *Share;
+    mutable std::vector< CURL* > HandlePool;
 
   private:
     OpalService( const OpalService& ); /** Not implemented. */
     void operator=( const OpalService& ); /** Not implemented. */
 
-    static int curlProgressCallback( const void* const , const double, const double, const double, const double );
-    static bool configureEventSent;
-    static bool curlProgressChecking;
+    /**
+     * Progress is tracked separately for every request (or batch of file transfers) and posted
+     * to the progress channel.  The first curl progress callback configures the local progress
+     * meter as a regular or busy meter: when checking, based on whether the expected size of the
+     * data is non-zero, and when not checking (file type data, which we expect to have significant
+     * size) always as a regular meter.
+     */
+    struct ProgressState
+    {
+      ProgressState( const bool checking, const int size )
+        : Checking( checking ), Configured( false ),
+          DownTotal( size, 0.0 ), DownNow( size, 0.0 ) {}
+      bool Checking;
+      bool Configured;
+      std::vector< double > DownTotal;
+      std::vector< double > DownNow;
+    };
+
+    /**
+     * Identifies which of a progress state's transfers a curl progress callback belongs to
+     */
+    struct TransferProgress
+    {
+      ProgressState *State;
+      int Index;
+    };
+
+    static int curlProgressCallback( void*, const double, const double, const double, const double );
+
+    /**
+     * Writes a file transfer's data to disk, decompressing it on the fly if it is gzipped, and
+     * keeps the journal needed to resume the transfer (defined in the .cxx file)
+     */
+    class FileWriter;
+
+    static size_t curlWriteCallback( char*, size_t, size_t, void* );
+    static size_t curlHeaderCallback( char*, size_t, size_t, void* );
+
+    /**
+     * Passes a json response on (to a streaming parser or a string) while storing it in the
+     * cache, or passes on the cached copy instead (defined in the .cxx file)
+     */
+    class CachedResponse;
+
+    /**
+     * Gets a response, from the cache when it is fresh or else from Opal (asking for it only
+     * if it has changed since it was cached).  The caller commits the response to the cache
+     * once it has been parsed.
+     * @throws runtime_error
+     */
+    CURLcode Fetch( const std::string servicePath, CachedResponse &response, const bool progress ) const;
+
+    static size_t curlResponseCallback( char*, size_t, size_t, void* );
+    static size_t curlResponseHeaderCallback( char*, size_t, size_t, void* );
   };
 }
 
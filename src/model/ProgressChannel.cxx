@@ -0,0 +1,143 @@
+/*=========================================================================
+
+  Program:  Alder (CLSA Medical Image Quality Assessment Tool)
+  Module:   ProgressChannel.cxx
+  Language: C++
+
+  Author: Patrick Emond <emondpd AT mcmaster DOT ca>
+  Author: Dean Inglis <inglisd AT mcmaster DOT ca>
+
+=========================================================================*/
+#include "ProgressChannel.h"
+
+#include <chrono>
+
+namespace Alder
+{
+  static const uint64_t PROGRESS_MASK = 0xffff;
+  static const uint64_t BUSY_BIT = static_cast< uint64_t >( 1 ) << 16;
+  static const uint64_t ACTIVE_BIT = static_cast< uint64_t >( 1 ) << 17;
+  static const uint64_t SEQUENCE_UNIT = static_cast< uint64_t >( 1 ) << 32;
+  static const double PROGRESS_SCALE = 10000.0;
+
+  // the job which updates posted from each thread are made to
+  static thread_local std::shared_ptr< ProgressChannel::Job > CurrentJob;
+
+  //-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-
+  ProgressChannel::Job::Job()
+  {
+    this->Tasks[0] = 0;
+    this->Tasks[1] = 0;
+  }
+
+  //-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-
+  ProgressChannel* ProgressChannel::GetInstance()
+  {
+    static ProgressChannel channel;
+    return &channel;
+  }
+
+  //-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-
+  ProgressChannel::ProgressChannel()
+    : CurrentConsumer( NULL ), ConsumerThread( std::thread::id() ), LastPump( 0 ), Pumping( false )
+  {
+  }
+
+  //-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-
+  void ProgressChannel::SetJob( const std::shared_ptr< Job > &job )
+  {
+    CurrentJob = job;
+  }
+
+  //-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-
+  void ProgressChannel::Start( const bool global )
+  {
+    this->Post( global, ACTIVE_BIT | PROGRESS_MASK, ACTIVE_BIT );
+  }
+
+  //-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-
+  void ProgressChannel::Configure( const bool global, const bool busy )
+  {
+    this->Post( global, BUSY_BIT, busy ? BUSY_BIT : 0 );
+  }
+
+  //-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-
+  void ProgressChannel::Progress( const bool global, const double progress )
+  {
+    double clamped = 0.0 > progress ? 0.0 : 1.0 < progress ? 1.0 : progress;
+    this->Post( global, PROGRESS_MASK, static_cast< uint64_t >( clamped * PROGRESS_SCALE + 0.5 ) );
+  }
+
+  //-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-
+  void ProgressChannel::End( const bool global )
+  {
+    this->Post( global, ACTIVE_BIT | PROGRESS_MASK, static_cast< uint64_t >( PROGRESS_SCALE ) );
+  }
+
+  //-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-
+  bool ProgressChannel::Read(
+    const Job &job, const bool global, State &state, unsigned int &sequence ) const
+  {
+    uint64_t word = job.Tasks[global ? 0 : 1].load( std::memory_order_acquire );
+    state.Active = 0 != ( word & ACTIVE_BIT );
+    state.Busy = 0 != ( word & BUSY_BIT );
+    state.Progress = static_cast< double >( word & PROGRESS_MASK ) / PROGRESS_SCALE;
+
+    unsigned int latest = static_cast< unsigned int >( word >> 32 );
+    bool changed = latest != sequence;
+    sequence = latest;
+    return changed;
+  }
+
+  //-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-
+  void ProgressChannel::SetConsumer( Consumer *consumer )
+  {
+    std::lock_guard< std::mutex > lock( this->ConsumerMutex );
+    this->ConsumerThread = NULL == consumer ? std::thread::id() : std::this_thread::get_id();
+    this->CurrentConsumer = consumer;
+  }
+
+  //-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-
+  void ProgressChannel::RemoveConsumer( Consumer *consumer )
+  {
+    std::lock_guard< std::mutex > lock( this->ConsumerMutex );
+    if( consumer != this->CurrentConsumer.load() ) return;
+    this->ConsumerThread = std::thread::id();
+    this->CurrentConsumer = NULL;
+  }
+
+  //-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-
+  void ProgressChannel::Post( const bool global, const uint64_t mask, const uint64_t bits )
+  {
+    // nobody is watching a thread which isn't bound to a job
+    Job *job = CurrentJob.get();
+    if( NULL == job ) return;
+
+    // the sequence number wraps around harmlessly
+    std::atomic< uint64_t > &task = job->Tasks[global ? 0 : 1];
+    uint64_t word = task.load( std::memory_order_relaxed ), replacement;
+    do replacement = ( ( word & ~mask ) | bits ) + SEQUENCE_UNIT;
+    while( !task.compare_exchange_weak(
+      word, replacement, std::memory_order_release, std::memory_order_relaxed ) );
+
+    this->PumpIfDue();
+  }
+
+  //-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-
+  void ProgressChannel::PumpIfDue()
+  {
+    // only the consumer's own thread pumps it, and never from within a pump
+    if( std::this_thread::get_id() != this->ConsumerThread.load() || this->Pumping ) return;
+    Consumer *consumer = this->CurrentConsumer;
+    if( NULL == consumer ) return;
+
+    int64_t now = std::chrono::duration_cast< std::chrono::milliseconds >(
+      std::chrono::steady_clock::now().time_since_epoch() ).count();
+    if( now - this->LastPump < UpdateInterval ) return;
+
+    this->LastPump = now;
+    this->Pumping = true;
+    consumer->Pump();
+    this->Pumping = false;
+  }
+}
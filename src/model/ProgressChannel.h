@@ -0,0 +1,155 @@
+/*=========================================================================
+
+  Program:  Alder (CLSA Medical Image Quality Assessment Tool)
+  Module:   ProgressChannel.h
+  Language: C++
+
+  Author: Patrick Emond <emondpd AT mcmaster DOT ca>
+  Author: Dean Inglis <inglisd AT mcmaster DOT ca>
+
+=========================================================================*/
+
+/**
+ * @class ProgressChannel
+ * @namespace Alder
+ *
+ * @author Patrick Emond <emondpd AT mcmaster DOT ca>
+ * @author Dean Inglis <inglisd AT mcmaster DOT ca>
+ *
+ * @brief Thread-safe channel which carries progress from the model to the user interface
+ *
+ * There is one channel per process (unlike the Application, which every thread has its own
+ * instance of) so that progress can be reported from any thread.  Progress is reported per job,
+ * which is created by the consumer and bound to the thread doing its work, so that jobs running
+ * at the same time (or a cancelled job winding down next to its replacement) don't overwrite
+ * each other.  Updates posted from a thread which isn't bound to a job are discarded.
+ *
+ * Each job has two tasks, the global task (an operation as a whole) and the local task (the
+ * request currently being made to Opal), and only keeps the latest state of each: producers
+ * overwrite it without locking and the consumer reads it at a fixed rate, so any number of
+ * updates made between two reads are coalesced into one.
+ *
+ * A consumer which is blocked by work done on its own thread can't read the channel on its
+ * timer, so it may also register itself to be pumped.  Updates posted from the consumer's thread
+ * then pump it, but no more than once per UpdateInterval.
+ */
+
+#ifndef __ProgressChannel_h
+#define __ProgressChannel_h
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+/**
+ * @addtogroup Alder
+ * @{
+ */
+
+namespace Alder
+{
+  class ProgressChannel
+  {
+  public:
+    /**
+     * The number of milliseconds between reads of the channel (30 per second)
+     */
+    static const int UpdateInterval = 33;
+
+    /**
+     * The state of a task as last posted
+     */
+    struct State
+    {
+      bool Active; // whether the task has started and not yet ended
+      bool Busy; // whether the task's progress is unknown
+      double Progress; // between 0 and 1
+    };
+
+    /**
+     * Interface of a consumer which needs to be pumped while its own thread is busy
+     */
+    class Consumer
+    {
+    public:
+      virtual ~Consumer() {}
+      virtual void Pump() = 0;
+    };
+
+    /**
+     * The tasks of a single job, shared by its consumer and the thread doing its work
+     */
+    class Job
+    {
+    public:
+      Job();
+
+    private:
+      friend class ProgressChannel;
+      Job( const Job& ); /** Not implemented. */
+      void operator=( const Job& ); /** Not implemented. */
+
+      std::atomic< uint64_t > Tasks[2];
+    };
+
+    /**
+     * Returns the process' channel
+     */
+    static ProgressChannel* GetInstance();
+
+    /**
+     * Binds the calling thread to a job (or NULL), all updates posted from the thread are then
+     * made to that job's tasks
+     */
+    void SetJob( const std::shared_ptr< Job > &job );
+
+    /**
+     * Producer methods, which may be called from any thread
+     * @param global bool Whether the update is for the global (or local) task of the calling
+     * thread's job
+     */
+    void Start( const bool global );
+    void Configure( const bool global, const bool busy );
+    void Progress( const bool global, const double progress );
+    void End( const bool global );
+
+    /**
+     * Reads the state of one of a job's tasks, returning whether it has changed since the given
+     * sequence number (which is updated to the latest)
+     */
+    bool Read( const Job &job, const bool global, State &state, unsigned int &sequence ) const;
+
+    /**
+     * Sets the consumer to pump when updates are posted from the calling thread (or NULL)
+     */
+    void SetConsumer( Consumer *consumer );
+
+    /**
+     * Removes the consumer, unless another one has been set since (in which case it is kept)
+     */
+    void RemoveConsumer( Consumer *consumer );
+
+  private:
+    ProgressChannel();
+    ProgressChannel( const ProgressChannel& ); /** Not implemented. */
+    void operator=( const ProgressChannel& ); /** Not implemented. */
+
+    // the state of a task is packed into a single word so that it can be replaced atomically:
+    // the progress (in hundredths of a percent) in bits 0-15, busy in bit 16, active in bit 17
+    // and a sequence number, incremented by every update, in bits 32-63
+    void Post( const bool global, const uint64_t mask, const uint64_t bits );
+    void PumpIfDue();
+
+    std::mutex ConsumerMutex;
+    std::atomic< Consumer* > CurrentConsumer;
+    std::atomic< std::thread::id > ConsumerThread;
+    std::atomic< int64_t > LastPump;
+    std::atomic< bool > Pumping;
+  };
+}
+
+/** @} end of doxygen group */
+
+#endif
@@ -0,0 +1,85 @@
+/*=========================================================================
+
+  Module:    vtkCacheDirectory.cxx
+  Program:   Alder (CLSA Medical Image Quality Assessment Tool)
+  Language:  C++
+  Author:    Patrick Emond <emondpd AT mcmaster DOT ca>
+  Author:    Dean Inglis <inglisd AT mcmaster DOT ca>
+
+=========================================================================*/
+#include "vtkCacheDirectory.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <dirent.h>
+#include <sstream>
+#include <unistd.h>
+
+//-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-
+vtkCacheDirectory::vtkCacheDirectory( const std::string& extension )
+  : Extension( extension )
+{
+}
+
+//-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-
+void vtkCacheDirectory::SetPath( const std::string& path )
+{
+  std::lock_guard< std::mutex > lock( this->Mutex );
+  this->Path = path;
+}
+
+//-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-
+std::string vtkCacheDirectory::GetPath() const
+{
+  std::lock_guard< std::mutex > lock( this->Mutex );
+  return this->Path;
+}
+
+//-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-
+std::string vtkCacheDirectory::GetFileName( const std::string& fileName ) const
+{
+  std::lock_guard< std::mutex > lock( this->Mutex );
+  if( this->Path.empty() ) return "";
+  std::stringstream stream;
+  stream << this->Path << "/" << std::hex << std::hash< std::string >()( fileName ) << this->Extension;
+  return stream.str();
+}
+
+//-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-
+std::vector< std::string > vtkCacheDirectory::GetFileNames() const
+{
+  std::vector< std::string > fileNames;
+  std::string path = this->GetPath();
+  if( path.empty() ) return fileNames;
+
+  DIR *directory = opendir( path.c_str() );
+  if( NULL == directory ) return fileNames;
+
+  // temporary files end with mkstemp's suffix rather than the extension
+  const size_t length = this->Extension.length();
+  for( struct dirent *entry = readdir( directory ); NULL != entry; entry = readdir( directory ) )
+  {
+    std::string name = entry->d_name;
+    if( length < name.length() && 0 == name.compare( name.length() - length, length, this->Extension ) )
+      fileNames.push_back( path + "/" + name );
+  }
+  closedir( directory );
+  return fileNames;
+}
+
+//-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-
+bool vtkCacheDirectory::Write( const std::string& cacheFileName,
+  const std::function< bool( int, const std::string& ) >& write )
+{
+  if( cacheFileName.empty() ) return false;
+
+  std::string temporary = cacheFileName + ".XXXXXX";
+  int descriptor = mkstemp( &temporary[0] );
+  if( -1 == descriptor ) return false;
+
+  bool success = write( descriptor, temporary );
+  if( 0 != close( descriptor ) ) success = false;
+  if( success ) success = 0 == rename( temporary.c_str(), cacheFileName.c_str() );
+  if( !success ) remove( temporary.c_str() );
+  return success;
+}
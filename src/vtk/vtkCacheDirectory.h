@@ -0,0 +1,82 @@
+/*=========================================================================
+
+  Module:    vtkCacheDirectory.h
+  Program:   Alder (CLSA Medical Image Quality Assessment Tool)
+  Language:  C++
+  Author:    Patrick Emond <emondpd AT mcmaster DOT ca>
+  Author:    Dean Inglis <inglisd AT mcmaster DOT ca>
+
+=========================================================================*/
+
+/**
+ * @class vtkCacheDirectory
+ *
+ * @author Patrick Emond <emondpd AT mcmaster DOT ca>
+ * @author Dean Inglis <inglisd AT mcmaster DOT ca>
+ *
+ * @brief A directory of files made from other files, used by the on-disk caches.
+ *
+ * The cache file of a file is named by the hash of the file's name, so
+ * finding it costs nothing more than building its name.  Cache files are
+ * written to a temporary file first which is renamed once it is complete,
+ * so a partial cache file is never read.  The cache is disabled until a
+ * path is set.
+ *
+ * @see vtkDecodedImageCache, vtkImageThumbnailCache
+ */
+#ifndef __vtkCacheDirectory_h
+#define __vtkCacheDirectory_h
+
+#include <functional>
+#include <mutex>
+#include <string>
+#include <vector>
+
+class vtkCacheDirectory
+{
+public:
+  /**
+   * Creates a cache whose files have the given extension (eg: ".png").
+   */
+  vtkCacheDirectory( const std::string& extension );
+
+  //@{
+  /**
+   * Set/Get the directory the cache is kept in (an empty path, the default,
+   * disables the cache).
+   */
+  void SetPath( const std::string& path );
+  std::string GetPath() const;
+  //@}
+
+  /**
+   * Returns the name of the cache file of a file, or an empty string if the
+   * cache is disabled.
+   */
+  std::string GetFileName( const std::string& fileName ) const;
+
+  /**
+   * Returns the names of all of the cache's files (without the temporary
+   * files still being written).
+   */
+  std::vector< std::string > GetFileNames() const;
+
+  /**
+   * Writes a cache file by way of a temporary file in the same directory.
+   * The write function is given the temporary file's descriptor and name
+   * and returns whether it succeeded.  Returns false if the file couldn't
+   * be written, in which case the temporary file is removed.
+   */
+  static bool Write( const std::string& cacheFileName,
+    const std::function< bool( int, const std::string& ) >& write );
+
+private:
+  vtkCacheDirectory( const vtkCacheDirectory& );  /** Not implemented. */
+  void operator=( const vtkCacheDirectory& );  /** Not implemented. */
+
+  std::string Extension;
+  mutable std::mutex Mutex;
+  std::string Path;
+};
+
+#endif
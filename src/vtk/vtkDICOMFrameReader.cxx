@@ -0,0 +1,393 @@
+/*=========================================================================
+
+  Module:    vtkDICOMFrameReader.cxx
+  Program:   Alder (CLSA Medical Image Quality Assessment Tool)
+  Language:  C++
+  Author:    Patrick Emond <emondpd AT mcmaster DOT ca>
+  Author:    Dean Inglis <inglisd AT mcmaster DOT ca>
+
+=========================================================================*/
+#include "vtkDICOMFrameReader.h"
+
+#include "DicomMetadata.h"
+
+#include "vtkImageData.h"
+#include "vtkInformation.h"
+#include "vtkInformationVector.h"
+#include "vtkMedicalImageProperties.h"
+#include "vtkObjectFactory.h"
+#include "vtkStreamingDemandDrivenPipeline.h"
+
+#include "gdcmImage.h"
+#include "gdcmImageReader.h"
+#include "gdcmSequenceOfFragments.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <list>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+vtkStandardNewMacro( vtkDICOMFrameReader );
+
+// the parts of the file needed to decode its frames, kept out of the header to hide GDCM
+class vtkDICOMFrameReaderInternals
+{
+public:
+  gdcm::DataElement PixelData;
+  gdcm::PixelFormat PixelFormat;
+  gdcm::PhotometricInterpretation PhotometricInterpretation;
+  gdcm::TransferSyntax TransferSyntax;
+  unsigned int Columns;
+  unsigned int Rows;
+
+  // the index of the first fragment of each frame, followed by the number of fragments
+  std::vector< unsigned int > FrameStart;
+
+  // the decoded frames kept, the most recently used is at the front
+  std::list< std::pair< int, std::vector< char > > > Frames;
+};
+
+namespace
+{
+  // returns the index of the first fragment of each frame, or nothing if the frames can't be told apart
+  std::vector< unsigned int > findFrames(
+    const gdcm::SequenceOfFragments *fragments, const unsigned int frames )
+  {
+    std::vector< unsigned int > start;
+    const unsigned int count = fragments->GetNumberOfFragments();
+
+    // the Basic Offset Table has the offset of each frame's first fragment item from the first
+    // item, where each item is made up of its 8 byte tag and length followed by its value
+    const gdcm::ByteValue *table = fragments->GetTable().GetByteValue();
+    if( table && frames * 4 <= table->GetLength() )
+    {
+      const unsigned char *bytes = reinterpret_cast< const unsigned char* >( table->GetPointer() );
+      unsigned long long position = 0;
+      for( unsigned int i = 0; i < count && start.size() < frames; ++i )
+      {
+        const unsigned char *entry = bytes + 4 * start.size();
+        unsigned long long offset = entry[0] | entry[1] << 8 | entry[2] << 16 |
+          static_cast< unsigned long long >( entry[3] ) << 24;
+        if( offset == position ) start.push_back( i );
+        position += 8 + static_cast< unsigned long long >( fragments->GetFragment( i ).GetVL() );
+      }
+      if( frames != start.size() ) start.clear();
+    }
+
+    if( start.empty() && frames == count )
+    {
+      for( unsigned int i = 0; i < count; ++i ) start.push_back( i );
+    }
+
+    // otherwise each frame starts with a JPEG start of image or JPEG 2000 start of codestream marker
+    if( start.empty() )
+    {
+      for( unsigned int i = 0; i < count; ++i )
+      {
+        const gdcm::ByteValue *value = fragments->GetFragment( i ).GetByteValue();
+        if( value && 2 <= value->GetLength() )
+        {
+          const unsigned char *bytes = reinterpret_cast< const unsigned char* >( value->GetPointer() );
+          if( 0xff == bytes[0] && ( 0xd8 == bytes[1] || 0x4f == bytes[1] ) ) start.push_back( i );
+        }
+      }
+      if( frames != start.size() || ( !start.empty() && 0 != start[0] ) ) start.clear();
+    }
+
+    if( !start.empty() ) start.push_back( count );
+    return start;
+  }
+
+  // sets up a single frame image made up of only the fragments of one of the file's frames
+  void setupFrameImage( const vtkDICOMFrameReaderInternals *internals, const int frame, gdcm::Image &image )
+  {
+    const gdcm::SequenceOfFragments *fragments = internals->PixelData.GetSequenceOfFragments();
+    gdcm::SmartPointer< gdcm::SequenceOfFragments > frameFragments = new gdcm::SequenceOfFragments;
+    for( unsigned int i = internals->FrameStart[frame]; i < internals->FrameStart[frame + 1]; ++i )
+      frameFragments->AddFragment( fragments->GetFragment( i ) );
+
+    gdcm::DataElement pixelData( gdcm::Tag( 0x7fe0, 0x0010 ) );
+    pixelData.SetVR( gdcm::VR::OB );
+    pixelData.SetValue( *frameFragments );
+    pixelData.SetVLToUndefined();
+
+    image.SetNumberOfDimensions( 2 );
+    image.SetDimension( 0, internals->Columns );
+    image.SetDimension( 1, internals->Rows );
+    image.SetPixelFormat( internals->PixelFormat );
+    image.SetPhotometricInterpretation( internals->PhotometricInterpretation );
+    image.SetTransferSyntax( internals->TransferSyntax );
+    image.SetDataElement( pixelData );
+  }
+
+  // copies the part of a decoded frame within an extent to the frame's slot of the output, the rows
+  // are flipped so that the first row is at the bottom, as vtkGDCMImageReader does
+  void copyFrame(
+    const vtkDICOMFrameReaderInternals *internals, const char *frame, const int *extent, char *slot )
+  {
+    const size_t pixelSize = internals->PixelFormat.GetPixelSize();
+    const size_t rowLength = ( extent[1] - extent[0] + 1 ) * pixelSize;
+    for( int y = extent[2]; y <= extent[3]; ++y, slot += rowLength )
+    {
+      const char *row = frame + ( ( internals->Rows - 1 - y ) * internals->Columns + extent[0] ) * pixelSize;
+      memcpy( slot, row, rowLength );
+    }
+  }
+
+  int getScalarType( const gdcm::PixelFormat &format )
+  {
+    switch( format.GetScalarType() )
+    {
+      case gdcm::PixelFormat::UINT8: return VTK_UNSIGNED_CHAR;
+      case gdcm::PixelFormat::INT8: return VTK_SIGNED_CHAR;
+      case gdcm::PixelFormat::UINT16: return VTK_UNSIGNED_SHORT;
+      case gdcm::PixelFormat::INT16: return VTK_SHORT;
+      default: return VTK_VOID;
+    }
+  }
+}
+
+//-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-
+vtkDICOMFrameReader::vtkDICOMFrameReader()
+{
+  this->SetNumberOfInputPorts( 0 );
+  this->FrameCacheSize = 16;
+  this->NumberOfThreads = std::max( 1u, std::thread::hardware_concurrency() );
+  this->NumberOfFrames = 0;
+  this->MedicalImageProperties = vtkSmartPointer<vtkMedicalImageProperties>::New();
+  this->Internals = new vtkDICOMFrameReaderInternals;
+}
+
+//-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-
+vtkDICOMFrameReader::~vtkDICOMFrameReader()
+{
+  delete this->Internals;
+}
+
+//-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-
+bool vtkDICOMFrameReader::CanReadFile( const std::string& fileName )
+{
+  try
+  {
+    std::shared_ptr< const Alder::DicomMetadata > metadata = Alder::DicomMetadata::GetInstance( fileName );
+
+    // native (uncompressed) transfer syntaxes have no fragments
+    std::string syntax = metadata->GetValue( 0x0002, 0x0010 );
+    return 1 < metadata->GetDimensions()[2] &&
+           !syntax.empty() &&
+           "1.2.840.10008.1.2" != syntax &&
+           "1.2.840.10008.1.2.1" != syntax &&
+           "1.2.840.10008.1.2.1.99" != syntax &&
+           "1.2.840.10008.1.2.2" != syntax;
+  }
+  catch( std::runtime_error &e )
+  {
+    return false;
+  }
+}
+
+//-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-
+void vtkDICOMFrameReader::SetFileName( const std::string& fileName )
+{
+  if( fileName == this->FileName ) return;
+  this->FileName = fileName;
+  this->Modified();
+}
+
+//-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-
+vtkMedicalImageProperties* vtkDICOMFrameReader::GetMedicalImageProperties()
+{
+  return this->MedicalImageProperties;
+}
+
+//-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-
+int vtkDICOMFrameReader::RequestInformation(
+  vtkInformation *vtkNotUsed( request ),
+  vtkInformationVector **vtkNotUsed( inputVector ),
+  vtkInformationVector *outputVector )
+{
+  vtkDICOMFrameReaderInternals *internals = this->Internals;
+  internals->Frames.clear();
+  internals->FrameStart.clear();
+  this->NumberOfFrames = 0;
+  this->MedicalImageProperties->Clear();
+
+  // the encapsulated pixel data is read as it is, which is far smaller than the decoded frames
+  gdcm::ImageReader reader;
+  reader.SetFileName( this->FileName.c_str() );
+  if( !reader.Read() )
+  {
+    vtkErrorMacro( << "Failed to read dicom file '" << this->FileName << "'." );
+    return 0;
+  }
+
+  const gdcm::Image &image = reader.GetImage();
+  internals->PixelData = image.GetDataElement();
+  const gdcm::SequenceOfFragments *fragments = internals->PixelData.GetSequenceOfFragments();
+  const int scalarType = getScalarType( image.GetPixelFormat() );
+  if( NULL == fragments || 3 != image.GetNumberOfDimensions() ||
+      0 != image.GetPlanarConfiguration() || VTK_VOID == scalarType )
+  {
+    vtkErrorMacro( << "Dicom file '" << this->FileName << "' has no compressed frames which can be read." );
+    return 0;
+  }
+
+  const unsigned int *dims = image.GetDimensions();
+  internals->FrameStart = findFrames( fragments, dims[2] );
+  if( internals->FrameStart.empty() )
+  {
+    vtkErrorMacro( << "Unable to find the frames of dicom file '" << this->FileName << "'." );
+    return 0;
+  }
+
+  internals->PixelFormat = image.GetPixelFormat();
+  internals->PhotometricInterpretation = image.GetPhotometricInterpretation();
+  internals->TransferSyntax = image.GetTransferSyntax();
+  internals->Columns = dims[0];
+  internals->Rows = dims[1];
+  this->NumberOfFrames = dims[2];
+
+  int extent[6] = { 0, static_cast< int >( dims[0] ) - 1,
+                    0, static_cast< int >( dims[1] ) - 1,
+                    0, static_cast< int >( dims[2] ) - 1 };
+  double spacing[3], origin[3];
+  for( int i = 0; i < 3; ++i )
+  {
+    spacing[i] = image.GetSpacing()[i];
+    origin[i] = image.GetOrigin()[i];
+  }
+  vtkInformation *outInfo = outputVector->GetInformationObject( 0 );
+  outInfo->Set( vtkStreamingDemandDrivenPipeline::WHOLE_EXTENT(), extent, 6 );
+  outInfo->Set( vtkDataObject::SPACING(), spacing, 3 );
+  outInfo->Set( vtkDataObject::ORIGIN(), origin, 3 );
+  vtkDataObject::SetPointDataActiveScalarInfo(
+    outInfo, scalarType, image.GetPixelFormat().GetSamplesPerPixel() );
+
+  // the header has usually been parsed already, in which case the file isn't read again
+  try
+  {
+    std::shared_ptr< const Alder::DicomMetadata > metadata =
+      Alder::DicomMetadata::GetInstance( this->FileName );
+    if( metadata->HasValue( 0x0018, 0x0040 ) )
+      this->MedicalImageProperties->AddUserDefinedValue(
+        "CineRate", metadata->GetValue( 0x0018, 0x0040 ).c_str() );
+  }
+  catch( std::runtime_error &e )
+  {
+    // the cine rate is optional
+  }
+
+  return 1;
+}
+
+//-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-
+int vtkDICOMFrameReader::RequestData(
+  vtkInformation *vtkNotUsed( request ),
+  vtkInformationVector **vtkNotUsed( inputVector ),
+  vtkInformationVector *outputVector )
+{
+  vtkInformation *outInfo = outputVector->GetInformationObject( 0 );
+  vtkImageData *output = this->AllocateOutputData( outInfo->Get( vtkDataObject::DATA_OBJECT() ) );
+  if( NULL == output || 0 == this->NumberOfFrames ) return 0;
+
+  int *extent = output->GetExtent();
+  const vtkDICOMFrameReaderInternals *internals = this->Internals;
+  const int frames = extent[5] - extent[4] + 1;
+  char *slot = static_cast< char* >( output->GetScalarPointer( extent[0], extent[2], extent[4] ) );
+  const size_t slotLength =
+    ( extent[1] - extent[0] + 1 ) * ( extent[3] - extent[2] + 1 ) * internals->PixelFormat.GetPixelSize();
+
+  // a single frame goes through the decoded frames kept, many (a whole cineloop) are decoded in parallel
+  if( 1 < frames && 1 < this->NumberOfThreads )
+  {
+    // the images are set up first since GDCM's reference counting isn't thread safe
+    std::vector< gdcm::SmartPointer< gdcm::Image > > images( frames );
+    for( int i = 0; i < frames; ++i )
+    {
+      images[i] = new gdcm::Image;
+      setupFrameImage( internals, extent[4] + i, *images[i] );
+    }
+
+    // each thread takes the next frame to decode and writes it directly into its slot of the output
+    std::atomic< int > next( 0 );
+    std::atomic< bool > failed( false );
+    auto work = [&]()
+    {
+      std::vector< char > buffer;
+      for( int i = next++; i < frames && !failed; i = next++ )
+      {
+        buffer.resize( images[i]->GetBufferLength() );
+        if( buffer.empty() || !images[i]->GetBuffer( &buffer[0] ) ) failed = true;
+        else copyFrame( internals, &buffer[0], extent, slot + i * slotLength );
+      }
+    };
+
+    std::vector< std::thread > threads;
+    for( int t = 1; t < this->NumberOfThreads && t < frames; ++t ) threads.push_back( std::thread( work ) );
+    work();
+    for( auto it = threads.begin(); it != threads.end(); ++it ) it->join();
+
+    if( failed )
+    {
+      vtkErrorMacro( << "Failed to decode the frames of dicom file '" << this->FileName << "'." );
+      return 0;
+    }
+    return 1;
+  }
+
+  for( int z = extent[4]; z <= extent[5]; ++z )
+  {
+    const char *frame = this->GetFrame( z );
+    if( NULL == frame )
+    {
+      vtkErrorMacro( << "Failed to decode frame " << z << " of dicom file '" << this->FileName << "'." );
+      return 0;
+    }
+    copyFrame( internals, frame, extent, slot + ( z - extent[4] ) * slotLength );
+  }
+
+  return 1;
+}
+
+//-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-
+const char* vtkDICOMFrameReader::GetFrame( const int frame )
+{
+  vtkDICOMFrameReaderInternals *internals = this->Internals;
+  for( auto it = internals->Frames.begin(); it != internals->Frames.end(); ++it )
+  {
+    if( frame == it->first )
+    {
+      internals->Frames.splice( internals->Frames.begin(), internals->Frames, it );
+      return &( internals->Frames.front().second[0] );
+    }
+  }
+
+  if( 0 > frame || this->NumberOfFrames <= frame ) return NULL;
+
+  gdcm::Image image;
+  setupFrameImage( internals, frame, image );
+  std::vector< char > buffer( image.GetBufferLength() );
+  if( buffer.empty() || !image.GetBuffer( &buffer[0] ) ) return NULL;
+
+  // forget the least recently used frames once the cache is full
+  internals->Frames.push_front( std::make_pair( frame, std::vector< char >() ) );
+  internals->Frames.front().second.swap( buffer );
+  while( this->FrameCacheSize < static_cast< int >( internals->Frames.size() ) )
+    internals->Frames.pop_back();
+
+  return &( internals->Frames.front().second[0] );
+}
+
+//-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-
+void vtkDICOMFrameReader::PrintSelf( ostream& os, vtkIndent indent )
+{
+  this->Superclass::PrintSelf( os, indent );
+
+  os << indent << "FileName: " << this->FileName << "\n";
+  os << indent << "FrameCacheSize: " << this->FrameCacheSize << "\n";
+  os << indent << "NumberOfThreads: " << this->NumberOfThreads << "\n";
+  os << indent << "NumberOfFrames: " << this->NumberOfFrames << "\n";
+}
@@ -0,0 +1,121 @@
+/*=========================================================================
+
+  Module:    vtkDICOMFrameReader.h
+  Program:   Alder (CLSA Medical Image Quality Assessment Tool)
+  Language:  C++
+  Author:    Patrick Emond <emondpd AT mcmaster DOT ca>
+  Author:    Dean Inglis <inglisd AT mcmaster DOT ca>
+
+=========================================================================*/
+
+/**
+ * @class vtkDICOMFrameReader
+ *
+ * @author Patrick Emond <emondpd AT mcmaster DOT ca>
+ * @author Dean Inglis <inglisd AT mcmaster DOT ca>
+ *
+ * @brief Read the frames of a compressed multi-frame DICOM file on demand.
+ *
+ * vtkGDCMImageReader decodes every frame of a cineloop before any of them
+ * can be shown.  This reader keeps the file's encapsulated pixel data as it
+ * is and only decodes the frames in the requested update extent, so showing
+ * one frame of a cineloop costs one frame's decoding.  The fragments making
+ * up each frame are found from the Basic Offset Table, or when the table is
+ * empty by matching fragments to frames one to one or by the JPEG markers at
+ * the start of each frame.  Frames are decoded by GDCM and flipped the same
+ * way vtkGDCMImageReader does so that either reader gives the same image.
+ *
+ * The most recently decoded frames are kept so that stepping back and forth
+ * through a cineloop doesn't decode the same frames again.  When more than
+ * one frame is requested (a whole cineloop) the frames are decoded in
+ * parallel instead, each written directly into its slot of the output.
+ *
+ * @see vtkGDCMImageReader, vtkMedicalImageViewer
+ */
+#ifndef __vtkDICOMFrameReader_h
+#define __vtkDICOMFrameReader_h
+
+#include "vtkImageAlgorithm.h"
+#include "vtkSmartPointer.h"
+
+#include <string>
+
+class vtkDICOMFrameReaderInternals;
+class vtkMedicalImageProperties;
+
+class vtkDICOMFrameReader : public vtkImageAlgorithm
+{
+public:
+  static vtkDICOMFrameReader *New();
+  vtkTypeMacro( vtkDICOMFrameReader, vtkImageAlgorithm );
+  void PrintSelf( ostream& os, vtkIndent indent );
+
+  /**
+   * Returns whether a file is a multi-frame DICOM file with encapsulated
+   * (compressed) pixel data, judging by its header only.
+   */
+  static bool CanReadFile( const std::string& fileName );
+
+  //@{
+  /**
+   * Set/Get the file to read.
+   */
+  virtual void SetFileName( const std::string& fileName );
+  std::string GetFileName() { return this->FileName; }
+  //@}
+
+  //@{
+  /**
+   * Set/Get the number of decoded frames to keep (default 16).
+   */
+  vtkSetClampMacro( FrameCacheSize, int, 1, VTK_INT_MAX );
+  vtkGetMacro( FrameCacheSize, int );
+  //@}
+
+  //@{
+  /**
+   * Set/Get the number of threads used to decode more than one frame at
+   * once (default the number of cores).
+   */
+  vtkSetClampMacro( NumberOfThreads, int, 1, VTK_INT_MAX );
+  vtkGetMacro( NumberOfThreads, int );
+  //@}
+
+  /**
+   * Returns the number of frames in the file, or 0 if its frames can't be
+   * read separately (valid after UpdateInformation()).
+   */
+  vtkGetMacro( NumberOfFrames, int );
+
+  /**
+   * Returns the medical image properties of the file (valid after
+   * UpdateInformation()).
+   */
+  vtkMedicalImageProperties* GetMedicalImageProperties();
+
+protected:
+  vtkDICOMFrameReader();
+  ~vtkDICOMFrameReader();
+
+  virtual int RequestInformation( vtkInformation *, vtkInformationVector **, vtkInformationVector * );
+  virtual int RequestData( vtkInformation *, vtkInformationVector **, vtkInformationVector * );
+
+  /**
+   * Returns a decoded frame, decoding it if it isn't one of the frames kept,
+   * or NULL if the frame can't be decoded.
+   */
+  const char* GetFrame( const int frame );
+
+  std::string FileName;
+  int FrameCacheSize;
+  int NumberOfThreads;
+  int NumberOfFrames;
+  vtkSmartPointer<vtkMedicalImageProperties> MedicalImageProperties;
+  vtkDICOMFrameReaderInternals *Internals;
+
+private:
+  vtkDICOMFrameReader( const vtkDICOMFrameReader& );  /** Not implemented. */
+  void operator=( const vtkDICOMFrameReader& );  /** Not implemented. */
+};
+
+#endif
@@ -0,0 +1,387 @@
+/*=========================================================================
+
+  Module:    vtkDecodedImageCache.cxx
+  Program:   Alder (CLSA Medical Image Quality Assessment Tool)
+  Language:  C++
+  Author:    Patrick Emond <emondpd AT mcmaster DOT ca>
+  Author:    Dean Inglis <inglisd AT mcmaster DOT ca>
+
+=========================================================================*/
+#include "vtkDecodedImageCache.h"
+
+#include "vtkCacheDirectory.h"
+#include "vtkCallbackCommand.h"
+#include "vtkDataArray.h"
+#include "vtkFieldData.h"
+#include "vtkFileQueue.h"
+#include "vtkIdTypeArray.h"
+#include "vtkImageData.h"
+#include "vtkImageDataReader.h"
+#include "vtkNew.h"
+#include "vtkPointData.h"
+#include "vtkSmartPointer.h"
+#include "vtkUnsignedCharArray.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <fcntl.h>
+#include <stdexcept>
+#include <stdint.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+namespace
+{
+  // the pixels start on a page boundary so that they can be mapped directly
+  const size_t HeaderLength = 4096;
+  const char Magic[8] = { 'A', 'L', 'D', 'E', 'R', 'R', 'A', 'W' };
+  const uint32_t Version = 2;
+
+  // each point of a color overlay is stored as its id followed (after all of the ids) by its color
+  const size_t OverlayPointLength = sizeof( int64_t ) + 3;
+
+  struct CacheHeader
+  {
+    char Magic[8];
+    uint32_t Version;
+    int32_t ScalarType;
+    int32_t Components;
+    int32_t Extent[6];
+    double Spacing[3];
+    double Origin[3];
+    int64_t SourceModifiedTime;
+    int64_t SourceSize;
+    uint64_t DataLength;
+    uint64_t OverlayCount;
+    char SourceName[3072];
+  };
+
+  static_assert( sizeof( CacheHeader ) <= HeaderLength, "The cache header must fit in one page" );
+
+  // a mapped cache file, unmapped when the scalars using it are deleted
+  struct Mapping
+  {
+    void *Address;
+    size_t Length;
+  };
+
+  void unmap( vtkObject*, unsigned long, void *clientData, void* )
+  {
+    Mapping *mapping = static_cast< Mapping* >( clientData );
+    munmap( mapping->Address, mapping->Length );
+    delete mapping;
+  }
+
+  vtkCacheDirectory cacheDirectory( ".raw" );
+  std::atomic< unsigned long > budgetMegabytes( 10240 );
+
+  // returns the name of the file a cache file was made from
+  std::string getSourceName( const CacheHeader &header )
+  {
+    return std::string( header.SourceName, strnlen( header.SourceName, sizeof( header.SourceName ) ) );
+  }
+
+  // returns the length a cache file must have: its header, pixels and color overlay
+  uint64_t getFileLength( const CacheHeader &header )
+  {
+    return HeaderLength + header.DataLength + header.OverlayCount * OverlayPointLength;
+  }
+
+  // writes all of a buffer to a file, returns false if it couldn't
+  bool writeAll( int descriptor, const void *buffer, uint64_t length )
+  {
+    const char *data = static_cast< const char* >( buffer );
+    while( 0 < length )
+    {
+      ssize_t written = write( descriptor, data, length );
+      if( 0 >= written ) return false;
+      data += written;
+      length -= written;
+    }
+    return true;
+  }
+
+  // returns whether the file a cache file was made from hasn't changed since
+  bool isCurrent( const CacheHeader &header, const std::string& fileName )
+  {
+    struct stat info;
+    return 0 == memcmp( header.Magic, Magic, sizeof( Magic ) ) &&
+           Version == header.Version &&
+           fileName == getSourceName( header ) &&
+           0 == stat( fileName.c_str(), &info ) &&
+           header.SourceModifiedTime == static_cast< int64_t >( info.st_mtime ) &&
+           header.SourceSize == static_cast< int64_t >( info.st_size );
+  }
+
+  // removes the cache files whose source file has changed or is gone, then the least recently
+  // used ones (by access time, see Load()) until the cache is within its budget
+  void prune()
+  {
+    struct Entry
+    {
+      std::string FileName;
+      time_t AccessTime;
+      uint64_t Length;
+    };
+
+    std::vector< Entry > entries;
+    uint64_t total = 0;
+    std::vector< std::string > fileNames = cacheDirectory.GetFileNames();
+    for( auto it = fileNames.begin(); it != fileNames.end(); ++it )
+    {
+      int descriptor = open( it->c_str(), O_RDONLY );
+      if( -1 == descriptor ) continue;
+
+      CacheHeader header;
+      struct stat info;
+      bool current =
+        sizeof( header ) == static_cast< size_t >( read( descriptor, &header, sizeof( header ) ) ) &&
+        0 == fstat( descriptor, &info ) &&
+        isCurrent( header, getSourceName( header ) );
+      close( descriptor );
+
+      // a file removed while an image is mapped from it stays readable until it is unmapped
+      if( !current ) remove( it->c_str() );
+      else
+      {
+        Entry entry = { *it, info.st_atime, static_cast< uint64_t >( info.st_size ) };
+        entries.push_back( entry );
+        total += entry.Length;
+      }
+    }
+
+    std::sort( entries.begin(), entries.end(),
+      []( const Entry& a, const Entry& b ) { return a.AccessTime < b.AccessTime; } );
+    const uint64_t budget = static_cast< uint64_t >( budgetMegabytes ) * 1024 * 1024;
+    for( auto it = entries.begin(); it != entries.end() && budget < total; ++it )
+      if( 0 == remove( it->FileName.c_str() ) ) total -= it->Length;
+  }
+
+  // decodes a queued file and adds it to the cache (unless it is already there)
+  void decode( const std::string& fileName )
+  {
+    if( vtkDecodedImageCache::Contains( fileName ) ) return;
+
+    // images are cached as they are read, reduced to luminance and a color overlay when possible
+    vtkNew< vtkImageDataReader > reader;
+    reader->SetFileName( fileName.c_str() );
+    vtkImageData *image = reader->GetOutput();
+    if( image && vtkDecodedImageCache::Store( fileName, image ) ) prune();
+  }
+
+  // files which fail to decode are decoded when they are viewed instead
+  vtkFileQueue decodeQueue( decode );
+}
+
+//-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-
+void vtkDecodedImageCache::SetDirectory( const std::string& directory )
+{
+  cacheDirectory.SetPath( directory );
+}
+
+//-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-
+std::string vtkDecodedImageCache::GetDirectory()
+{
+  return cacheDirectory.GetPath();
+}
+
+//-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-
+void vtkDecodedImageCache::SetDiskBudget( const unsigned long megabytes )
+{
+  budgetMegabytes = megabytes;
+}
+
+//-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-
+unsigned long vtkDecodedImageCache::GetDiskBudget()
+{
+  return budgetMegabytes;
+}
+
+//-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-
+bool vtkDecodedImageCache::Load( const std::string& fileName, vtkImageData* image )
+{
+  std::string cacheFileName = cacheDirectory.GetFileName( fileName );
+  if( cacheFileName.empty() || NULL == image ) return false;
+
+  int descriptor = open( cacheFileName.c_str(), O_RDONLY );
+  if( -1 == descriptor ) return false;
+
+  struct stat info;
+  void *address = MAP_FAILED;
+  size_t length = 0;
+  if( 0 == fstat( descriptor, &info ) && HeaderLength <= static_cast< size_t >( info.st_size ) )
+  {
+    // a private mapping, so that the image can never write to the cache file
+    length = info.st_size;
+    address = mmap( NULL, length, PROT_READ | PROT_WRITE, MAP_PRIVATE, descriptor, 0 );
+  }
+  close( descriptor );
+  if( MAP_FAILED == address ) return false;
+
+  const CacheHeader *header = static_cast< const CacheHeader* >( address );
+  vtkDataArray *scalars = NULL;
+  if( isCurrent( *header, fileName ) && getFileLength( *header ) == length )
+    scalars = vtkDataArray::CreateDataArray( header->ScalarType );
+
+  vtkIdType values = 0;
+  if( scalars )
+  {
+    const int *extent = header->Extent;
+    values = static_cast< vtkIdType >( extent[1] - extent[0] + 1 ) *
+             ( extent[3] - extent[2] + 1 ) * ( extent[5] - extent[4] + 1 ) * header->Components;
+    uint64_t dataLength = values * static_cast< uint64_t >( scalars->GetDataTypeSize() );
+    if( 0 >= values || header->DataLength != dataLength )
+    {
+      scalars->Delete();
+      scalars = NULL;
+    }
+  }
+
+  if( NULL == scalars )
+  {
+    munmap( address, length );
+    return false;
+  }
+
+  // hand the mapped pixels to the scalars without copying them (the scalars don't free them)
+  scalars->SetNumberOfComponents( header->Components );
+  scalars->SetVoidArray( static_cast< char* >( address ) + HeaderLength, values, 1 );
+  Mapping *mapping = new Mapping;
+  mapping->Address = address;
+  mapping->Length = length;
+  vtkNew< vtkCallbackCommand > callback;
+  callback->SetCallback( unmap );
+  callback->SetClientData( mapping );
+  scalars->AddObserver( vtkCommand::DeleteEvent, callback.GetPointer() );
+
+  image->Initialize();
+  image->SetExtent( const_cast< int* >( header->Extent ) );
+  image->SetWholeExtent( const_cast< int* >( header->Extent ) );
+  image->SetSpacing( const_cast< double* >( header->Spacing ) );
+  image->SetOrigin( const_cast< double* >( header->Origin ) );
+  image->SetScalarType( header->ScalarType );
+  image->SetNumberOfScalarComponents( header->Components );
+  image->GetPointData()->SetScalars( scalars );
+  scalars->Delete();
+
+  // the color overlay is small, so it is copied rather than mapped (the ids aren't aligned)
+  if( 0 < header->OverlayCount )
+  {
+    const vtkIdType count = header->OverlayCount;
+    const char *overlay = static_cast< const char* >( address ) + HeaderLength + header->DataLength;
+    vtkSmartPointer< vtkIdTypeArray > ids = vtkSmartPointer< vtkIdTypeArray >::New();
+    ids->SetName( vtkImageDataReader::ColorOverlayIdsName );
+    ids->SetNumberOfTuples( count );
+    for( vtkIdType i = 0; i < count; ++i )
+    {
+      int64_t id;
+      memcpy( &id, overlay + i * sizeof( id ), sizeof( id ) );
+      ids->SetValue( i, id );
+    }
+    vtkSmartPointer< vtkUnsignedCharArray > colors = vtkSmartPointer< vtkUnsignedCharArray >::New();
+    colors->SetName( vtkImageDataReader::ColorOverlayColorsName );
+    colors->SetNumberOfComponents( 3 );
+    colors->SetNumberOfTuples( count );
+    memcpy( colors->GetPointer( 0 ), overlay + count * sizeof( int64_t ), 3 * count );
+    image->GetFieldData()->AddArray( ids );
+    image->GetFieldData()->AddArray( colors );
+  }
+
+  // record the use explicitly since file systems are often mounted without access times
+  struct timespec times[2];
+  times[0].tv_nsec = UTIME_NOW;
+  times[1].tv_nsec = UTIME_OMIT;
+  utimensat( AT_FDCWD, cacheFileName.c_str(), times, 0 );
+  return true;
+}
+
+//-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-
+bool vtkDecodedImageCache::Contains( const std::string& fileName )
+{
+  std::string cacheFileName = cacheDirectory.GetFileName( fileName );
+  if( cacheFileName.empty() ) return false;
+
+  int descriptor = open( cacheFileName.c_str(), O_RDONLY );
+  if( -1 == descriptor ) return false;
+
+  CacheHeader header;
+  struct stat info;
+  bool current =
+    sizeof( header ) == static_cast< size_t >( read( descriptor, &header, sizeof( header ) ) ) &&
+    0 == fstat( descriptor, &info ) &&
+    isCurrent( header, fileName ) &&
+    getFileLength( header ) == static_cast< uint64_t >( info.st_size );
+  close( descriptor );
+  return current;
+}
+
+//-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-
+bool vtkDecodedImageCache::Store( const std::string& fileName, vtkImageData* image )
+{
+  std::string cacheFileName = cacheDirectory.GetFileName( fileName );
+  if( cacheFileName.empty() || NULL == image ) return false;
+
+  vtkDataArray *scalars = image->GetPointData()->GetScalars();
+  CacheHeader header;
+  struct stat info;
+  if( NULL == scalars || sizeof( header.SourceName ) <= fileName.length() ||
+      0 != stat( fileName.c_str(), &info ) ) return false;
+
+  // the color overlay of reduced images is stored after the pixels
+  std::vector< int64_t > overlayIds;
+  vtkUnsignedCharArray *overlayColors = NULL;
+  if( vtkImageDataReader::HasColorOverlay( image ) )
+  {
+    vtkIdTypeArray *ids = vtkIdTypeArray::SafeDownCast(
+      image->GetFieldData()->GetArray( vtkImageDataReader::ColorOverlayIdsName ) );
+    overlayColors = vtkUnsignedCharArray::SafeDownCast(
+      image->GetFieldData()->GetArray( vtkImageDataReader::ColorOverlayColorsName ) );
+    if( NULL == ids || NULL == overlayColors ||
+        ids->GetNumberOfTuples() != overlayColors->GetNumberOfTuples() ) return false;
+    overlayIds.resize( ids->GetNumberOfTuples() );
+    for( vtkIdType i = 0; i < ids->GetNumberOfTuples(); ++i ) overlayIds[i] = ids->GetValue( i );
+  }
+
+  memset( &header, 0, sizeof( header ) );
+  memcpy( header.Magic, Magic, sizeof( Magic ) );
+  header.Version = Version;
+  header.ScalarType = scalars->GetDataType();
+  header.Components = scalars->GetNumberOfComponents();
+  image->GetExtent( header.Extent );
+  image->GetSpacing( header.Spacing );
+  image->GetOrigin( header.Origin );
+  header.SourceModifiedTime = info.st_mtime;
+  header.SourceSize = info.st_size;
+  header.DataLength = static_cast< uint64_t >( scalars->GetNumberOfTuples() ) *
+                      header.Components * scalars->GetDataTypeSize();
+  header.OverlayCount = overlayIds.size();
+  strcpy( header.SourceName, fileName.c_str() );
+
+  return vtkCacheDirectory::Write( cacheFileName,
+    [&]( int descriptor, const std::string& )
+    {
+      char page[HeaderLength];
+      memset( page, 0, HeaderLength );
+      memcpy( page, &header, sizeof( header ) );
+      return writeAll( descriptor, page, HeaderLength ) &&
+             writeAll( descriptor, scalars->GetVoidPointer( 0 ), header.DataLength ) &&
+             ( overlayIds.empty() ||
+               ( writeAll( descriptor, &overlayIds[0], overlayIds.size() * sizeof( int64_t ) ) &&
+                 writeAll( descriptor, overlayColors->GetPointer( 0 ), 3 * overlayIds.size() ) ) );
+    } );
+}
+
+//-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-
+void vtkDecodedImageCache::Enqueue( const std::string& fileName )
+{
+  if( !vtkDecodedImageCache::GetDirectory().empty() && 0 < budgetMegabytes ) decodeQueue.Push( fileName );
+}
+
+//-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-
+void vtkDecodedImageCache::Stop()
+{
+  decodeQueue.Stop();
+}
@@ -0,0 +1,106 @@
+/*=========================================================================
+
+  Module:    vtkDecodedImageCache.h
+  Program:   Alder (CLSA Medical Image Quality Assessment Tool)
+  Language:  C++
+  Author:    Patrick Emond <emondpd AT mcmaster DOT ca>
+  Author:    Dean Inglis <inglisd AT mcmaster DOT ca>
+
+=========================================================================*/
+
+/**
+ * @class vtkDecodedImageCache
+ *
+ * @author Patrick Emond <emondpd AT mcmaster DOT ca>
+ * @author Dean Inglis <inglisd AT mcmaster DOT ca>
+ *
+ * @brief Optional on-disk cache of decoded pixel data.
+ *
+ * Cineloops are stored as JPEG compressed multi-frame DICOM files, so
+ * reading one means decoding hundreds of frames.  This cache keeps the
+ * decoded pixels of such files in a directory, one file per image made of a
+ * one page header (the source file's name, size and modification time
+ * followed by the image's geometry and scalar type) and the raw pixels.
+ * Images are cached as vtkImageDataReader returns them, so an ultrasound
+ * image reduced to luminance is cached as such followed by its color
+ * overlay (see vtkImageDataReader::HasColorOverlay()).
+ *
+ * Load() memory-maps a cache file and hands its pixels to a vtkImageData
+ * without copying them, so reading a cached image only costs the page
+ * faults of the pixels actually used.  The mapping is private, so the
+ * cache file is never modified through the image, and it is unmapped once
+ * the image's scalars are deleted.
+ *
+ * Images are added to the cache in the background by Enqueue(), which is
+ * used once an image has been downloaded.  Each time one is added, cache
+ * files whose source file has changed or been deleted are removed, then the
+ * least recently loaded ones until the cache fits in its disk budget.  The
+ * cache is disabled until a directory is set.
+ */
+#ifndef __vtkDecodedImageCache_h
+#define __vtkDecodedImageCache_h
+
+#include <string>
+
+class vtkImageData;
+
+class vtkDecodedImageCache
+{
+public:
+  //@{
+  /**
+   * Set/Get the directory the cache is kept in (an empty directory, the
+   * default, disables the cache).
+   */
+  static void SetDirectory( const std::string& directory );
+  static std::string GetDirectory();
+  //@}
+
+  //@{
+  /**
+   * Set/Get the number of megabytes of decoded images to keep on disk
+   * (default 10240, 0 disables the cache).
+   */
+  static void SetDiskBudget( const unsigned long megabytes );
+  static unsigned long GetDiskBudget();
+  //@}
+
+  /**
+   * Maps the decoded pixels of a file into the given image, along with a
+   * copy of its color overlay if it has one.  Returns false if the file
+   * isn't in the cache or has changed since it was cached.
+   */
+  static bool Load( const std::string& fileName, vtkImageData* image );
+
+  /**
+   * Returns whether the decoded pixels of a file are in the cache and the
+   * file hasn't changed since they were cached (only the header is read).
+   */
+  static bool Contains( const std::string& fileName );
+
+  /**
+   * Writes an image decoded from a file to the cache (with its color
+   * overlay, if any), replacing any older copy.  Returns false if the cache
+   * is disabled or can't be written to.
+   */
+  static bool Store( const std::string& fileName, vtkImageData* image );
+
+  /**
+   * Queues a file to be decoded and added to the cache by a background
+   * thread (files already in the cache are skipped).
+   */
+  static void Enqueue( const std::string& fileName );
+
+  /**
+   * Stops the background thread after the file it is decoding, discarding
+   * the files still queued.  Must be called before the program exits.
+   */
+  static void Stop();
+
+private:
+  vtkDecodedImageCache();  /** Not implemented. */
+  vtkDecodedImageCache( const vtkDecodedImageCache& );  /** Not implemented. */
+  void operator=( const vtkDecodedImageCache& );  /** Not implemented. */
+};
+
+#endif
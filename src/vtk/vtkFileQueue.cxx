@@ -0,0 +1,86 @@
+/*=========================================================================
+
+  Module:    vtkFileQueue.cxx
+  Program:   Alder (CLSA Medical Image Quality Assessment Tool)
+  Language:  C++
+  Author:    Patrick Emond <emondpd AT mcmaster DOT ca>
+  Author:    Dean Inglis <inglisd AT mcmaster DOT ca>
+
+=========================================================================*/
+#include "vtkFileQueue.h"
+
+#include <stdexcept>
+
+//-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-
+vtkFileQueue::vtkFileQueue( const std::function< void( const std::string& ) >& process )
+  : Process( process ), Running( false ), Stopped( false )
+{
+}
+
+//-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-
+vtkFileQueue::~vtkFileQueue()
+{
+  this->Stop();
+}
+
+//-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-
+void vtkFileQueue::Push( const std::string& fileName )
+{
+  std::lock_guard< std::mutex > lock( this->Mutex );
+  if( this->Stopped ) return;
+  this->Queue.push_back( fileName );
+  if( !this->Running )
+  {
+    // the previous thread (if any) has already left its loop
+    if( this->Worker.joinable() ) this->Worker.join();
+    this->Running = true;
+    this->Worker = std::thread( &vtkFileQueue::Work, this );
+  }
+}
+
+//-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-
+void vtkFileQueue::Flush()
+{
+  std::unique_lock< std::mutex > lock( this->Mutex );
+  this->Idle.wait( lock, [this]() { return !this->Running; } );
+}
+
+//-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-
+void vtkFileQueue::Stop()
+{
+  {
+    std::lock_guard< std::mutex > lock( this->Mutex );
+    this->Stopped = true;
+    this->Queue.clear();
+  }
+  if( this->Worker.joinable() ) this->Worker.join();
+}
+
+//-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-
+void vtkFileQueue::Work()
+{
+  while( true )
+  {
+    std::string fileName;
+    {
+      std::lock_guard< std::mutex > lock( this->Mutex );
+      if( this->Stopped || this->Queue.empty() )
+      {
+        this->Running = false;
+        this->Idle.notify_all();
+        return;
+      }
+      fileName = this->Queue.front();
+      this->Queue.pop_front();
+    }
+
+    try
+    {
+      this->Process( fileName );
+    }
+    catch( std::exception &e )
+    {
+      // the file is left unprocessed
+    }
+  }
+}
@@ -0,0 +1,79 @@
+/*=========================================================================
+
+  Module:    vtkFileQueue.h
+  Program:   Alder (CLSA Medical Image Quality Assessment Tool)
+  Language:  C++
+  Author:    Patrick Emond <emondpd AT mcmaster DOT ca>
+  Author:    Dean Inglis <inglisd AT mcmaster DOT ca>
+
+=========================================================================*/
+
+/**
+ * @class vtkFileQueue
+ *
+ * @author Patrick Emond <emondpd AT mcmaster DOT ca>
+ * @author Dean Inglis <inglisd AT mcmaster DOT ca>
+ *
+ * @brief Files waiting to be processed one at a time by a background thread.
+ *
+ * The thread is started when a file is queued and ends once the queue is
+ * empty, so an idle queue costs nothing.  Exceptions thrown while a file
+ * is processed are ignored, the file is simply left unprocessed.
+ *
+ * @see vtkDecodedImageCache, vtkImageThumbnailCache
+ */
+#ifndef __vtkFileQueue_h
+#define __vtkFileQueue_h
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+
+class vtkFileQueue
+{
+public:
+  /**
+   * Creates a queue whose files are given to the process function.
+   */
+  vtkFileQueue( const std::function< void( const std::string& ) >& process );
+
+  /**
+   * Stops the queue (see Stop()).
+   */
+  ~vtkFileQueue();
+
+  /**
+   * Queues a file, starting the background thread if it isn't running.
+   * Files queued after the queue has been stopped are ignored.
+   */
+  void Push( const std::string& fileName );
+
+  /**
+   * Waits until every queued file has been processed.
+   */
+  void Flush();
+
+  /**
+   * Discards the files still queued and waits for the file being processed.
+   */
+  void Stop();
+
+private:
+  vtkFileQueue( const vtkFileQueue& );  /** Not implemented. */
+  void operator=( const vtkFileQueue& );  /** Not implemented. */
+
+  void Work();
+
+  std::function< void( const std::string& ) > Process;
+  std::mutex Mutex;
+  std::condition_variable Idle;
+  std::deque< std::string > Queue;
+  std::thread Worker;
+  bool Running;
+  bool Stopped;
+};
+
+#endif
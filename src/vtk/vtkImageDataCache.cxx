@@ -0,0 +1,341 @@
+/*=========================================================================
+
+  Module:    vtkImageDataCache.cxx
+  Program:   Alder (CLSA Medical Image Quality Assessment Tool)
+  Language:  C++
+  Author:    Patrick Emond <emondpd AT mcmaster DOT ca>
+  Author:    Dean Inglis <inglisd AT mcmaster DOT ca>
+
+=========================================================================*/
+#include "vtkImageDataCache.h"
+
+#include "vtkDataArray.h"
+#include "vtkFileQueue.h"
+#include "vtkImageData.h"
+#include "vtkImageDataReader.h"
+#include "vtkMedicalImageProperties.h"
+#include "vtkNew.h"
+#include "vtkPointData.h"
+#include "vtkSmartPointer.h"
+#include "vtkWeakPointer.h"
+
+#include <list>
+#include <map>
+#include <mutex>
+#include <stdexcept>
+#include <sys/stat.h>
+
+namespace
+{
+  struct CacheEntry
+  {
+    time_t ModifiedTime;
+    off_t Size;
+    unsigned long Kilobytes;
+    vtkSmartPointer< vtkImageData > Image;
+    vtkSmartPointer< vtkMedicalImageProperties > Properties;
+    std::list< std::string >::iterator Use;
+  };
+
+  // an image which was loaded, whose pixels are only referenced by the images using them
+  struct SharedEntry
+  {
+    time_t ModifiedTime;
+    off_t Size;
+    vtkSmartPointer< vtkImageData > Structure; // the image without its pixels
+    vtkWeakPointer< vtkDataArray > Scalars;
+    vtkSmartPointer< vtkMedicalImageProperties > Properties;
+  };
+
+  // the cache, the most recently used file name is at the front of the use list
+  std::mutex cacheMutex;
+  std::map< std::string, CacheEntry > cache;
+  std::list< std::string > useList;
+  unsigned long budgetKilobytes = 512 * 1024;
+  unsigned long usedKilobytes = 0;
+
+  // every image which was loaded, so that images which are still in use (by a viewer) are
+  // shared instead of decoded again even once they have been dropped from the cache
+  std::map< std::string, SharedEntry > sharedImages;
+
+  // images decoded in the background, waiting to be picked up by Load() (even if they don't fit
+  // in the cache), the most recent is at the front
+  // they are only referenced by this list until then, so the background thread never shares
+  // VTK objects with the thread using the cache (VTK's reference counts aren't atomic)
+  const size_t DecodedLimit = 2;
+  std::list< std::pair< std::string, CacheEntry > > decodedImages;
+
+  // drops the least recently used images until the cache is within its budget
+  void trimCache()
+  {
+    while( budgetKilobytes < usedKilobytes && !useList.empty() )
+    {
+      auto it = cache.find( useList.back() );
+      usedKilobytes -= it->second.Kilobytes;
+      cache.erase( it );
+      useList.pop_back();
+    }
+  }
+
+  void copyEntry( const CacheEntry &entry, vtkImageData* image, vtkMedicalImageProperties* properties )
+  {
+    image->ShallowCopy( entry.Image );
+    if( properties ) properties->DeepCopy( entry.Properties );
+  }
+
+  // adds an image to the cache if it fits in the budget
+  void addEntry( const std::string& fileName, CacheEntry &entry )
+  {
+    if( entry.Kilobytes <= budgetKilobytes && cache.end() == cache.find( fileName ) )
+    {
+      useList.push_front( fileName );
+      entry.Use = useList.begin();
+      cache[fileName] = entry;
+      usedKilobytes += entry.Kilobytes;
+      trimCache();
+    }
+  }
+
+  // records a loaded image's pixels without keeping them
+  void shareEntry( const std::string& fileName, const CacheEntry &entry )
+  {
+    SharedEntry &shared = sharedImages[fileName];
+    shared.ModifiedTime = entry.ModifiedTime;
+    shared.Size = entry.Size;
+    shared.Structure = vtkSmartPointer< vtkImageData >::New();
+    shared.Structure->ShallowCopy( entry.Image );
+    shared.Structure->GetPointData()->SetScalars( NULL );
+    shared.Scalars = entry.Image->GetPointData()->GetScalars();
+    shared.Properties = entry.Properties;
+  }
+
+  // rebuilds the cache entry of an image from its shared pixels, returns false if they are
+  // no longer in use (or the file has changed since)
+  bool unshareEntry( const std::string& fileName, const struct stat &info, CacheEntry &entry )
+  {
+    // forget the images which are no longer in use
+    for( auto it = sharedImages.begin(); it != sharedImages.end(); )
+    {
+      if( NULL == it->second.Scalars.GetPointer() ) sharedImages.erase( it++ );
+      else ++it;
+    }
+
+    auto it = sharedImages.find( fileName );
+    if( sharedImages.end() == it ) return false;
+
+    const SharedEntry &shared = it->second;
+    if( shared.ModifiedTime != info.st_mtime || shared.Size != info.st_size )
+    {
+      sharedImages.erase( it );
+      return false;
+    }
+
+    vtkDataArray *scalars = shared.Scalars;
+    entry.ModifiedTime = shared.ModifiedTime;
+    entry.Size = shared.Size;
+    entry.Image = vtkSmartPointer< vtkImageData >::New();
+    entry.Image->ShallowCopy( shared.Structure );
+    entry.Image->SetScalarType( scalars->GetDataType() );
+    entry.Image->SetNumberOfScalarComponents( scalars->GetNumberOfComponents() );
+    entry.Image->GetPointData()->SetScalars( scalars );
+    entry.Properties = shared.Properties;
+    entry.Kilobytes = entry.Image->GetActualMemorySize();
+    return true;
+  }
+
+  // decodes a file into a new entry, returns false if it can't be read
+  bool decodeEntry( const std::string& fileName, const struct stat &info, CacheEntry &entry )
+  {
+    entry.ModifiedTime = info.st_mtime;
+    entry.Size = info.st_size;
+    entry.Image = vtkSmartPointer< vtkImageData >::New();
+    entry.Properties = vtkSmartPointer< vtkMedicalImageProperties >::New();
+    try
+    {
+      vtkNew< vtkImageDataReader > reader;
+      reader->SetFileName( fileName.c_str() );
+      vtkImageData* output = reader->GetOutput();
+      if( NULL == output ) return false;
+      entry.Image->ShallowCopy( output );
+      entry.Properties->DeepCopy( reader->GetMedicalImageProperties() );
+    }
+    catch( std::runtime_error &e )
+    {
+      return false;
+    }
+    entry.Kilobytes = entry.Image->GetActualMemorySize();
+    return true;
+  }
+
+  // removes an image decoded in the background from the list, returns whether it was there and
+  // is still current (in which case it is given to the entry)
+  bool takeDecodedEntry( const std::string& fileName, const struct stat &info, CacheEntry &entry )
+  {
+    for( auto it = decodedImages.begin(); it != decodedImages.end(); ++it )
+    {
+      if( fileName == it->first )
+      {
+        bool current = it->second.ModifiedTime == info.st_mtime && it->second.Size == info.st_size;
+        if( current ) entry = it->second;
+        decodedImages.erase( it );
+        return current;
+      }
+    }
+    return false;
+  }
+
+  // returns whether an image is in the cache or was decoded in the background and is current
+  // (only times and sizes are compared, so the background thread may call this too)
+  bool isCached( const std::string& fileName, const struct stat &info )
+  {
+    auto it = cache.find( fileName );
+    if( cache.end() != it )
+      return it->second.ModifiedTime == info.st_mtime && it->second.Size == info.st_size;
+
+    for( auto decoded = decodedImages.cbegin(); decoded != decodedImages.cend(); ++decoded )
+      if( fileName == decoded->first )
+        return decoded->second.ModifiedTime == info.st_mtime && decoded->second.Size == info.st_size;
+    return false;
+  }
+
+  // decodes a file queued by LoadInBackground() into objects only this thread references, then
+  // hands them to the list (the reader and everything else sharing them is gone by then)
+  void preload( const std::string& fileName )
+  {
+    struct stat info;
+    if( 0 != stat( fileName.c_str(), &info ) ) return;
+    {
+      std::lock_guard< std::mutex > lock( cacheMutex );
+      if( isCached( fileName, info ) ) return;
+    }
+
+    CacheEntry entry;
+    if( !decodeEntry( fileName, info, entry ) ) return;
+
+    std::lock_guard< std::mutex > lock( cacheMutex );
+    CacheEntry old;
+    takeDecodedEntry( fileName, info, old );
+    decodedImages.push_front( std::make_pair( fileName, entry ) );
+    if( DecodedLimit < decodedImages.size() ) decodedImages.pop_back();
+
+    // release this thread's references while the list can't be read
+    entry.Image = NULL;
+    entry.Properties = NULL;
+  }
+
+  // declared after the cache so that it is stopped before the cache is destroyed
+  vtkFileQueue preloadQueue( preload );
+}
+
+//-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-
+bool vtkImageDataCache::Load( const std::string& fileName, vtkImageData* image,
+  vtkMedicalImageProperties* properties )
+{
+  if( NULL == image ) return false;
+
+  struct stat info;
+  if( 0 != stat( fileName.c_str(), &info ) ) return false;
+
+  {
+    std::lock_guard< std::mutex > lock( cacheMutex );
+    auto it = cache.find( fileName );
+    if( cache.end() != it )
+    {
+      if( it->second.ModifiedTime == info.st_mtime && it->second.Size == info.st_size )
+      {
+        useList.splice( useList.begin(), useList, it->second.Use );
+        copyEntry( it->second, image, properties );
+        return true;
+      }
+
+      // the file has changed since it was decoded
+      usedKilobytes -= it->second.Kilobytes;
+      useList.erase( it->second.Use );
+      cache.erase( it );
+    }
+
+    // images which were dropped from the cache but are still in use aren't decoded again
+    CacheEntry entry;
+    if( unshareEntry( fileName, info, entry ) )
+    {
+      copyEntry( entry, image, properties );
+      addEntry( fileName, entry );
+      return true;
+    }
+
+    // images decoded in the background are shared and cached by this thread as they are taken
+    if( takeDecodedEntry( fileName, info, entry ) )
+    {
+      copyEntry( entry, image, properties );
+      shareEntry( fileName, entry );
+      addEntry( fileName, entry );
+      return true;
+    }
+  }
+
+  // decode the file without holding the lock
+  CacheEntry entry;
+  if( !decodeEntry( fileName, info, entry ) ) return false;
+  copyEntry( entry, image, properties );
+
+  std::lock_guard< std::mutex > lock( cacheMutex );
+  shareEntry( fileName, entry );
+  addEntry( fileName, entry );
+  return true;
+}
+
+//-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-
+bool vtkImageDataCache::Contains( const std::string& fileName )
+{
+  struct stat info;
+  if( 0 != stat( fileName.c_str(), &info ) ) return false;
+
+  std::lock_guard< std::mutex > lock( cacheMutex );
+  if( isCached( fileName, info ) ) return true;
+
+  // images dropped from the cache (or which never fit in it) which are still in use are shared by
+  // Load() instead of being decoded again
+  auto shared = sharedImages.find( fileName );
+  return sharedImages.end() != shared &&
+         NULL != shared->second.Scalars.GetPointer() &&
+         shared->second.ModifiedTime == info.st_mtime &&
+         shared->second.Size == info.st_size;
+}
+
+//-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-
+void vtkImageDataCache::SetMemoryBudget( const unsigned long megabytes )
+{
+  std::lock_guard< std::mutex > lock( cacheMutex );
+  budgetKilobytes = megabytes * 1024;
+  trimCache();
+}
+
+//-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-
+unsigned long vtkImageDataCache::GetMemoryBudget()
+{
+  std::lock_guard< std::mutex > lock( cacheMutex );
+  return budgetKilobytes / 1024;
+}
+
+//-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-
+void vtkImageDataCache::Clear()
+{
+  std::lock_guard< std::mutex > lock( cacheMutex );
+  cache.clear();
+  useList.clear();
+  sharedImages.clear();
+  decodedImages.clear();
+  usedKilobytes = 0;
+}
+
+//-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-
+void vtkImageDataCache::LoadInBackground( const std::string& fileName )
+{
+  preloadQueue.Push( fileName );
+}
+
+//-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-
+void vtkImageDataCache::Stop()
+{
+  preloadQueue.Stop();
+}
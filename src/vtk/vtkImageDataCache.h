@@ -0,0 +1,100 @@
+/*=========================================================================
+
+  Module:    vtkImageDataCache.h
+  Program:   Alder (CLSA Medical Image Quality Assessment Tool)
+  Language:  C++
+  Author:    Patrick Emond <emondpd AT mcmaster DOT ca>
+  Author:    Dean Inglis <inglisd AT mcmaster DOT ca>
+
+=========================================================================*/
+
+/**
+ * @class vtkImageDataCache
+ *
+ * @author Patrick Emond <emondpd AT mcmaster DOT ca>
+ * @author Dean Inglis <inglisd AT mcmaster DOT ca>
+ *
+ * @brief Process-wide cache of decoded images.
+ *
+ * Decoding an image file (especially a cineloop) takes far longer than
+ * displaying it, so the most recently loaded images are kept in memory, up
+ * to a budget of decoded bytes.  Images are identified by file name and are
+ * decoded again if their file has been modified since.  The least recently
+ * used images are dropped once the budget is exceeded.
+ *
+ * Images are handed out as shallow copies, so the cache and all viewers
+ * showing an image share its pixel data, which must not be modified.  The
+ * cache also remembers every image it has loaded without keeping its pixels
+ * (a weak reference to its data array), so an image which has been dropped
+ * from the cache, or never fit in it, is still shared rather than decoded
+ * again while any viewer is showing it.  A large image (a DEXA whole body
+ * scan or a cineloop) is therefore only in memory once however many viewers
+ * show it.
+ *
+ * A viewer showing the first frames of a cineloop as they are decoded (see
+ * vtkDICOMFrameReader) has the whole cineloop decoded in the background by
+ * LoadInBackground() and switches to it once Contains() says it is ready.
+ */
+#ifndef __vtkImageDataCache_h
+#define __vtkImageDataCache_h
+
+#include <string>
+
+class vtkImageData;
+class vtkMedicalImageProperties;
+
+class vtkImageDataCache
+{
+public:
+  /**
+   * Shallow copies the decoded image in a file (and its medical image
+   * properties, if requested) into the given objects, reading the file
+   * with vtkImageDataReader only if it isn't in the cache.
+   * Returns false if the file can't be read.
+   */
+  static bool Load( const std::string& fileName, vtkImageData* image,
+    vtkMedicalImageProperties* properties = NULL );
+
+  /**
+   * Returns whether the decoded image in a file is in the cache, is still
+   * in use by another image (see Load()) or was decoded in the background,
+   * and the file hasn't been modified since it was decoded.  In all of these
+   * cases Load() doesn't decode the file again.
+   */
+  static bool Contains( const std::string& fileName );
+
+  /**
+   * Queues a file to be decoded by a background thread.  The image is kept
+   * apart from the cache, even if it doesn't fit in the budget, until Load()
+   * picks it up (and shares and caches it) or two more files have been
+   * decoded in the background.  Load() must only be called by one thread.
+   */
+  static void LoadInBackground( const std::string& fileName );
+
+  /**
+   * Stops the background thread after the file it is loading, discarding
+   * the files still queued.  Must be called before the program exits.
+   */
+  static void Stop();
+
+  //@{
+  /**
+   * Set/Get the number of megabytes of decoded images to keep in memory
+   * (default 512, 0 disables the cache).
+   */
+  static void SetMemoryBudget( const unsigned long megabytes );
+  static unsigned long GetMemoryBudget();
+  //@}
+
+  /**
+   * Drops all images from the cache.
+   */
+  static void Clear();
+
+private:
+  vtkImageDataCache();  /** Not implemented. */
+  vtkImageDataCache( const vtkImageDataCache& );  /** Not implemented. */
+  void operator=( const vtkImageDataCache& );  /** Not implemented. */
+};
+
+#endif
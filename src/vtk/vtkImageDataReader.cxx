@@ -9,11 +9,16 @@
 =========================================================================*/
 #include "vtkImageDataReader.h"
 
+#include "DicomMetadata.h"
 #include "Utilities.h"
 
 #include "vtkBMPReader.h"
+#include "vtkDICOMFrameReader.h"
+#include "vtkDecodedImageCache.h"
+#include "vtkFieldData.h"
 #include "vtkGDCMImageReader.h"
 #include "vtkGESignaReader.h"
+#include "vtkIdTypeArray.h"
 #include "vtkImageData.h"
 #include "vtkJPEGReader.h"
 #include "vtkMedicalImageProperties.h"
@@ -23,18 +28,205 @@
 #include "vtkObjectFactory.h"
 #include "vtkPNGReader.h"
 #include "vtkPNMReader.h"
+#include "vtkPointData.h"
 #include "vtkSLCReader.h"
 #include "vtkStringArray.h"
 #include "vtkTIFFReader.h"
+#include "vtkUnsignedCharArray.h"
 #include "vtkXMLImageDataReader.h"
 
-#include "gdcmImageReader.h"
-#include "gdcmDirectoryHelper.h"
-
+#include <algorithm>
+#include <cstring>
+#include <fstream>
 #include <sstream>
 #include <stdexcept>
 
+namespace
+{
+  // the first bytes of a file, enough to hold the DICOM preamble and prefix
+  const std::string::size_type HeaderLength = 132;
+
+  bool isDICOM( const std::string &header )
+  {
+    // a preamble followed by "DICM", or a bare data set starting with group 0002 or 0008
+    return ( HeaderLength <= header.length() && 0 == header.compare( 128, 4, "DICM" ) ) ||
+           ( 4 <= header.length() && '\0' == header[1] &&
+             ( '\x02' == header[0] || '\x08' == header[0] ) );
+  }
+
+  bool isBMP( const std::string &header ) { return 0 == header.compare( 0, 2, "BM" ); }
+  bool isGESigna( const std::string &header ) { return 0 == header.compare( 0, 4, "IMGF" ); }
+  bool isJPEG( const std::string &header ) { return 0 == header.compare( 0, 3, "\xff\xd8\xff" ); }
+  bool isPNG( const std::string &header ) { return 0 == header.compare( 0, 8, "\x89PNG\r\n\x1a\n" ); }
+  bool isSLC( const std::string &header ) { return 0 == header.compare( 0, 5, "11111" ); }
+  bool isVTI( const std::string &header )
+  {
+    return 0 == header.compare( 0, 5, "<?xml" ) || 0 == header.compare( 0, 8, "<VTKFile" );
+  }
+
+  bool isMINC( const std::string &header )
+  {
+    // MINC 1 files are NetCDF files and MINC 2 files are HDF5 files
+    return 0 == header.compare( 0, 4, std::string( "CDF\x01", 4 ) ) ||
+           0 == header.compare( 0, 4, std::string( "CDF\x02", 4 ) ) ||
+           0 == header.compare( 0, 8, "\x89HDF\r\n\x1a\n" );
+  }
+
+  bool isPNM( const std::string &header )
+  {
+    return 2 <= header.length() && 'P' == header[0] && '1' <= header[1] && '6' >= header[1];
+  }
+
+  bool isTIFF( const std::string &header )
+  {
+    return 0 == header.compare( 0, 4, std::string( "II*\0", 4 ) ) ||
+           0 == header.compare( 0, 4, std::string( "MM\0*", 4 ) );
+  }
+
+  template< class T > vtkAlgorithm* createReader() { return T::New(); }
+
+  // a file format which can be read, along with how to recognize it and create its reader
+  struct ReaderFormat
+  {
+    const char *Name;
+    const char *Extensions; // lower case, each followed by a space
+    bool ( *Sniff )( const std::string &header ); // NULL when the format has no magic number
+    vtkAlgorithm* ( *Create )();
+  };
+
+  // DICOM comes first so that it is tried first when the extension doesn't identify the file
+  const ReaderFormat readerRegistry[] = {
+    { "DICOM", ".dcm .dicom ", &isDICOM, &createReader< vtkGDCMImageReader > },
+    { "BMP", ".bmp ", &isBMP, &createReader< vtkBMPReader > },
+    { "GESigna", ".mr .ct ", &isGESigna, &createReader< vtkGESignaReader > },
+    { "JPEG", ".jpeg .jpg ", &isJPEG, &createReader< vtkJPEGReader > },
+    { "MetaImage", ".mhd .mha ", NULL, &createReader< vtkMetaImageReader > },
+    { "MINC", ".mnc ", &isMINC, &createReader< vtkMINCImageReader > },
+    { "PNG", ".png ", &isPNG, &createReader< vtkPNGReader > },
+    { "PNM", ".pnm .pgm .ppm ", &isPNM, &createReader< vtkPNMReader > },
+    { "SLC", ".slc ", &isSLC, &createReader< vtkSLCReader > },
+    { "TIFF", ".tif .tiff ", &isTIFF, &createReader< vtkTIFFReader > },
+    { "VTI", ".vti ", &isVTI, &createReader< vtkXMLImageDataReader > }
+  };
+
+  // returns the format of a file, or NULL if it can't be read, only opening the file once
+  const ReaderFormat* findReaderFormat( const std::string fileName )
+  {
+    std::ifstream file( fileName.c_str(), std::ios::binary );
+    if( !file.is_open() ) return NULL;
+    char buffer[HeaderLength];
+    file.read( buffer, HeaderLength );
+    std::string header( buffer, file.gcount() );
+    if( header.empty() ) return NULL;
+
+    const int count = sizeof( readerRegistry ) / sizeof( ReaderFormat );
+    std::string extension =
+      Alder::Utilities::toLower( Alder::Utilities::getFileExtension( fileName ) ) + " ";
+
+    // trust the extension as long as the contents agree with it
+    for( int i = 0; i < count; ++i )
+    {
+      const ReaderFormat &format = readerRegistry[i];
+      if( 1 < extension.length() && std::string::npos != std::string( format.Extensions ).find( extension ) &&
+          ( NULL == format.Sniff || format.Sniff( header ) ) ) return &format;
+    }
+
+    // otherwise go by the contents alone
+    for( int i = 0; i < count; ++i )
+    {
+      const ReaderFormat &format = readerRegistry[i];
+      if( NULL != format.Sniff && format.Sniff( header ) ) return &format;
+    }
+
+    return NULL;
+  }
+
+  // the largest share of a grayscale image's pixels which may be colored (the annotations drawn
+  // over it), images with more color than this are left as they are
+  const double MaximumColorFraction = 0.05;
+
+  // returns the number of pixels of an RGB image which aren't gray, stopping once the count is
+  // over the given maximum (the inner loop has no branches so that the compiler vectorizes it)
+  vtkIdType countColorPixels( const unsigned char *pixels, const vtkIdType count, const vtkIdType maximum )
+  {
+    const vtkIdType block = 65536;
+    vtkIdType colored = 0;
+    for( vtkIdType start = 0; start < count && colored <= maximum; start += block )
+    {
+      const unsigned char *p = pixels + 3 * start;
+      const vtkIdType end = std::min( block, count - start );
+      int blockColored = 0;
+      for( vtkIdType i = 0; i < end; ++i )
+        blockColored += ( p[3 * i] != p[3 * i + 1] ) | ( p[3 * i + 1] != p[3 * i + 2] );
+      colored += blockColored;
+    }
+    return colored;
+  }
+
+  // returns the luminance of an RGB image along with a sparse overlay of its colored pixels, or
+  // NULL if the image isn't RGB or has too many colored pixels
+  vtkSmartPointer< vtkImageData > reduceGrayscaleRGB( vtkImageData *image )
+  {
+    vtkDataArray *scalars = image->GetPointData()->GetScalars();
+    if( NULL == scalars || VTK_UNSIGNED_CHAR != scalars->GetDataType() ||
+        3 != scalars->GetNumberOfComponents() ) return NULL;
+
+    const vtkIdType count = scalars->GetNumberOfTuples();
+    const unsigned char *pixels = static_cast< const unsigned char* >( scalars->GetVoidPointer( 0 ) );
+    const vtkIdType maximum = static_cast< vtkIdType >( MaximumColorFraction * count );
+    const vtkIdType colored = countColorPixels( pixels, count, maximum );
+    if( 0 == count || maximum < colored ) return NULL;
+
+    // the luminance of gray pixels is any of their components, colored pixels are drawn over
+    vtkSmartPointer< vtkUnsignedCharArray > luminance = vtkSmartPointer< vtkUnsignedCharArray >::New();
+    luminance->SetNumberOfTuples( count );
+    unsigned char *output = luminance->GetPointer( 0 );
+    for( vtkIdType i = 0; i < count; ++i )
+      output[i] = ( 77 * pixels[3 * i] + 150 * pixels[3 * i + 1] + 29 * pixels[3 * i + 2] ) >> 8;
+
+    vtkSmartPointer< vtkImageData > reduced = vtkSmartPointer< vtkImageData >::New();
+    reduced->SetExtent( image->GetExtent() );
+    reduced->SetWholeExtent( image->GetExtent() );
+    reduced->SetSpacing( image->GetSpacing() );
+    reduced->SetOrigin( image->GetOrigin() );
+    reduced->SetScalarType( VTK_UNSIGNED_CHAR );
+    reduced->SetNumberOfScalarComponents( 1 );
+    reduced->GetPointData()->SetScalars( luminance );
+
+    if( 0 < colored )
+    {
+      vtkSmartPointer< vtkIdTypeArray > ids = vtkSmartPointer< vtkIdTypeArray >::New();
+      ids->SetName( vtkImageDataReader::ColorOverlayIdsName );
+      ids->SetNumberOfTuples( colored );
+      vtkSmartPointer< vtkUnsignedCharArray > colors = vtkSmartPointer< vtkUnsignedCharArray >::New();
+      colors->SetName( vtkImageDataReader::ColorOverlayColorsName );
+      colors->SetNumberOfComponents( 3 );
+      colors->SetNumberOfTuples( colored );
+
+      vtkIdType index = 0;
+      for( vtkIdType i = 0; i < count; ++i )
+      {
+        const unsigned char *p = pixels + 3 * i;
+        if( p[0] != p[1] || p[1] != p[2] )
+        {
+          ids->SetValue( index, i );
+          memcpy( colors->GetPointer( 3 * index ), p, 3 );
+          index++;
+        }
+      }
+
+      reduced->GetFieldData()->AddArray( ids );
+      reduced->GetFieldData()->AddArray( colors );
+    }
+
+    return reduced;
+  }
+}
+
 vtkStandardNewMacro( vtkImageDataReader );
+
+const char* const vtkImageDataReader::ColorOverlayIdsName = "ColorOverlayIds";
+const char* const vtkImageDataReader::ColorOverlayColorsName = "ColorOverlayColors";
 vtkCxxSetObjectMacro( vtkImageDataReader, Reader, vtkAlgorithm );
 
 //-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-
@@ -42,6 +234,7 @@ vtkImageDataReader::vtkImageDataReader()
 {
   this->Reader = NULL;
   this->MedicalImageProperties = vtkSmartPointer<vtkMedicalImageProperties>::New();
+  this->ReduceGrayscaleRGB = 1;
 }
 
 //-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-
@@ -59,8 +252,7 @@ vtkMedicalImageProperties* vtkImageDataReader::GetMedicalImageProperties()
 //-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-
 void vtkImageDataReader::SetFileName( const char* fileName )
 {
-  std::string fileExtension, filePath, fileNameOnly, 
-    fileNameStr( fileName );
+  std::string fileNameStr( NULL == fileName ? "" : fileName );
 
   if( this->FileName.empty() && fileName == NULL )
   {
@@ -99,248 +291,34 @@ void vtkImageDataReader::SetFileName( const char* fileName )
     throw std::runtime_error( error.str() );
   }
 
-  fileExtension = Alder::Utilities::getFileExtension( this->FileName );
-  fileNameOnly = Alder::Utilities::getFilenameName( this->FileName );
-  
-  // need an instance of all readers to scan valid extensions
-  vtkSmartPointer< vtkBMPReader > BMPReader = vtkSmartPointer< vtkBMPReader >::New();
-  vtkSmartPointer< vtkGDCMImageReader > GDCMImageReader = vtkSmartPointer< vtkGDCMImageReader >::New();
-  vtkSmartPointer< vtkGESignaReader > GESignaReader = vtkSmartPointer< vtkGESignaReader >::New();
-  vtkSmartPointer< vtkJPEGReader > JPEGReader = vtkSmartPointer< vtkJPEGReader >::New();
-  vtkSmartPointer< vtkMetaImageReader > MetaImageReader = vtkSmartPointer< vtkMetaImageReader >::New();
-  vtkSmartPointer< vtkMINCImageReader > MINCImageReader = vtkSmartPointer< vtkMINCImageReader >::New();
-  vtkSmartPointer< vtkPNGReader > PNGReader = vtkSmartPointer< vtkPNGReader >::New();
-  vtkSmartPointer< vtkPNMReader > PNMReader = vtkSmartPointer< vtkPNMReader >::New();
-  vtkSmartPointer< vtkSLCReader > SLCReader = vtkSmartPointer< vtkSLCReader >::New();
-  vtkSmartPointer< vtkTIFFReader > TIFFReader = vtkSmartPointer< vtkTIFFReader >::New();
-  vtkSmartPointer< vtkXMLImageDataReader > XMLImageDataReader =
-    vtkSmartPointer< vtkXMLImageDataReader >::New();
-
-  // search through each reader to see which 'likes' the file extension
-
-  if( std::string::npos != Alder::Utilities::toLower(
-        GDCMImageReader->GetFileExtensions() ).find( fileExtension ) )
-  { // DICOM
-    this->SetReader( GDCMImageReader );
-  }
-  else if( GDCMImageReader->CanReadFile( this->FileName.c_str() ) )
-  {
-    this->SetReader( GDCMImageReader );
-  }
-  else if( std::string::npos != Alder::Utilities::toLower(
-    BMPReader->GetFileExtensions() ).find( fileExtension ) )
-  { // BMP
-    if( BMPReader->CanReadFile( this->FileName.c_str() ) )
-    {
-      this->SetReader( BMPReader );
-    }
-  }
-  else if( std::string::npos != Alder::Utilities::toLower(
-    GESignaReader->GetFileExtensions() ).find( fileExtension ) )
-  { // GESigna file
-    if( GESignaReader->CanReadFile( this->FileName.c_str() ) )
-    {
-      this->SetReader( GESignaReader );
-    }
-  }
-  else if( std::string::npos != Alder::Utilities::toLower(
-    JPEGReader->GetFileExtensions() ).find( fileExtension ) )
-  { // JPEG file
-    if( JPEGReader->CanReadFile( this->FileName.c_str() ) )
-    {
-      this->SetReader( JPEGReader );
-    }
-  }
-  else if( std::string::npos != Alder::Utilities::toLower(
-    MetaImageReader->GetFileExtensions() ).find( fileExtension ) )
-  { // MetaImage file
-    if( MetaImageReader->CanReadFile( this->FileName.c_str() ) )
-    {
-      this->SetReader( MetaImageReader );
-    }
-  }
-  else if( std::string::npos != Alder::Utilities::toLower(
-    MINCImageReader->GetFileExtensions() ).find( fileExtension ) )
-  { // MINCImage file
-    if( MINCImageReader->CanReadFile( this->FileName.c_str() ) )
-    {
-      this->SetReader( MINCImageReader );
-    }
-  }
-  else if( std::string::npos != Alder::Utilities::toLower(
-    PNGReader->GetFileExtensions() ).find( fileExtension ) )
-  { // PNG file
-    if( PNGReader->CanReadFile( this->FileName.c_str() ) )
-    {
-      this->SetReader( PNGReader );
-    }
-  }
-  else if( std::string::npos != Alder::Utilities::toLower(
-    PNMReader->GetFileExtensions() ).find( fileExtension ) )
-  { // PNM file
-    if( PNMReader->CanReadFile( this->FileName.c_str() ) )
-    {
-      this->SetReader( PNMReader );
-    }
-  }
-  else if( std::string::npos != Alder::Utilities::toLower(
-    SLCReader->GetFileExtensions() ).find( fileExtension ) )
-  { // SLC file
-    if( SLCReader->CanReadFile( this->FileName.c_str() ) )
-    {
-      this->SetReader( SLCReader );
-    }
-  }
-  else if( std::string::npos != Alder::Utilities::toLower(
-    TIFFReader->GetFileExtensions() ).find( fileExtension ) )
-  { // TIFF file
-    if( TIFFReader->CanReadFile( this->FileName.c_str() ) )
-    {
-      this->SetReader( TIFFReader );
-    }
-  }
-  else if( fileExtension == ".vti" ) // no GetFileExtensions() method
-  { // VTI file
-    if( XMLImageDataReader->CanReadFile( this->FileName.c_str() ) )
-    {
-      this->SetReader( XMLImageDataReader );
-    }
-  }
-  else // don't know how to handle this file, set the reader to NULL and
-       // mark the file type as unknown
+  // build only the reader which the file's extension and contents call for
+  const ReaderFormat *format = findReaderFormat( this->FileName );
+  if( NULL == format )
   {
     this->SetReader( NULL );
     std::stringstream error;
-    error << "Unable to read '" << fileNameOnly << "', unknown file type.";
+    error << "Unable to read '" << Alder::Utilities::getFilenameName( this->FileName )
+          << "', unknown file type.";
     throw std::runtime_error( error.str() );
   }
+
+  vtkAlgorithm *reader = format->Create();
+  this->SetReader( reader );
+  reader->Delete();
 }
 
 //-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-
 bool vtkImageDataReader::IsValidFileName( const char* fileName )
 {
-  if( fileName == NULL || !Alder::Utilities::fileExists( fileName ) )
-  {
-    return false;
-  }
-
-  bool knownFileType = false;
-  std::string fileExtension;
-
-  // ok, we have a valid file or directory name, get some details
-  fileExtension = Alder::Utilities::getFileExtension(
-    Alder::Utilities::toLower( fileName ) );
-
-  // we need an instance of all readers so we can scan extensions
-  vtkNew< vtkBMPReader > BMPReader;
-  vtkNew< vtkGDCMImageReader > GDCMImageReader;
-  vtkNew< vtkGESignaReader > GESignaReader;
-  vtkNew< vtkJPEGReader > JPEGReader;
-  vtkNew< vtkMetaImageReader > MetaImageReader;
-  vtkNew< vtkMINCImageReader > MINCImageReader;
-  vtkNew< vtkPNGReader > PNGReader;
-  vtkNew< vtkPNMReader > PNMReader;
-  vtkNew< vtkSLCReader > SLCReader;
-  vtkNew< vtkTIFFReader > TIFFReader;
-  vtkNew< vtkXMLImageDataReader > XMLImageDataReader;
-
-  // now search through each reader to see which 'likes' the file extension
-  if( std::string::npos != Alder::Utilities::toLower(
-        GDCMImageReader->GetFileExtensions() ).find( fileExtension ) )
-  { // DICOM
-    if( GDCMImageReader->CanReadFile( fileName ) )
-    {
-      knownFileType = true;
-    }  
-  }
-  else if( std::string::npos != Alder::Utilities::toLower(
-    BMPReader->GetFileExtensions() ).find( fileExtension ) )
-  { // BMP
-    if( BMPReader->CanReadFile( fileName ) )
-    {
-      knownFileType = true;
-    }
-  }
-  else if( std::string::npos != Alder::Utilities::toLower(
-    GESignaReader->GetFileExtensions() ).find( fileExtension ) )
-  { // GESigna file
-    if( GESignaReader->CanReadFile( fileName ) )
-    {
-      knownFileType = true;
-    }
-  }
-  else if( std::string::npos != Alder::Utilities::toLower(
-    JPEGReader->GetFileExtensions() ).find( fileExtension ) )
-  { // JPEG file
-    if( JPEGReader->CanReadFile( fileName ) )
-    {
-      knownFileType = true;
-    }
-  }
-  else if( std::string::npos != Alder::Utilities::toLower(
-    MetaImageReader->GetFileExtensions() ).find( fileExtension ) )
-  { // MetaImage file
-    if( MetaImageReader->CanReadFile( fileName ) )
-    {
-      knownFileType = true;
-    }
-  }
-  else if( std::string::npos != Alder::Utilities::toLower(
-    MINCImageReader->GetFileExtensions() ).find( fileExtension ) )
-  { // MINCImage file
-    if( MINCImageReader->CanReadFile( fileName ) )
-    {
-      knownFileType = true;
-    }
-  }
-  else if( std::string::npos != Alder::Utilities::toLower(
-    PNGReader->GetFileExtensions() ).find( fileExtension ) )
-  { // PNG file
-    if( PNGReader->CanReadFile( fileName ) )
-    {
-      knownFileType = true;
-    }
-  }
-  else if( std::string::npos != Alder::Utilities::toLower(
-    PNMReader->GetFileExtensions() ).find( fileExtension ) )
-  { // PNM file
-    if( PNMReader->CanReadFile( fileName ) )
-    {
-      knownFileType = true;
-    }
-  }
-  else if( std::string::npos != Alder::Utilities::toLower(
-    SLCReader->GetFileExtensions() ).find( fileExtension ) )
-  { // SLC file
-    if( SLCReader->CanReadFile( fileName ) )
-    {
-      knownFileType = true;
-    }
-  }
-  else if( std::string::npos != Alder::Utilities::toLower(
-    TIFFReader->GetFileExtensions() ).find( fileExtension ) )
-  { // TIFF file
-    if( TIFFReader->CanReadFile( fileName ) )
-    {
-      knownFileType = true;
-    }
-  }
-  else if( fileExtension == ".vti" ) // no GetFileExtensions() method
-  { // VTI file
-    if( XMLImageDataReader->CanReadFile( fileName ) )
-    {
-      knownFileType = true;
-    }
-  }
-  else // last ditch effort to read a dicom
-  {
-    if( GDCMImageReader->CanReadFile( fileName ) )
-    {
-      knownFileType = true;
-    }
-  }
+  return NULL != fileName && NULL != findReaderFormat( fileName );
+}
 
-  return knownFileType;
+//-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-
+bool vtkImageDataReader::HasColorOverlay( vtkImageData* image )
+{
+  return NULL != image && NULL != image->GetFieldData() &&
+         NULL != image->GetFieldData()->GetArray( vtkImageDataReader::ColorOverlayIdsName ) &&
+         NULL != image->GetFieldData()->GetArray( vtkImageDataReader::ColorOverlayColorsName );
 }
 
 //-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-
@@ -351,10 +329,10 @@ vtkImageData* vtkImageDataReader::GetOutputAsNewInstance()
 
   if( image )
   {
-    // create a copy of the image
+    // create a copy of the image which shares its pixels (they are never copied)
     // this copy MUST be deleted by the caller of this method
     newImage = image->NewInstance();
-    newImage->DeepCopy( image );
+    newImage->ShallowCopy( image );
   }
 
   return newImage;
@@ -363,7 +341,6 @@ vtkImageData* vtkImageDataReader::GetOutputAsNewInstance()
 //-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-
 vtkImageData* vtkImageDataReader::GetOutput()
 {
-  std::string fileNameOnly;
   vtkXMLImageDataReader* XMLReader = NULL;
   vtkGDCMImageReader* gdcmReader = NULL;
   vtkImageReader2* imageReader = NULL;
@@ -376,9 +353,6 @@ vtkImageData* vtkImageDataReader::GetOutput()
     return NULL;
   }
 
-  // we might need this
-  fileNameOnly = Alder::Utilities::getFilenameName( this->FileName );
-
   // Ok, we have a valid file and reader, process based on reader type
   if( this->Reader->IsA( "vtkXMLImageDataReader" ) )
   {
@@ -392,14 +366,7 @@ vtkImageData* vtkImageDataReader::GetOutput()
     }
     else // this reader is not up to date, re-read the file
     {
-      // check that we can read the file
-      if( !XMLReader->CanReadFile( this->FileName.c_str() ) )
-      {
-        std::stringstream error;
-        error << "Unable to read '" << fileNameOnly << "' as a VTI file.";
-        throw std::runtime_error( error.str() );
-      }
-
+      // the file's contents were checked when the reader was chosen (see SetFileName)
       XMLReader->SetFileName( this->FileName.c_str() );
 
       // get a reference to the (updated) output image
@@ -414,20 +381,57 @@ vtkImageData* vtkImageDataReader::GetOutput()
     // see if we have already read the data from the disk, and return it if we have
     if( this->ReadMTime >= this->GetMTime() )
     {
-      image = gdcmReader->GetOutput();
+      if( this->ReducedImage ) image = this->ReducedImage;
+      else if( this->MappedImage ) image = this->MappedImage;
+      else if( this->FrameReader ) image = this->FrameReader->GetOutput();
+      else image = gdcmReader->GetOutput();
     }
     else
     {
+      // pixels which were decoded before are mapped from the decoded image cache instead and
+      // the frames of compressed cineloops are decoded in parallel, in either case only the
+      // header is read by the GDCM reader (for the medical image properties)
+      // (the cache holds images already reduced to luminance, so it is only used when they are)
       gdcmReader->SetFileName( this->FileName.c_str() );
-      gdcmReader->Update();
-      image = gdcmReader->GetOutput();
+      this->MappedImage = vtkSmartPointer< vtkImageData >::New();
+      this->FrameReader = NULL;
+      if( this->ReduceGrayscaleRGB && vtkDecodedImageCache::Load( this->FileName, this->MappedImage ) )
+      {
+        gdcmReader->UpdateInformation();
+        image = this->MappedImage;
+      }
+      else if( this->ReadFrames() )
+      {
+        this->MappedImage = NULL;
+        gdcmReader->UpdateInformation();
+        image = this->FrameReader->GetOutput();
+      }
+      else
+      {
+        this->MappedImage = NULL;
+        gdcmReader->Update();
+        image = gdcmReader->GetOutput();
+
+        if( !image )
+        {
+          std::stringstream error;
+          error << "Failed to read dicom file '"
+                   << this->FileName << "'.";
+          throw std::runtime_error( error.str() );
+        }
+      }
 
-      if( !image )
+      // keep only the luminance (and color overlay) of grayscale images stored in color,
+      // releasing the color pixels (mapped images were reduced before they were cached, and
+      // reducing them again would replace the mapping with a copy)
+      this->ReducedImage = NULL;
+      if( this->ReduceGrayscaleRGB && !this->MappedImage ) this->ReducedImage = reduceGrayscaleRGB( image );
+      if( this->ReducedImage )
       {
-        std::stringstream error;
-        error << "Failed to read dicom file '"
-                 << this->FileName << "'.";
-        throw std::runtime_error( error.str() );
+        image = this->ReducedImage;
+        this->MappedImage = NULL;
+        this->FrameReader = NULL;
+        gdcmReader->GetOutput()->ReleaseData();
       }
     }
   }
@@ -439,19 +443,7 @@ vtkImageData* vtkImageDataReader::GetOutput()
     // if this reader is not up to date, re-read the file
     if( this->ReadMTime < this->GetMTime() )
     {
-      // the GDCM reader has not implemented CanReadFile, so skip that check
-      if( !imageReader->IsA( "vtkGDCMImageReader" ) )
-      {
-        // check that we can read the file
-        if( !imageReader->CanReadFile( this->FileName.c_str() ) )
-        {
-          std::stringstream error;
-          error << "Unable to read '" << fileNameOnly << "' as a ";
-          error << imageReader->GetDescriptiveName() << " file.";
-          throw std::runtime_error( error.str() );
-        }
-      }
-
+      // the file's contents were checked when the reader was chosen (see SetFileName)
       imageReader->SetFileName( this->FileName.c_str() );
 
       // get a reference to the (updated) output image
@@ -482,32 +474,48 @@ vtkImageData* vtkImageDataReader::GetOutput()
     vtkGDCMImageReader* imageReader = vtkGDCMImageReader::SafeDownCast( this->Reader );
     this->MedicalImageProperties->DeepCopy( imageReader->GetMedicalImageProperties() );
     
-    gdcm::ImageReader reader;
-    reader.SetFileName( imageReader->GetFileName() );
-    reader.Read();
-    const gdcm::File &file = reader.GetFile();
-    const gdcm::DataSet &ds = file.GetDataSet();
-    
-    std::map< std::string, gdcm::Tag > dicomMap;
-    dicomMap["AcquisitionDateTime"] = gdcm::Tag( 0x0008, 0x002a );
-    dicomMap["SeriesNumber"] = gdcm::Tag( 0x0020, 0x0011 );
-    dicomMap["CineRate"] = gdcm::Tag( 0x0018, 0x0040 );
-    dicomMap["RecommendedDisplayFrameRate"] = gdcm::Tag( 0x0008, 0x2114 );
-    
+    // the header has usually been parsed already, in which case the file isn't read again
+    std::shared_ptr< const Alder::DicomMetadata > metadata =
+      Alder::DicomMetadata::GetInstance( this->FileName );
+
+    std::map< std::string, std::pair< uint16_t, uint16_t > > dicomMap;
+    dicomMap["AcquisitionDateTime"] = std::make_pair( 0x0008, 0x002a );
+    dicomMap["SeriesNumber"] = std::make_pair( 0x0020, 0x0011 );
+    dicomMap["CineRate"] = std::make_pair( 0x0018, 0x0040 );
+    dicomMap["RecommendedDisplayFrameRate"] = std::make_pair( 0x0008, 0x2114 );
+
     for( auto it = dicomMap.cbegin(); it != dicomMap.cend(); ++it )
     {
-      if( ds.FindDataElement( it->second ) )
+      if( metadata->HasValue( it->second.first, it->second.second ) )
       {
         this->MedicalImageProperties->AddUserDefinedValue( it->first.c_str(),
-          gdcm::DirectoryHelper::GetStringValueFromTag( it->second, ds ).c_str() );
+          metadata->GetValue( it->second.first, it->second.second ).c_str() );
       }
-    }  
+    }
   }
 
   this->ReadMTime.Modified();
   return image;
 }
 
+//-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-
+bool vtkImageDataReader::ReadFrames()
+{
+  if( !vtkDICOMFrameReader::CanReadFile( this->FileName ) ) return false;
+
+  vtkSmartPointer< vtkDICOMFrameReader > reader = vtkSmartPointer< vtkDICOMFrameReader >::New();
+  reader->SetFileName( this->FileName );
+  reader->UpdateInformation();
+  if( 0 == reader->GetNumberOfFrames() ) return false;
+
+  reader->GetOutput()->SetUpdateExtentToWholeExtent();
+  reader->Update();
+  if( 0 == reader->GetOutput()->GetNumberOfPoints() ) return false;
+
+  this->FrameReader = reader;
+  return true;
+}
+
 //-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-
 void vtkImageDataReader::PrintSelf( ostream& os, vtkIndent indent )
 {
@@ -19,11 +19,21 @@
  * In order to simplify the process of opening ImageData from disk this
  * class wraps all image reader classes that extend vtkImageReader2, such
  * as vtkJPEGReader, vtkPNGReader vtkXMLImageDataReader, etc.  The type of
- * reader used is determined by file extension.  This class also supports
- * VTK's XML image format using vtkXMLImageDataReader which it identifies
- * by the extension .vti
+ * reader used is determined by file extension, as long as the magic number
+ * at the start of the file agrees with it, otherwise by the magic number
+ * alone.  Only the chosen reader is created and the file is only opened
+ * once to choose it.  This class also supports VTK's XML image format using
+ * vtkXMLImageDataReader which it identifies by the extension .vti
  *
- * GDCM's reader is used instead of VTK's native DICOM reader.
+ * GDCM's reader is used instead of VTK's native DICOM reader.  The frames
+ * of compressed cineloops are decoded in parallel by vtkDICOMFrameReader.
+ *
+ * Ultrasound images are usually stored in color even though only the
+ * annotations drawn over them are colored.  Unless ReduceGrayscaleRGB is
+ * turned off, DICOM images whose pixels are nearly all gray are reduced to
+ * one component (luminance), a third of their size, and the few colored
+ * pixels are kept as a sparse color overlay in the image's field data (see
+ * HasColorOverlay()) which vtkImageWindowLevel draws over the luminance.
  */
 #ifndef __vtkImageDataReader_h
 #define __vtkImageDataReader_h
@@ -33,6 +43,7 @@
 #include "vtkTimeStamp.h"
 
 class vtkAlgorithm;
+class vtkDICOMFrameReader;
 class vtkImageData;
 class vtkMedicalImageProperties;
 
@@ -64,7 +75,8 @@ public:
    * Creates a new instance of a vtkImageData object created by opening
    * the current FileName and returns it.  A reference to this object is
    * not kept and it is up to the caller of this method to delete the
-   * object.
+   * object.  The new image shares the reader's pixel data (the data array is
+   * reference counted, not copied) so it must not be modified.
    */
   vtkImageData* GetOutputAsNewInstance();
 
@@ -85,6 +97,32 @@ public:
    */
   vtkMedicalImageProperties* GetMedicalImageProperties();
 
+  //@{
+  /**
+   * Set/Get whether DICOM images stored in color whose pixels are nearly all
+   * gray are reduced to luminance and a color overlay (default on).
+   */
+  vtkSetMacro( ReduceGrayscaleRGB, int );
+  vtkGetMacro( ReduceGrayscaleRGB, int );
+  vtkBooleanMacro( ReduceGrayscaleRGB, int );
+  //@}
+
+  //@{
+  /**
+   * The names of the field data arrays holding the color overlay of a
+   * reduced image: the ids of its colored points (in increasing order) and
+   * their RGB colors.
+   */
+  static const char* const ColorOverlayIdsName;
+  static const char* const ColorOverlayColorsName;
+  //@}
+
+  /**
+   * Returns whether an image is the luminance of a color image with a color
+   * overlay (see ReduceGrayscaleRGB).
+   */
+  static bool HasColorOverlay( vtkImageData* image );
+
 protected:
   vtkImageDataReader();
   ~vtkImageDataReader();
@@ -99,6 +137,22 @@ protected:
   vtkAlgorithm* Reader;
   vtkTimeStamp ReadMTime;
   vtkSmartPointer<vtkMedicalImageProperties> MedicalImageProperties;
+  int ReduceGrayscaleRGB;
+
+  // the image when it was reduced to luminance and a color overlay
+  vtkSmartPointer<vtkImageData> ReducedImage;
+
+  // the image when it was mapped from the decoded image cache (see vtkDecodedImageCache)
+  vtkSmartPointer<vtkImageData> MappedImage;
+
+  // the reader of compressed cineloops, whose frames are decoded in parallel
+  vtkSmartPointer<vtkDICOMFrameReader> FrameReader;
+
+  /**
+   * Reads the current file with a vtkDICOMFrameReader if it is a compressed
+   * cineloop, returns false if it isn't or if its frames can't be read.
+   */
+  bool ReadFrames();
   
 private:
   vtkImageDataReader( const vtkImageDataReader& );  /** Not implemented. */
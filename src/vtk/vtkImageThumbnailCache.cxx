@@ -0,0 +1,164 @@
+/*=========================================================================
+
+  Module:    vtkImageThumbnailCache.cxx
+  Program:   Alder (CLSA Medical Image Quality Assessment Tool)
+  Language:  C++
+  Author:    Patrick Emond <emondpd AT mcmaster DOT ca>
+  Author:    Dean Inglis <inglisd AT mcmaster DOT ca>
+
+=========================================================================*/
+#include "vtkImageThumbnailCache.h"
+
+#include "vtkCacheDirectory.h"
+#include "vtkDataArray.h"
+#include "vtkDICOMFrameReader.h"
+#include "vtkErrorCode.h"
+#include "vtkExtractVOI.h"
+#include "vtkFileQueue.h"
+#include "vtkImageData.h"
+#include "vtkImageDataReader.h"
+#include "vtkImageResample.h"
+#include "vtkImageShiftScale.h"
+#include "vtkNew.h"
+#include "vtkPNGWriter.h"
+#include "vtkPointData.h"
+
+#include <algorithm>
+#include <stdexcept>
+#include <sys/stat.h>
+
+namespace
+{
+  // the length of a thumbnail's longest side, in pixels
+  const double ThumbnailSize = 96.0;
+
+  vtkCacheDirectory cacheDirectory( ".png" );
+
+  // thumbnails which fail to be made are simply left missing
+  vtkFileQueue thumbnailQueue(
+    []( const std::string& fileName ) { vtkImageThumbnailCache::Store( fileName ); } );
+}
+
+//-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-
+void vtkImageThumbnailCache::SetDirectory( const std::string& directory )
+{
+  cacheDirectory.SetPath( directory );
+}
+
+//-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-
+std::string vtkImageThumbnailCache::GetDirectory()
+{
+  return cacheDirectory.GetPath();
+}
+
+//-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-
+std::string vtkImageThumbnailCache::GetFileName( const std::string& fileName )
+{
+  std::string thumbnailFileName = cacheDirectory.GetFileName( fileName );
+  if( thumbnailFileName.empty() ) return "";
+
+  struct stat thumbnailInfo, info;
+  bool current = 0 == stat( thumbnailFileName.c_str(), &thumbnailInfo ) &&
+                 0 == stat( fileName.c_str(), &info ) &&
+                 thumbnailInfo.st_mtime >= info.st_mtime;
+  return current ? thumbnailFileName : "";
+}
+
+//-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-
+bool vtkImageThumbnailCache::Store( const std::string& fileName )
+{
+  std::string thumbnailFileName = cacheDirectory.GetFileName( fileName );
+  if( thumbnailFileName.empty() ) return false;
+
+  try
+  {
+    // compressed cineloops only need their middle frame decoded, other files are read whole
+    vtkNew< vtkDICOMFrameReader > frameReader;
+    vtkNew< vtkImageDataReader > reader;
+    vtkImageData *source = NULL;
+    if( vtkDICOMFrameReader::CanReadFile( fileName ) )
+    {
+      frameReader->SetFileName( fileName );
+      frameReader->UpdateInformation();
+      if( 0 < frameReader->GetNumberOfFrames() ) source = frameReader->GetOutput();
+    }
+    if( NULL == source )
+    {
+      reader->SetFileName( fileName.c_str() );
+      source = reader->GetOutput();
+      if( NULL == source ) return false;
+    }
+
+    int extent[6];
+    source->UpdateInformation();
+    source->GetWholeExtent( extent );
+    extent[4] = extent[5] = ( extent[4] + extent[5] ) / 2;
+
+    vtkNew< vtkExtractVOI > frame;
+    frame->SetInput( source );
+    frame->SetVOI( extent );
+    frame->Update();
+
+    // window the frame to its full range of values, over all components (as the viewer does)
+    vtkDataArray *scalars = frame->GetOutput()->GetPointData()->GetScalars();
+    if( NULL == scalars || 0 == scalars->GetNumberOfTuples() ) return false;
+    double minimum = scalars->GetRange( 0 )[0];
+    double maximum = scalars->GetRange( 0 )[1];
+    for( int i = 1; i < scalars->GetNumberOfComponents(); ++i )
+    {
+      minimum = std::min( minimum, scalars->GetRange( i )[0] );
+      maximum = std::max( maximum, scalars->GetRange( i )[1] );
+    }
+
+    vtkNew< vtkImageShiftScale > windowLevel;
+    windowLevel->SetInputConnection( frame->GetOutputPort() );
+    windowLevel->SetShift( -minimum );
+    windowLevel->SetScale( minimum < maximum ? 255.0 / ( maximum - minimum ) : 1.0 );
+    windowLevel->SetOutputScalarTypeToUnsignedChar();
+    windowLevel->ClampOverflowOn();
+
+    // shrink the frame so that its longest side is no longer than the thumbnail's
+    int columns = extent[1] - extent[0] + 1;
+    int rows = extent[3] - extent[2] + 1;
+    double factor = std::min( 1.0, ThumbnailSize / std::max( columns, rows ) );
+    vtkNew< vtkImageResample > resample;
+    resample->SetInputConnection( windowLevel->GetOutputPort() );
+    resample->SetDimensionality( 2 );
+    resample->SetAxisMagnificationFactor( 0, factor );
+    resample->SetAxisMagnificationFactor( 1, factor );
+    resample->SetInterpolationModeToLinear();
+
+    // the writer replaces the (empty) temporary file by name
+    return vtkCacheDirectory::Write( thumbnailFileName,
+      [&]( int, const std::string& temporary )
+      {
+        vtkNew< vtkPNGWriter > writer;
+        writer->SetInputConnection( resample->GetOutputPort() );
+        writer->SetFileName( temporary.c_str() );
+        writer->Write();
+        return vtkErrorCode::NoError == writer->GetErrorCode();
+      } );
+  }
+  catch( std::exception &e )
+  {
+    return false;
+  }
+}
+
+//-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-
+void vtkImageThumbnailCache::Enqueue( const std::string& fileName )
+{
+  if( !vtkImageThumbnailCache::GetDirectory().empty() ) thumbnailQueue.Push( fileName );
+}
+
+//-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-
+void vtkImageThumbnailCache::Flush()
+{
+  thumbnailQueue.Flush();
+}
+
+//-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-
+void vtkImageThumbnailCache::Stop()
+{
+  thumbnailQueue.Stop();
+}
@@ -0,0 +1,83 @@
+/*=========================================================================
+
+  Module:    vtkImageThumbnailCache.h
+  Program:   Alder (CLSA Medical Image Quality Assessment Tool)
+  Language:  C++
+  Author:    Patrick Emond <emondpd AT mcmaster DOT ca>
+  Author:    Dean Inglis <inglisd AT mcmaster DOT ca>
+
+=========================================================================*/
+
+/**
+ * @class vtkImageThumbnailCache
+ *
+ * @author Patrick Emond <emondpd AT mcmaster DOT ca>
+ * @author Dean Inglis <inglisd AT mcmaster DOT ca>
+ *
+ * @brief Optional on-disk cache of image thumbnails.
+ *
+ * A thumbnail is the middle frame of an image (the only frame of a still
+ * image) windowed to its full range of values, as the viewer does when an
+ * image is first shown, and reduced to at most 96 pixels on its longest
+ * side.  Thumbnails are written to a directory as small PNG files, one per
+ * image, so that the user interface can show them without decoding images.
+ *
+ * Only the middle frame of a compressed cineloop is decoded (see
+ * vtkDICOMFrameReader), so thumbnails are cheap enough to make as soon as
+ * an image has been downloaded.  They are made by a background thread
+ * (see Enqueue()) so that downloads aren't held up while they are.  A
+ * thumbnail older than its image is ignored.  The cache is disabled until
+ * a directory is set.
+ */
+#ifndef __vtkImageThumbnailCache_h
+#define __vtkImageThumbnailCache_h
+
+#include <string>
+
+class vtkImageThumbnailCache
+{
+public:
+  //@{
+  /**
+   * Set/Get the directory the cache is kept in (an empty directory, the
+   * default, disables the cache).
+   */
+  static void SetDirectory( const std::string& directory );
+  static std::string GetDirectory();
+  //@}
+
+  /**
+   * Returns the name of the thumbnail of a file, or an empty string if it
+   * has no thumbnail or the file has been modified since it was made.
+   */
+  static std::string GetFileName( const std::string& fileName );
+
+  /**
+   * Makes the thumbnail of a file, replacing any older one.  Returns false
+   * if the cache is disabled or the file can't be read.
+   */
+  static bool Store( const std::string& fileName );
+
+  /**
+   * Queues a file to have its thumbnail made by a background thread.
+   */
+  static void Enqueue( const std::string& fileName );
+
+  /**
+   * Waits until the thumbnails of every queued file have been made.
+   */
+  static void Flush();
+
+  /**
+   * Stops the background thread after the thumbnail it is making, discarding
+   * the files still queued.  Must be called before the program exits.
+   */
+  static void Stop();
+
+private:
+  vtkImageThumbnailCache();  /** Not implemented. */
+  vtkImageThumbnailCache( const vtkImageThumbnailCache& );  /** Not implemented. */
+  void operator=( const vtkImageThumbnailCache& );  /** Not implemented. */
+};
+
+#endif
@@ -10,12 +10,18 @@
 #include <vtkImageWindowLevel.h>
 
 #include <vtkDataArray.h>
+#include <vtkFieldData.h>
+#include <vtkIdTypeArray.h>
 #include <vtkImageData.h>
+#include <vtkImageDataReader.h>
 #include <vtkInformation.h>
 #include <vtkInformationVector.h>
 #include <vtkObjectFactory.h>
 #include <vtkPointData.h>
 #include <vtkScalarsToColors.h>
+#include <vtkUnsignedCharArray.h>
+
+#include <algorithm>
 
 vtkStandardNewMacro(vtkImageWindowLevel);
 
@@ -48,8 +54,9 @@ int vtkImageWindowLevel::RequestData(
     inInfo->Get(vtkDataObject::DATA_OBJECT()));
  
   // If LookupTable is null and window / level produces no change,
-  // then just pass the data
+  // then just pass the data (unless a color overlay has to be drawn)
   if (this->LookupTable == NULL &&
+      !vtkImageDataReader::HasColorOverlay(inData) &&
       (inData->GetScalarType() == VTK_UNSIGNED_CHAR &&
        this->Window == 255 && this->Level == 127.5))
     {
@@ -98,9 +105,13 @@ int vtkImageWindowLevel::RequestInformation (
     return 0;
     }
 
+  vtkImageData *inData = vtkImageData::SafeDownCast(
+    inInfo->Get(vtkDataObject::DATA_OBJECT()));
+
   // If LookupTable is null and window / level produces no change,
   // then the data will be passed
   if ( this->LookupTable == NULL &&
+       !vtkImageDataReader::HasColorOverlay(inData) &&
        (inScalarInfo->Get(vtkDataObject::FIELD_ARRAY_TYPE()) == 
         VTK_UNSIGNED_CHAR &&
         this->Window == 255 && this->Level == 127.5) )
@@ -361,6 +372,32 @@ void vtkImageWindowLevelExecute(
           optr += numberOfOutputComponents;
           }
         }
+      else if (numberOfComponents == 1 && numberOfOutputComponents >= 3)
+        {
+        // luminance shown in color (the image has a color overlay)
+        for (idxX = 0; idxX < extX; idxX++)
+          {
+          if (*iptr <= lower)
+            {
+            result_val = lower_val;
+            }
+          else if (*iptr >= upper)
+            {
+            result_val = upper_val;
+            }
+          else
+            {
+            result_val = static_cast<unsigned char>((*iptr + shift)*scale);
+            }
+          optr[0] = optr[1] = optr[2] = result_val;
+          if (numberOfOutputComponents == 4)
+            {
+            optr[3] = 255;
+            }
+          iptr++;
+          optr += numberOfOutputComponents;
+          }
+        }
       else
         {
         for (idxX = 0; idxX < extX; idxX++)
@@ -402,6 +439,59 @@ void vtkImageWindowLevelExecute(
     }
 }
 
+/**
+ * Draws the colored pixels of an image reduced to luminance (see
+ * vtkImageDataReader::HasColorOverlay) over the part of the output in outExt.
+ * The overlay's point ids are sorted so only the ids of the slices in outExt
+ * are visited.
+ */
+//-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-
+static void vtkImageWindowLevelDrawOverlay(
+  vtkImageData *inData,
+  vtkImageData *outData,
+  int outExt[6])
+{
+  vtkFieldData *fieldData = inData->GetFieldData();
+  vtkIdTypeArray *ids = vtkIdTypeArray::SafeDownCast(
+    fieldData->GetArray(vtkImageDataReader::ColorOverlayIdsName));
+  vtkUnsignedCharArray *colors = vtkUnsignedCharArray::SafeDownCast(
+    fieldData->GetArray(vtkImageDataReader::ColorOverlayColorsName));
+  int numberOfOutputComponents = outData->GetNumberOfScalarComponents();
+  if (!ids || !colors || numberOfOutputComponents < 3)
+    {
+    return;
+    }
+
+  // the ids are offsets into the input's extent
+  int *inExt = inData->GetExtent();
+  vtkIdType rowLength = inExt[1] - inExt[0] + 1;
+  vtkIdType sliceLength = rowLength * (inExt[3] - inExt[2] + 1);
+
+  vtkIdType *begin = ids->GetPointer(0);
+  vtkIdType *end = begin + ids->GetNumberOfTuples();
+  vtkIdType *first = std::lower_bound(begin, end,
+    (outExt[4] - inExt[4]) * sliceLength);
+  vtkIdType *last = std::lower_bound(first, end,
+    (outExt[5] - inExt[4] + 1) * sliceLength);
+
+  for (vtkIdType *id = first; id != last; ++id)
+    {
+    int x = inExt[0] + static_cast<int>(*id % rowLength);
+    int y = inExt[2] + static_cast<int>((*id / rowLength) % (inExt[3] - inExt[2] + 1));
+    int z = inExt[4] + static_cast<int>(*id / sliceLength);
+    if (x < outExt[0] || x > outExt[1] || y < outExt[2] || y > outExt[3])
+      {
+      continue;
+      }
+    unsigned char *optr =
+      static_cast<unsigned char *>(outData->GetScalarPointer(x, y, z));
+    unsigned char *color = colors->GetPointer(3 * (id - begin));
+    optr[0] = color[0];
+    optr[1] = color[1];
+    optr[2] = color[2];
+    }
+}
+
 /**
  * This method is passed a input and output data, and executes the filter
  * algorithm to fill the output from the input.
@@ -432,6 +522,11 @@ void vtkImageWindowLevel::ThreadedRequestData(
       vtkErrorMacro(<< "Execute: Unknown ScalarType");
       return;
     }
+
+  if (vtkImageDataReader::HasColorOverlay(inData[0][0]))
+    {
+    vtkImageWindowLevelDrawOverlay(inData[0][0], outData[0], outExt);
+    }
 }
 
 //-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-
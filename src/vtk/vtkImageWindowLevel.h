@@ -23,6 +23,10 @@
  * and will revert to only modulating the first component of a multi-component
  * image if the lookup table is set.
  *
+ * Images reduced to luminance with a color overlay by vtkImageDataReader are
+ * windowed / leveled as luminance and shown in color, with the colored pixels
+ * of the overlay drawn over them as they are.
+ *
  * @see vtkLookupTable, vtkScalarsToColors
  */
 
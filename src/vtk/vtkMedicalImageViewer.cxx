@@ -15,11 +15,14 @@
 #include <vtkCamera.h>
 #include <vtkCommand.h>
 #include <vtkCustomCornerAnnotation.h>
+#include <vtkDICOMFrameReader.h>
 #include <vtkDataArray.h>
+#include <vtkDecodedImageCache.h>
 #include <vtkFrameAnimationPlayer.h>
 #include <vtkImageActor.h>
 #include <vtkImageCoordinateWidget.h>
 #include <vtkImageData.h>
+#include <vtkImageDataCache.h>
 #include <vtkImageDataReader.h>
 #include <vtkImageSinusoidSource.h>
 #include <vtkImageWindowLevel.h>
@@ -222,11 +225,22 @@ void vtkMedicalImageViewer::SetInput( vtkImageData* input )
   this->WindowLevel->SetInputConnection( input->GetProducerPort() );
   this->ImageActor->SetInput( this->WindowLevel->GetOutput() );
 
+  // only update the slice which is shown first (the last one, see InitializeCameraViews) so
+  // that readers which decode frames on demand (see vtkDICOMFrameReader) don't decode them all
+  input->UpdateInformation();
+  int extent[6];
+  input->GetWholeExtent( extent );
+  extent[2 * this->ViewOrientation] = extent[2 * this->ViewOrientation + 1];
+  input->SetUpdateExtent( extent );
   input->Update();
   int components = input->GetNumberOfScalarComponents();
   switch( components )
   {    
-    case 1: this->SetMappingToLuminance(); break;
+    case 1:
+      // luminance with a color overlay (see vtkImageDataReader) is windowed but shown in color
+      if( vtkImageDataReader::HasColorOverlay( input ) ) this->SetMappingToColor();
+      else this->SetMappingToLuminance();
+      break;
     case 2:
     case 3: this->SetMappingToColor(); break;
     case 4: this->SetMappingToColorAlpha(); break;
@@ -241,35 +255,58 @@ void vtkMedicalImageViewer::SetInput( vtkImageData* input )
 }
 
 //-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-
-bool vtkMedicalImageViewer::Load( const std::string& fileName )
+bool vtkMedicalImageViewer::Load( const std::string& fileName, const int cineRate )
 {
-  bool success = false;
-  if( vtkImageDataReader::IsValidFileName( fileName.c_str() ) )
+  vtkNew< vtkMedicalImageProperties > properties;
+
+  // compressed cineloops which haven't been decoded yet are decoded a frame at a time as they are shown
+  vtkSmartPointer< vtkDICOMFrameReader > frameReader;
+  if( !vtkImageDataCache::Contains( fileName ) && !vtkDecodedImageCache::Contains( fileName ) &&
+      vtkDICOMFrameReader::CanReadFile( fileName ) )
   {
-    vtkNew< vtkImageDataReader > reader;
-    reader->SetFileName( fileName.c_str() );
-    vtkImageData* image = reader->GetOutput();
-    if( image )
-    {
-      this->SetInput( image );
-      success = true;
-      vtkMedicalImageProperties* properties = reader->GetMedicalImageProperties();
+    frameReader = vtkSmartPointer< vtkDICOMFrameReader >::New();
+    frameReader->SetFileName( fileName );
+    frameReader->UpdateInformation();
+    if( 0 < frameReader->GetNumberOfFrames() )
+      properties->DeepCopy( frameReader->GetMedicalImageProperties() );
+    else frameReader = NULL;
+  }
 
-      // vtkMedicalImageProperties has a bug which crashes if the CineRate is checked for
-      // images with no 3rd dimension, so only set the frame rate for 3D images
-      if( this->GetImageDimensionality() == 3 )
-      {
-        if( NULL != properties->GetUserDefinedValue( "CineRate" ) )
-        {
-          this->SetMaxFrameRate( 
-            vtkVariant( properties->GetUserDefinedValue( "CineRate" ) ).ToInt() );
-          this->SetFrameRate( this->MaxFrameRate );  
-        }
-      }
-    }  
+  if( frameReader )
+  {
+    // the first frame is shown as soon as it is decoded while the whole cineloop is decoded in
+    // the background, it replaces the frame reader once it is ready (see SetSlice)
+    this->SetInput( frameReader->GetOutput() );
+    vtkImageDataCache::LoadInBackground( fileName );
+  }
+  else
+  {
+    // recently viewed images are not decoded again
+    vtkNew< vtkImageData > image;
+    if( !vtkImageDataCache::Load( fileName, image.GetPointer(), properties.GetPointer() ) ) return false;
+    this->SetInput( image.GetPointer() );
   }
+  this->FrameReader = frameReader;
+  this->FileName = fileName;
 
-  return success;
+  // vtkMedicalImageProperties has a bug which crashes if the CineRate is checked for
+  // images with no 3rd dimension, so only set the frame rate for 3D images
+  if( this->GetImageDimensionality() == 3 )
+  {
+    if( 0 < cineRate )
+    {
+      this->SetMaxFrameRate( cineRate );
+      this->SetFrameRate( this->MaxFrameRate );
+    }
+    else if( NULL != properties->GetUserDefinedValue( "CineRate" ) )
+    {
+      this->SetMaxFrameRate( 
+        vtkVariant( properties->GetUserDefinedValue( "CineRate" ) ).ToInt() );
+      this->SetFrameRate( this->MaxFrameRate );  
+    }
+  }
+
+  return true;
 }
 
 //-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-
@@ -498,7 +535,7 @@ void vtkMedicalImageViewer::InitializeWindowLevel()
   }
   
   // VTK_LUMINANCE is defined in vtkSystemIncludes.h
-  if( this->WindowLevel->GetOutputFormat() == VTK_LUMINANCE )
+  if( this->WindowLevel->GetOutputFormat() == VTK_LUMINANCE || components == 1 )
   {
     this->SetColorWindowLevel( this->OriginalWindow, this->OriginalLevel );
   }
@@ -589,8 +626,10 @@ int vtkMedicalImageViewer::GetImageDimensionality()
   int dim = 0;
   if( this->GetInput() )
   {
-    int* dims = this->GetInput()->GetDimensions();
-    dim = 1 >= dims[2] ? 2 : 3;
+    // the whole extent is used since only one slice may have been read
+    this->GetInput()->UpdateInformation();
+    int* extent = this->GetInput()->GetWholeExtent();
+    dim = extent[4] >= extent[5] ? 2 : 3;
   }
   return dim;
 }
@@ -609,6 +648,7 @@ void vtkMedicalImageViewer::SetImageToSinusoid()
   sinusoid->GetOutput()->Update();
 
   this->SetInput( sinusoid->GetOutput() );
+  this->FrameReader = NULL;
   this->SetSlice( 15 );
 }
 
@@ -683,6 +723,7 @@ void vtkMedicalImageViewer::SetSlice( int slice )
   this->Slice = slice;
   this->Modified();
 
+  this->UseDecodedImage();
   this->UpdateDisplayExtent();
 
   if( this->Cursor && this->Annotate )
@@ -694,6 +735,19 @@ void vtkMedicalImageViewer::SetSlice( int slice )
   this->Render();
 }
 
+//-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-
+void vtkMedicalImageViewer::UseDecodedImage()
+{
+  if( !this->FrameReader || !vtkImageDataCache::Contains( this->FileName ) ) return;
+
+  // the decoded image has the same geometry and is shown with the same mapping (a color image
+  // which was reduced to luminance has a color overlay), so only the input has to change
+  vtkNew< vtkImageData > image;
+  if( !vtkImageDataCache::Load( this->FileName, image.GetPointer() ) ) return;
+  this->WindowLevel->SetInputConnection( image->GetProducerPort() );
+  this->FrameReader = NULL;
+}
+
 //-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-+#+-
 void vtkMedicalImageViewer::SetViewOrientation( const int& orientation )
 {
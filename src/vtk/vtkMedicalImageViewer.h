@@ -57,9 +57,11 @@
 
 #include "vtkObject.h"
 #include "vtkSmartPointer.h"
+#include <string>
 #include <vector>
 
 class vtkCustomCornerAnnotation;
+class vtkDICOMFrameReader;
 class vtkImageActor;
 class vtkImageCoordinateWidget;
 class vtkImageData;
@@ -100,11 +102,18 @@ public:
    * Load an image from file and display.
    * 
    * If fileName is valid, load the file via vtkGDCMImageReader and display it.
+   * Compressed cineloops which aren't in memory or in the decoded image cache
+   * are read with vtkDICOMFrameReader instead, so that the first frame is
+   * shown without waiting for the others.  The whole cineloop is decoded in
+   * the background (see vtkImageDataCache::LoadInBackground()) and replaces
+   * the frame reader once it is ready.
    * Returns fails if image fails to load.
    * @param fileName Name of a file on disk
+   * @param cineRate The frame rate of a cineloop if already known (otherwise it is read from
+   * the file's header)
    * @return boolean
    */
-   bool Load( const std::string& fileName );
+   bool Load( const std::string& fileName, const int cineRate = 0 );
 
   /**
    * Enum constants for orthonormal slice orientations. */
@@ -390,6 +399,12 @@ protected:
   vtkSmartPointer<vtkCustomCornerAnnotation> Annotation;
   //@}
 
+  /** The reader of the input when its frames are decoded as they are shown */
+  vtkSmartPointer<vtkDICOMFrameReader> FrameReader;
+
+  /** The name of the file last loaded */
+  std::string FileName;
+
   int Cursor;
   int Annotate;
   int Interpolate;
@@ -429,6 +444,9 @@ protected:
   /** Record the current camera parameters */
   void RecordCameraView();
 
+  /** Replace the frame reader with the whole cineloop once it has been decoded in the background */
+  void UseDecodedImage();
+
   /** Animation control */
   vtkSmartPointer<vtkAnimationScene> AnimationScene;
   vtkSmartPointer<vtkAnimationCue> AnimationCue;
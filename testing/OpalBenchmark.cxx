@@ -0,0 +1,189 @@
+/*=========================================================================
+
+  Program:  Alder (CLSA Medical Image Quality Assessment Tool)
+  Module:   OpalBenchmark.cxx
+  Language: C++
+
+  Author: Patrick Emond <emondpd AT mcmaster DOT ca>
+  Author: Dean Inglis <inglisd AT mcmaster DOT ca>
+
+=========================================================================*/
+//
+// .SECTION Description
+// Measures the throughput of the network path between Alder and Opal by pointing the Opal
+// service at a local stand-in server (see OpalFixture.py) and timing the retrieval of the
+// interview list (Interview::UpdateInterviewData), the exam metadata (Interview::UpdateExamData)
+// and the image data (Interview::UpdateImageData).  The database named by the configuration
+// file is written to, so it must be a scratch database (with the Modality table populated).
+//
+
+#include "Application.h"
+#include "Database.h"
+#include "Interview.h"
+#include "OpalService.h"
+#include "QueryModifier.h"
+#include "Utilities.h"
+
+#include "vtkAlderMySQLQuery.h"
+#include "vtkNew.h"
+#include "vtkSmartPointer.h"
+
+#include <chrono>
+#include <curl/curl.h>
+#include <iomanip>
+#include <stdexcept>
+#include <vector>
+
+using namespace Alder;
+
+namespace
+{
+  typedef std::chrono::steady_clock Clock;
+
+  double secondsSince( const Clock::time_point start )
+  {
+    return std::chrono::duration< double >( Clock::now() - start ).count();
+  }
+
+  // runs a query which doesn't return anything, throwing an exception if it fails
+  void execute( const std::string sql )
+  {
+    vtkSmartPointer< vtkAlderMySQLQuery > query = Application::GetInstance()->GetDB()->GetQuery();
+    query->SetQuery( sql.c_str() );
+    query->Execute();
+    if( query->HasError() )
+    {
+      Utilities::log( query->GetLastErrorText() );
+      throw std::runtime_error( "There was an error while trying to query the database." );
+    }
+  }
+
+  int countInterviews()
+  {
+    vtkSmartPointer< vtkAlderMySQLQuery > query = Application::GetInstance()->GetDB()->GetQuery();
+    query->SetQuery( "SELECT COUNT(*) FROM Interview" );
+    query->Execute();
+    return query->NextRow() ? query->DataValue( 0 ).ToInt() : 0;
+  }
+
+  void usage( const char *name )
+  {
+    cerr << "Usage: " << name << " [-c config] [-h host] [-p port] [-n interviews] [-x]" << endl
+         << "  -c config      the configuration file (default " << ALDER_CONFIG_FILE << ")" << endl
+         << "  -h host        the host the Opal fixture is running on (default localhost)" << endl
+         << "  -p port        the port the Opal fixture is listening on (default 8843)" << endl
+         << "  -n interviews  the number of interviews to download images for (default 10)" << endl
+         << "  -x             remove all interviews from the (scratch) database first" << endl;
+  }
+}
+
+// main function
+int main( int argc, char** argv )
+{
+  std::string config = ALDER_CONFIG_FILE;
+  std::string host = "localhost";
+  int port = 8843;
+  int count = 10;
+  bool reset = false;
+
+  int option;
+  while( -1 != ( option = getopt( argc, argv, "c:h:p:n:x" ) ) )
+  {
+    if( 'c' == option ) config = optarg;
+    else if( 'h' == option ) host = optarg;
+    else if( 'p' == option ) port = atoi( optarg );
+    else if( 'n' == option ) count = atoi( optarg );
+    else if( 'x' == option ) reset = true;
+    else
+    {
+      usage( argv[0] );
+      return EXIT_FAILURE;
+    }
+  }
+
+  if( 1 > port || 0 > count )
+  {
+    usage( argv[0] );
+    return EXIT_FAILURE;
+  }
+
+  curl_global_init( CURL_GLOBAL_ALL );
+
+  int status = EXIT_FAILURE;
+  try
+  {
+    Application *app = Application::GetInstance();
+    if( !app->ReadConfiguration( config ) )
+      throw std::runtime_error( "Error while reading configuration file \"" + config + "\"" );
+    if( !app->ConnectToDatabase() )
+      throw std::runtime_error( "Error while connecting to the database" );
+
+    // keep the configured timeout and number of transfers, but talk to the fixture (and don't
+    // let responses cached by an earlier run stand in for the requests being measured)
+    app->SetupOpalService();
+    OpalService *opal = app->GetOpal();
+    opal->Setup( "fixture", "fixture", host, port, opal->GetTimeout() );
+    opal->SetCacheDirectory( "" );
+
+    if( reset ) execute( "DELETE FROM Interview" );
+
+    cout << std::fixed << std::setprecision( 3 );
+
+    // the interview list
+    int before = countInterviews();
+    Clock::time_point start = Clock::now();
+    Interview::UpdateInterviewData();
+    double seconds = secondsSince( start );
+    int added = countInterviews() - before;
+    cout << "UpdateInterviewData: " << added << " interviews added in " << seconds << " s ("
+         << ( 0 < seconds ? added / seconds : 0.0 ) << " interviews/s)" << endl;
+
+    // the exam metadata and image data of the first few interviews
+    std::vector< vtkSmartPointer< Interview > > interviewList;
+    vtkNew< QueryModifier > modifier;
+    modifier->Order( "Id" );
+    modifier->Limit( count );
+    ActiveRecord::GetAll( &interviewList, modifier.GetPointer() );
+
+    double examSeconds = 0.0, imageSeconds = 0.0;
+    int failed = 0;
+    for( auto it = interviewList.cbegin(); it != interviewList.cend(); ++it )
+    {
+      try
+      {
+        start = Clock::now();
+        ( *it )->UpdateExamData();
+        examSeconds += secondsSince( start );
+
+        start = Clock::now();
+        ( *it )->UpdateImageData();
+        imageSeconds += secondsSince( start );
+      }
+      catch( std::exception &e )
+      {
+        failed++;
+        Utilities::log( std::string( "Benchmark interview failed: " ) + e.what() );
+      }
+    }
+
+    int interviews = interviewList.size();
+    double megabytes = opal->GetBytesReceived() / 1048576.0;
+    cout << "UpdateExamData: " << interviews << " interviews in " << examSeconds << " s ("
+         << ( 0 < examSeconds ? interviews / examSeconds : 0.0 ) << " interviews/s)" << endl;
+    cout << "UpdateImageData: " << opal->GetFilesReceived() << " files, " << megabytes << " MB in "
+         << imageSeconds << " s (" << ( 0 < imageSeconds ? opal->GetFilesReceived() / imageSeconds : 0.0 )
+         << " files/s, " << ( 0 < imageSeconds ? megabytes / imageSeconds : 0.0 ) << " MB/s), "
+         << failed << " interviews failed" << endl;
+    cout << opal->GetStatisticsSummary();
+
+    if( 0 == failed ) status = EXIT_SUCCESS;
+  }
+  catch( std::exception &e )
+  {
+    cerr << "ERROR: " << e.what() << endl;
+  }
+
+  Application::DeleteInstance();
+  curl_global_cleanup();
+  return status;
+}
@@ -0,0 +1,365 @@
+#! /usr/bin/env python3
+#
+# A local stand-in for the parts of Opal's RESTful interface which Alder uses, so that the
+# network path (OpalService, Interview::UpdateInterviewData and Interview::UpdateImageData) can
+# be exercised and benchmarked without a live Opal server.
+#
+# Usage:
+#   OpalFixture.py --help
+#
+# Responses are synthetic unless a directory of recorded responses is provided, in which case
+# a request is answered with the file whose path (below the directory) matches the request's
+# web service path, including its query string if it has one.  For example, a response saved by
+#
+#   opal.py -o https://opal:8843 -u user -p pass -w /datasource/alder/table/Interview/entities \
+#     -f recorded/datasource/alder/table/Interview/entities
+#
+# is served by this fixture when it is run with --recorded recorded.
+#
+# Synthetic responses describe a number of interviews with every exam completed, and provide
+# small valid DICOM (gzipped for cineloops, as Opal stores them) and JPEG images of a given size.
+# Latency, bandwidth and dropped connections can be simulated.  File responses support range
+# requests so that interrupted transfers can be resumed, and every response has an ETag so that
+# cached responses can be revalidated.
+#
+# Examples:
+#   OpalFixture.py --port 8843 --interviews 200
+#   OpalFixture.py --port 8843 --latency 50 --bandwidth 2048 --image-size 4096 --drop 0.05
+#
+
+import argparse
+import datetime
+import gzip
+import hashlib
+import json
+import os
+import random
+import re
+import socket
+import ssl
+import struct
+import subprocess
+import sys
+import tempfile
+import time
+import urllib.parse
+from functools import lru_cache
+from http.server import BaseHTTPRequestHandler, ThreadingHTTPServer
+
+#
+# Parse arguments
+#
+parser = argparse.ArgumentParser( description='Local stand-in for Opal\'s RESTful interface.' )
+parser.add_argument( '--host', default='localhost', help='Address to listen on (default localhost)' )
+parser.add_argument( '--port', '-p', type=int, default=8843, help='Port to listen on (default 8843)' )
+parser.add_argument( '--http', action='store_true',
+  help='Serve plain HTTP instead of HTTPS (OpalService always uses HTTPS)' )
+parser.add_argument( '--cert', help='TLS certificate (a self-signed one is created if not provided)' )
+parser.add_argument( '--key', help='TLS private key (required along with --cert)' )
+parser.add_argument( '--recorded', '-r', help='Directory of recorded responses to serve' )
+parser.add_argument( '--interviews', '-n', type=int, default=100,
+  help='Number of synthetic interviews (default 100)' )
+parser.add_argument( '--image-size', type=int, default=1024,
+  help='Approximate size of each synthetic image in KB (default 1024)' )
+parser.add_argument( '--latency', type=float, default=0.0,
+  help='Delay before every response in milliseconds (default 0)' )
+parser.add_argument( '--bandwidth', type=float, default=0.0,
+  help='Maximum rate of every response in KB/s (default unlimited)' )
+parser.add_argument( '--drop', type=float, default=0.0,
+  help='Probability of dropping the connection part way through a file (default 0)' )
+parser.add_argument( '--seed', type=int, default=1, help='Seed for the synthetic data (default 1)' )
+parser.add_argument( '--verbose', '-v', action='store_true', help='Log every request' )
+args = parser.parse_args()
+
+#
+# Synthetic data
+#
+EXAM_TYPES = [
+  'CarotidIntima', 'DualHipBoneDensity', 'ForearmBoneDensity', 'LateralBoneDensity',
+  'Plaque', 'RetinalScan', 'WholeBodyBoneDensity' ]
+SITES = [ 'Calgary', 'Dalhousie', 'Hamilton', 'Manitoba', 'McGill', 'Memorial', 'Ottawa',
+          'Sherbrooke', 'Simon Fraser', 'Victoria', 'British Columbia' ]
+
+def interview_uids():
+  return [ 'A%06d' % ( i + 1 ) for i in range( args.interviews ) ]
+
+def visit_date( uid ):
+  day = datetime.datetime( 2013, 1, 1, 9, 0, 0 ) + \
+    datetime.timedelta( days=int( uid[1:] ) % 700, minutes=int( uid[1:] ) % 480 )
+  return day.strftime( '%Y-%m-%d %H:%M:%S' )
+
+def site( uid ):
+  return SITES[int( uid[1:] ) % len( SITES )]
+
+def side_values( uid, table, variable ):
+  # exams of both sides are done, except for the forearm which only has one side
+  if 'OUTPUT_FA_SIDE' == variable:
+    return 'left' if 0 == int( uid[1:] ) % 2 else 'right'
+  return [ 'left', 'right' ]
+
+def exam_value( uid, variable ):
+  name = variable.split( '.' )[-1]
+  if 'Stage' == name: return 'Completed'
+  elif 'Interviewer' == name: return 'fixture'
+  elif 'DatetimeAcquired' == name: return visit_date( uid )
+  return None
+
+# a block of random data which compresses a little, like the pixel data of real images
+@lru_cache( maxsize=1 )
+def pixel_block( size ):
+  table = bytes( ( i & 0x3f ) + 64 for i in range( 256 ) )
+  return random.Random( args.seed ).randbytes( size ).translate( table )
+
+def dicom_element( group, element, vr, value ):
+  if isinstance( value, str ):
+    pad = b'\0' if 'UI' == vr else b' '
+    value = value.encode( 'ascii' )
+    if len( value ) % 2: value += pad
+  if vr in ( 'OB', 'OW', 'SQ', 'UN', 'UT' ):
+    return struct.pack( '<HH2s2xI', group, element, vr.encode( 'ascii' ), len( value ) ) + value
+  return struct.pack( '<HH2sH', group, element, vr.encode( 'ascii' ), len( value ) ) + value
+
+# a valid secondary capture DICOM file (explicit VR little endian) with the given pixel data
+def dicom( uid, instance, acquired, pixels ):
+  columns = 512
+  frames = max( 1, len( pixels ) // ( columns * columns ) )
+  rows = len( pixels ) // ( columns * frames )
+  pixels = pixels[:rows * columns * frames]
+  sop_class = '1.2.840.10008.5.1.4.1.1.7'
+  sop_instance = '2.25.%d' % int( hashlib.sha1( instance.encode( 'ascii' ) ).hexdigest()[:24], 16 )
+
+  meta = dicom_element( 0x0002, 0x0001, 'OB', b'\0\1' ) + \
+         dicom_element( 0x0002, 0x0002, 'UI', sop_class ) + \
+         dicom_element( 0x0002, 0x0003, 'UI', sop_instance ) + \
+         dicom_element( 0x0002, 0x0010, 'UI', '1.2.840.10008.1.2.1' ) + \
+         dicom_element( 0x0002, 0x0012, 'UI', '2.25.1' )
+  meta = dicom_element( 0x0002, 0x0000, 'UL', struct.pack( '<I', len( meta ) ) ) + meta
+
+  data = dicom_element( 0x0008, 0x0016, 'UI', sop_class ) + \
+         dicom_element( 0x0008, 0x0018, 'UI', sop_instance ) + \
+         dicom_element( 0x0008, 0x002a, 'DT', acquired ) + \
+         dicom_element( 0x0008, 0x0060, 'CS', 'OT' ) + \
+         dicom_element( 0x0010, 0x0020, 'LO', uid ) + \
+         dicom_element( 0x0020, 0x0011, 'IS', '1' ) + \
+         dicom_element( 0x0028, 0x0002, 'US', struct.pack( '<H', 1 ) ) + \
+         dicom_element( 0x0028, 0x0004, 'CS', 'MONOCHROME2' )
+  if 1 < frames: data += dicom_element( 0x0028, 0x0008, 'IS', str( frames ) )
+  data += dicom_element( 0x0028, 0x0010, 'US', struct.pack( '<H', rows ) ) + \
+          dicom_element( 0x0028, 0x0011, 'US', struct.pack( '<H', columns ) ) + \
+          dicom_element( 0x0028, 0x0100, 'US', struct.pack( '<H', 8 ) ) + \
+          dicom_element( 0x0028, 0x0101, 'US', struct.pack( '<H', 8 ) ) + \
+          dicom_element( 0x0028, 0x0102, 'US', struct.pack( '<H', 7 ) ) + \
+          dicom_element( 0x0028, 0x0103, 'US', struct.pack( '<H', 0 ) ) + \
+          dicom_element( 0x7fe0, 0x0010, 'OB', pixels )
+
+  return b'\0' * 128 + b'DICM' + meta + data
+
+# a valid 8x8 grey baseline JPEG, padded with comments to the requested size
+def jpeg( instance, size ):
+  quantization = b'\xff\xdb\x00\x43\x00' + b'\x01' * 64
+  frame = b'\xff\xc0\x00\x0b\x08\x00\x08\x00\x08\x01\x01\x11\x00'
+  # single code huffman tables: DC difference category 0 and AC end of block
+  huffman = b'\xff\xc4\x00\x14\x00\x01' + b'\x00' * 15 + b'\x00' + \
+            b'\xff\xc4\x00\x14\x10\x01' + b'\x00' * 15 + b'\x00'
+  scan = b'\xff\xda\x00\x08\x01\x01\x00\x00\x3f\x00' + b'\x3f'
+
+  comments = b''
+  remaining = size - len( quantization + frame + huffman + scan ) - 4
+  text = instance.encode( 'ascii' )
+  block = pixel_block( 65533 )
+  while 0 < remaining:
+    payload = ( text + block )[:min( 65533, max( remaining - 4, len( text ) ) )]
+    comments += b'\xff\xfe' + struct.pack( '>H', len( payload ) + 2 ) + payload
+    remaining -= len( payload ) + 4
+    text = b''
+
+  return b'\xff\xd8' + comments + quantization + frame + huffman + scan + b'\xff\xd9'
+
+# the contents of an image variable (None if there is no such image)
+@lru_cache( maxsize=32 )
+def image_data( table, uid, variable, position ):
+  if uid not in interview_set or table not in EXAM_TYPES: return None
+  instance = '/'.join( [ table, uid, variable, str( position ) ] )
+  size = args.image_size * 1024
+  if 'RetinalScan' == table: return jpeg( instance, size )
+
+  # hash the instance so that every image has different pixel data
+  offset = int( hashlib.sha1( instance.encode( 'ascii' ) ).hexdigest()[:6], 16 ) % size
+  block = pixel_block( 2 * size )
+  data = dicom( uid, instance, visit_date( uid ).replace( '-', '' ).replace( ' ', '' ).replace( ':', '' ),
+                block[offset:offset + size] )
+
+  # cineloops are stored in Opal gzipped
+  if 'CINELOOP' in variable: data = gzip.compress( data, 1 )
+  return data
+
+#
+# Responses
+#
+def value_set( uid, values ):
+  entries = []
+  for value in values:
+    if isinstance( value, list ):
+      entries.append( { 'values': [ { 'value': v } for v in value ] } )
+    elif value is None:
+      entries.append( { 'value': None } )
+    else:
+      entries.append( { 'value': value } )
+  return { 'identifier': uid, 'values': entries }
+
+def selected( query, default ):
+  # select=name().any('a','b')
+  match = re.match( r"name\(\)\.any\((.*)\)", query.get( 'select', [ '' ] )[0] )
+  if not match: return default
+  return re.findall( r"'([^']*)'", match.group( 1 ) )
+
+def synthetic( path, query ):
+  parts = path.strip( '/' ).split( '/' )
+  if len( parts ) < 4 or 'datasource' != parts[0] or 'table' != parts[2]: return None
+  datasource, table, rest = parts[1], parts[3], parts[4:]
+
+  if 'alder' == datasource and 'Interview' == table:
+    if [ 'entities' ] == rest:
+      return json.dumps( [ { 'identifier': uid, 'entityType': 'Participant' } for uid in uids ] )
+    if [ 'valueSets' ] == rest:
+      offset = int( query.get( 'offset', [ '0' ] )[0] )
+      limit = int( query.get( 'limit', [ '100' ] )[0] )
+      variables = [ 'VisitDate', 'Site' ]
+      return json.dumps( {
+        'entityType': 'Participant',
+        'variables': variables,
+        'valueSets': [ value_set( uid, [ visit_date( uid ), site( uid ) ] )
+                       for uid in uids[offset:offset + limit] ] } )
+
+  if 2 <= len( rest ) and 'valueSet' == rest[0] and rest[1] in interview_set:
+    uid = rest[1]
+    if 2 == len( rest ):
+      if 'alder' == datasource and 'Exam' == table:
+        default = [ t + '.' + v for t in EXAM_TYPES for v in [ 'Stage', 'Interviewer', 'DatetimeAcquired' ] ]
+        variables = selected( query, default )
+        values = [ exam_value( uid, v ) for v in variables ]
+      elif 'clsa-dcs-images' == datasource and table in EXAM_TYPES:
+        variables = selected( query, [ 'Measure.SIDE' ] )
+        values = [ side_values( uid, table, v ) for v in variables ]
+      else:
+        return None
+      return json.dumps( { 'entityType': 'Participant', 'variables': variables,
+                           'valueSets': [ value_set( uid, values ) ] } )
+
+    if 5 == len( rest ) and 'variable' == rest[2] and 'value' == rest[4] and \
+       'clsa-dcs-images' == datasource:
+      position = int( query.get( 'pos', [ '-1' ] )[0] )
+      return image_data( table, uid, rest[3], position )
+
+  return None
+
+def recorded( path, query_string ):
+  if not args.recorded: return None
+  name = os.path.normpath( os.path.join( args.recorded, path.strip( '/' ) ) )
+  if query_string: name += '?' + query_string
+  if not name.startswith( os.path.normpath( args.recorded ) ) or not os.path.isfile( name ):
+    return None
+  with open( name, 'rb' ) as f:
+    return f.read()
+
+class OpalHandler( BaseHTTPRequestHandler ):
+  protocol_version = 'HTTP/1.1'
+  server_version = 'OpalFixture/1.0'
+
+  def log_message( self, format, *arguments ):
+    if args.verbose: BaseHTTPRequestHandler.log_message( self, format, *arguments )
+
+  def do_GET( self ):
+    url = urllib.parse.urlsplit( self.path )
+    path = url.path
+    if not path.startswith( '/ws/' ):
+      return self.send_error( 404 )
+    path = path[3:]
+    query = urllib.parse.parse_qs( url.query )
+
+    if 0 < args.latency: time.sleep( args.latency / 1000.0 )
+
+    body = recorded( path, url.query )
+    if body is None: body = synthetic( path, query )
+    if body is None:
+      return self.send_error( 404 )
+
+    if isinstance( body, str ):
+      return self.send_body( body.encode( 'utf-8' ), 'application/json', False )
+    if body.startswith( b'{' ) or body.startswith( b'[' ):
+      return self.send_body( body, 'application/json', False )
+    return self.send_body( body, 'application/octet-stream', True )
+
+  def send_body( self, body, content_type, is_file ):
+    start = 0
+    etag = '"%s"' % hashlib.sha1( body ).hexdigest()
+    match = re.match( r'bytes=(\d+)-$', self.headers.get( 'Range', '' ) )
+    if_range = self.headers.get( 'If-Range' )
+    resume = is_file and match and ( if_range is None or if_range == etag )
+    if etag == self.headers.get( 'If-None-Match' ):
+      self.send_response( 304 )
+      self.send_header( 'ETag', etag )
+      self.end_headers()
+      return
+    elif resume and int( match.group( 1 ) ) < len( body ):
+      start = int( match.group( 1 ) )
+      self.send_response( 206 )
+      self.send_header( 'Content-Range', 'bytes %d-%d/%d' % ( start, len( body ) - 1, len( body ) ) )
+    else:
+      self.send_response( 200 )
+    self.send_header( 'Content-Type', content_type )
+    self.send_header( 'Content-Length', str( len( body ) - start ) )
+    self.send_header( 'ETag', etag )
+    if is_file: self.send_header( 'Accept-Ranges', 'bytes' )
+    self.end_headers()
+
+    # drop the connection somewhere in the middle of the file
+    end = len( body )
+    dropped = is_file and random.random() < args.drop
+    if dropped: end = random.randint( start, end - 1 )
+
+    chunk = 16384
+    began = time.time()
+    sent = 0
+    for offset in range( start, end, chunk ):
+      piece = body[offset:min( offset + chunk, end )]
+      self.wfile.write( piece )
+      sent += len( piece )
+      if 0 < args.bandwidth:
+        delay = sent / ( args.bandwidth * 1024.0 ) - ( time.time() - began )
+        if 0 < delay: time.sleep( delay )
+
+    if dropped:
+      self.wfile.flush()
+      self.close_connection = True
+      self.connection.shutdown( socket.SHUT_RDWR )
+
+#
+# Start the server
+#
+random.seed( args.seed )
+uids = interview_uids()
+interview_set = set( uids )
+
+server = ThreadingHTTPServer( ( args.host, args.port ), OpalHandler )
+server.daemon_threads = True
+if not args.http:
+  cert, key = args.cert, args.key
+  if not cert:
+    directory = tempfile.mkdtemp( prefix='OpalFixture' )
+    cert, key = os.path.join( directory, 'cert.pem' ), os.path.join( directory, 'key.pem' )
+    subprocess.check_call(
+      [ 'openssl', 'req', '-x509', '-newkey', 'rsa:2048', '-nodes', '-days', '1',
+        '-subj', '/CN=' + args.host, '-keyout', key, '-out', cert ],
+      stdout=subprocess.DEVNULL, stderr=subprocess.DEVNULL )
+  context = ssl.SSLContext( ssl.PROTOCOL_TLS_SERVER )
+  context.load_cert_chain( cert, key )
+  server.socket = context.wrap_socket( server.socket, server_side=True )
+
+print( 'Serving %d synthetic interviews on %s://%s:%d/ws' %
+       ( args.interviews, 'http' if args.http else 'https', args.host, args.port ) )
+sys.stdout.flush()
+try:
+  server.serve_forever()
+except KeyboardInterrupt:
+  pass